@@ -0,0 +1,291 @@
+#include "AssetPack.h"
+#include "Utilities.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <cstring>
+#include <stdexcept>
+
+namespace VkCourse {
+
+	namespace {
+		constexpr char ASSET_PACK_MAGIC[8]{ 'V', 'K', 'C', 'P', 'A', 'C', 'K', '\0' };
+
+		uint64_t align_offset(uint64_t offset)
+		{
+			return (offset + AssetPack::ASSET_PACK_ALIGNMENT - 1) & ~(AssetPack::ASSET_PACK_ALIGNMENT - 1);
+		}
+	}
+
+	AssetFile::AssetFile()
+	{
+	}
+
+	AssetFile::AssetFile(std::span<const unsigned char> packedData)
+		: m_data(packedData)
+	{
+	}
+
+	AssetFile::AssetFile(MappedFile&& file)
+		: m_file(std::move(file))
+	{
+		m_data = m_file.span();
+	}
+
+	const unsigned char* AssetFile::data() const
+	{
+		return m_data.data();
+	}
+
+	size_t AssetFile::size() const
+	{
+		return m_data.size();
+	}
+
+	std::span<const unsigned char> AssetFile::span() const
+	{
+		return m_data;
+	}
+
+	AssetPack::AssetPack()
+	{
+	}
+
+	AssetPack::~AssetPack()
+	{
+	}
+
+	bool AssetPack::open(const std::string& fileName)
+	{
+		m_entries = nullptr;
+		m_names = nullptr;
+		if (!m_file.open(fileName))
+		{
+			return false;
+		}
+
+		const uint64_t fileSize{ m_file.size() };
+		if (fileSize >= sizeof(AssetPackHeader))
+		{
+			memcpy(&m_header, m_file.data(), sizeof(AssetPackHeader));
+		}
+
+		// Reject truncated or corrupted tables before reading through them
+		auto fits{ [fileSize](uint64_t offset, uint64_t size) { return offset <= fileSize && size <= fileSize - offset; } };
+		if (fileSize < sizeof(AssetPackHeader)
+			|| memcmp(m_header.magic, ASSET_PACK_MAGIC, sizeof(ASSET_PACK_MAGIC)) != 0
+			|| m_header.version != ASSET_PACK_VERSION
+			|| m_header.fileSize != fileSize
+			|| m_header.entriesOffset % alignof(AssetPackEntry) != 0
+			|| !fits(m_header.entriesOffset, sizeof(AssetPackEntry) * static_cast<uint64_t>(m_header.entryCount))
+			|| m_header.namesOffset > fileSize)
+		{
+			m_file.close();
+			return false;
+		}
+
+		m_entries = reinterpret_cast<const AssetPackEntry*>(m_file.data() + m_header.entriesOffset);
+		m_names = reinterpret_cast<const char*>(m_file.data() + m_header.namesOffset);
+
+		for (uint32_t i = 0; i < m_header.entryCount; ++i)
+		{
+			const AssetPackEntry& entry{ m_entries[i] };
+			if (!fits(m_header.namesOffset + entry.nameOffset, entry.nameLength) || !fits(entry.dataOffset, entry.dataSize))
+			{
+				m_entries = nullptr;
+				m_names = nullptr;
+				m_file.close();
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	bool AssetPack::is_open() const
+	{
+		return m_entries != nullptr;
+	}
+
+	const AssetPack::AssetPackEntry* AssetPack::find(std::string_view name) const
+	{
+		if (!is_open())
+		{
+			return nullptr;
+		}
+
+		const std::string normalizedName{ normalize_name(name) };
+		const uint64_t nameHash{ hash_bytes(normalizedName.data(), normalizedName.size()) };
+
+		// Binary search on the hash, then compare the names of the (rare) entries sharing it
+		const AssetPackEntry* entriesEnd{ m_entries + m_header.entryCount };
+		const AssetPackEntry* entry{ std::lower_bound(m_entries, entriesEnd, nameHash, 
+			[](const AssetPackEntry& entry, uint64_t hash) { return entry.nameHash < hash; }) };
+		for (; entry != entriesEnd && entry->nameHash == nameHash; ++entry)
+		{
+			if (std::string_view(m_names + entry->nameOffset, entry->nameLength) == normalizedName)
+			{
+				return entry;
+			}
+		}
+
+		return nullptr;
+	}
+
+	std::span<const unsigned char> AssetPack::get_data(const AssetPackEntry& entry) const
+	{
+		return { m_file.data() + entry.dataOffset, static_cast<size_t>(entry.dataSize) };
+	}
+
+	bool AssetPack::open_asset(std::string_view name, AssetFile* file) const
+	{
+		const AssetPackEntry* entry{ find(name) };
+		if (entry != nullptr)
+		{
+			*file = AssetFile(get_data(*entry));
+			return true;
+		}
+
+		MappedFile looseFile{};
+		if (!looseFile.open(std::string(name)))
+		{
+			return false;
+		}
+
+		*file = AssetFile(std::move(looseFile));
+		return true;
+	}
+
+	AssetFile AssetPack::get_asset(std::string_view name) const
+	{
+		AssetFile file{};
+		if (!open_asset(name, &file))
+		{
+			throw std::runtime_error("Failed to open asset " + std::string(name) + "!");
+		}
+		return file;
+	}
+
+	uint64_t AssetPack::write(const std::string& fileName, const std::vector<AssetSource>& sources)
+	{
+		struct PackedSource {
+			AssetPackEntry entry;
+			std::string name;
+			MappedFile file;
+		};
+
+		std::vector<PackedSource> packedSources(sources.size());
+		for (size_t i = 0; i < sources.size(); ++i)
+		{
+			PackedSource& packedSource{ packedSources[i] };
+			packedSource.name = normalize_name(sources[i].name);
+			if (!packedSource.file.open(sources[i].filePath, MappedFileAccess::Sequential))
+			{
+				throw std::runtime_error("Failed to open asset file " + sources[i].filePath + "!");
+			}
+
+			packedSource.entry = {
+				.nameHash = hash_bytes(packedSource.name.data(), packedSource.name.size()),
+				.contentHash = hash_asset_content(packedSource.file.span()),
+				.dataSize = packedSource.file.size(),
+				.nameLength = static_cast<uint32_t>(packedSource.name.size()),
+			};
+		}
+
+		std::sort(packedSources.begin(), packedSources.end(), [](const PackedSource& a, const PackedSource& b) {
+			return a.entry.nameHash != b.entry.nameHash ? a.entry.nameHash < b.entry.nameHash : a.name < b.name;
+		});
+
+		// Lay out the sections
+		AssetPackHeader header{};
+		memcpy(header.magic, ASSET_PACK_MAGIC, sizeof(ASSET_PACK_MAGIC));
+		header.version = ASSET_PACK_VERSION;
+		header.entryCount = static_cast<uint32_t>(packedSources.size());
+		header.entriesOffset = align_offset(sizeof(AssetPackHeader));
+		header.namesOffset = header.entriesOffset + sizeof(AssetPackEntry) * packedSources.size();
+
+		std::string names{};
+		for (PackedSource& packedSource : packedSources)
+		{
+			packedSource.entry.nameOffset = static_cast<uint32_t>(names.size());
+			names += packedSource.name;
+		}
+
+		uint64_t dataOffset{ align_offset(header.namesOffset + names.size()) };
+		for (PackedSource& packedSource : packedSources)
+		{
+			packedSource.entry.dataOffset = dataOffset;
+			dataOffset = align_offset(dataOffset + packedSource.entry.dataSize);
+		}
+		header.fileSize = packedSources.empty() ? align_offset(header.namesOffset + names.size())
+			: packedSources.back().entry.dataOffset + packedSources.back().entry.dataSize;
+
+		// Write to a temporary file and swap it in, so the renderer never maps a partially written pack
+		const std::string temporaryFileName{ fileName + ".tmp" };
+		{
+			std::ofstream file(temporaryFileName, std::ios::binary | std::ios::trunc);
+			if (!file.is_open())
+			{
+				throw std::runtime_error("Failed to create asset pack " + fileName + "!");
+			}
+
+			const char padding[ASSET_PACK_ALIGNMENT]{};
+			auto pad_to{ [&file, &padding](uint64_t offset) {
+				file.write(padding, offset - static_cast<uint64_t>(file.tellp()));
+			} };
+
+			file.write(reinterpret_cast<const char*>(&header), sizeof(AssetPackHeader));
+			pad_to(header.entriesOffset);
+			for (const PackedSource& packedSource : packedSources)
+			{
+				file.write(reinterpret_cast<const char*>(&packedSource.entry), sizeof(AssetPackEntry));
+			}
+			file.write(names.data(), names.size());
+
+			for (const PackedSource& packedSource : packedSources)
+			{
+				pad_to(packedSource.entry.dataOffset);
+				file.write(reinterpret_cast<const char*>(packedSource.file.data()), packedSource.file.size());
+			}
+			pad_to(header.fileSize);
+
+			if (!file)
+			{
+				throw std::runtime_error("Failed to write asset pack " + fileName + "!");
+			}
+		}
+
+		std::error_code error;
+		std::filesystem::rename(temporaryFileName, fileName, error);
+		if (error)
+		{
+			std::filesystem::remove(temporaryFileName, error);
+			throw std::runtime_error("Failed to write asset pack " + fileName + "!");
+		}
+
+		return header.fileSize;
+	}
+
+	std::string AssetPack::normalize_name(std::string_view name)
+	{
+		std::string normalizedName{ name };
+		std::replace(normalizedName.begin(), normalizedName.end(), '\\', '/');
+		while (normalizedName.starts_with("./"))
+		{
+			normalizedName.erase(0, 2);
+		}
+		return normalizedName;
+	}
+
+	uint64_t hash_asset_content(std::span<const unsigned char> data)
+	{
+		uint64_t hash{ hash_bytes(data.data(), data.size()) };
+
+		// Size is mixed in too, so that a collision also needs files of the same length
+		const uint64_t size{ data.size() };
+		hash = hash_bytes(&size, sizeof(size), hash);
+		return hash != 0 ? hash : 1;
+	}
+
+}
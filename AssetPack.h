@@ -0,0 +1,101 @@
+#pragma once
+#include "MappedFile.h"
+
+#include <string>
+#include <string_view>
+#include <span>
+#include <vector>
+#include <cstdint>
+
+namespace VkCourse {
+
+	// Increase whenever the layout of the pack file changes
+	constexpr uint32_t ASSET_PACK_VERSION{ 1 };
+
+	// Contents of one asset, either a view into the mapped pack or its own mapping of the loose file
+	class AssetFile
+	{
+	public:
+		AssetFile();
+		AssetFile(std::span<const unsigned char> packedData);
+		AssetFile(MappedFile&& file);
+
+		const unsigned char* data() const;
+		size_t size() const;
+		std::span<const unsigned char> span() const;
+
+	private:
+		MappedFile m_file{};
+		std::span<const unsigned char> m_data{};
+	};
+
+	// Single file archive of the assets (models, textures, shaders) so that they are all reached through
+	// one mapping instead of an open and a read each. Written by Tools/AssetPacker. File layout:
+	// - AssetPackHeader
+	// - AssetPackEntry[entryCount]		(sorted by name hash, then name)
+	// - Name characters
+	// - Asset data, each blob aligned to ASSET_PACK_ALIGNMENT
+	// Names are paths relative to the working directory with '/' separators, e.g. "Models/Seahawk.obj".
+	class AssetPack
+	{
+	public:
+		static constexpr uint64_t ASSET_PACK_ALIGNMENT{ 16 };
+
+		struct AssetPackHeader {
+			char magic[8];
+			uint32_t version;
+			uint32_t entryCount;
+			uint64_t entriesOffset;
+			uint64_t namesOffset;
+			uint64_t fileSize;
+		};
+
+		struct AssetPackEntry {
+			uint64_t nameHash;
+			uint64_t contentHash;		// hash_asset_content() of the data
+			uint64_t dataOffset;
+			uint64_t dataSize;
+			uint32_t nameOffset;		// Relative to namesOffset
+			uint32_t nameLength;
+		};
+
+		struct AssetSource {
+			std::string name;
+			std::string filePath;
+		};
+
+		AssetPack();
+
+		~AssetPack();
+
+		// Returns false if the file is missing or is not a valid pack, loaders then only use loose files
+		bool open(const std::string& fileName);
+		bool is_open() const;
+
+		// nullptr if the asset is not in the pack
+		const AssetPackEntry* find(std::string_view name) const;
+		std::span<const unsigned char> get_data(const AssetPackEntry& entry) const;
+
+		// Asset from the pack if it has it, otherwise the loose file. Returns false if neither exists
+		bool open_asset(std::string_view name, AssetFile* file) const;
+
+		// Throwing version of open_asset()
+		AssetFile get_asset(std::string_view name) const;
+
+		// Writes the given files into a pack, returns the number of bytes written
+		static uint64_t write(const std::string& fileName, const std::vector<AssetSource>& sources);
+
+		// Pack names use '/' and no leading "./"
+		static std::string normalize_name(std::string_view name);
+
+	private:
+		MappedFile m_file{};
+		AssetPackHeader m_header{};
+		const AssetPackEntry* m_entries{ nullptr };
+		const char* m_names{ nullptr };
+	};
+
+	// Content hash shared by the pack index and the texture registry (never 0)
+	uint64_t hash_asset_content(std::span<const unsigned char> data);
+
+}
@@ -0,0 +1,239 @@
+#include "Benchmark.h"
+#include "Json.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+namespace VkCourse {
+
+	namespace {
+		BenchmarkPercentiles get_percentiles(std::vector<double> values)
+		{
+			BenchmarkPercentiles percentiles{};
+			if (values.empty())
+			{
+				return percentiles;
+			}
+
+			std::sort(values.begin(), values.end());
+
+			// Nearest rank
+			const auto get_percentile = [&values](double percentile) {
+				const size_t rank{ static_cast<size_t>(std::ceil(percentile / 100. * values.size())) };
+				return values[std::clamp<size_t>(rank, 1, values.size()) - 1];
+			};
+
+			double sum{};
+			for (const double value : values)
+			{
+				sum += value;
+			}
+
+			percentiles.mean = sum / values.size();
+			percentiles.p50 = get_percentile(50.);
+			percentiles.p95 = get_percentile(95.);
+			percentiles.p99 = get_percentile(99.);
+			percentiles.max = values.back();
+			return percentiles;
+		}
+
+		glm::mat4 get_camera_view(const std::vector<BenchmarkCameraKeyframe>& cameraPath, float time)
+		{
+			// Linear between the keyframes around the time, clamped to the first and last ones
+			size_t next{ 0 };
+			while (next < cameraPath.size() && cameraPath[next].time < time)
+			{
+				++next;
+			}
+
+			const BenchmarkCameraKeyframe& from{ cameraPath[next == 0 ? 0 : next - 1] };
+			const BenchmarkCameraKeyframe& to{ cameraPath[std::min(next, cameraPath.size() - 1)] };
+			const float segment{ to.time - from.time };
+			const float blend{ segment > 0.f ? std::clamp((time - from.time) / segment, 0.f, 1.f) : 0.f };
+
+			return glm::lookAt(glm::mix(from.position, to.position, blend), glm::mix(from.target, to.target, blend),
+				glm::vec3(0.f, 1.f, 0.f));
+		}
+
+		void write_json_percentiles(std::ostringstream& json, const char* name, const BenchmarkPercentiles& percentiles)
+		{
+			json << ",\"" << name << "\":{\"mean\":" << percentiles.mean << ",\"p50\":" << percentiles.p50
+				<< ",\"p95\":" << percentiles.p95 << ",\"p99\":" << percentiles.p99 << ",\"max\":" << percentiles.max << "}";
+		}
+	}
+
+	BenchmarkScene BenchmarkScene::load(const std::string& fileName)
+	{
+		std::ifstream file(fileName);
+		if (!file.is_open())
+		{
+			throw std::runtime_error("Failed to open benchmark scene " + fileName + "!");
+		}
+
+		BenchmarkScene scene{ .fileName = fileName };
+		std::string line;
+		for (size_t lineNumber = 1; std::getline(file, line); ++lineNumber)
+		{
+			line = line.substr(0, line.find('#'));
+
+			std::istringstream stream(line);
+			std::string keyword;
+			if (!(stream >> keyword))
+			{
+				continue;
+			}
+
+			bool valid{ false };
+			if (keyword == "resolution")
+			{
+				valid = static_cast<bool>(stream >> scene.width >> scene.height) && scene.width > 0 && scene.height > 0;
+			}
+			else if (keyword == "frames")
+			{
+				valid = static_cast<bool>(stream >> scene.frameCount) && scene.frameCount > 0;
+			}
+			else if (keyword == "warmup")
+			{
+				valid = static_cast<bool>(stream >> scene.warmupFrameCount);
+			}
+			else if (keyword == "model")
+			{
+				BenchmarkModel model{};
+				valid = static_cast<bool>(stream >> model.fileName >> model.instanceCount >> model.spacing >> model.scale);
+				scene.models.push_back(model);
+			}
+			else if (keyword == "camera")
+			{
+				BenchmarkCameraKeyframe keyframe{};
+				valid = static_cast<bool>(stream >> keyframe.time
+					>> keyframe.position.x >> keyframe.position.y >> keyframe.position.z
+					>> keyframe.target.x >> keyframe.target.y >> keyframe.target.z);
+				scene.cameraPath.push_back(keyframe);
+			}
+
+			if (!valid)
+			{
+				throw std::runtime_error("Invalid line " + std::to_string(lineNumber) + " in benchmark scene " + fileName + "!");
+			}
+		}
+
+		std::stable_sort(scene.cameraPath.begin(), scene.cameraPath.end(),
+			[](const BenchmarkCameraKeyframe& a, const BenchmarkCameraKeyframe& b) { return a.time < b.time; });
+
+		return scene;
+	}
+
+	std::string BenchmarkResult::to_json() const
+	{
+		std::ostringstream json{};
+		json << "{\"scene\":";
+		write_json_string(json, sceneFileName);
+		json << ",\"device\":";
+		write_json_string(json, deviceName);
+		json << ",\"width\":" << width << ",\"height\":" << height << ",\"frames\":" << frameCount;
+		json << ",\"loadMs\":" << loadMilliseconds;
+		write_json_percentiles(json, "frameMs", frameMilliseconds);
+		write_json_percentiles(json, "cpuWaitMs", waitMilliseconds);
+		write_json_percentiles(json, "cpuUpdateMs", updateMilliseconds);
+		write_json_percentiles(json, "cpuRecordMs", recordMilliseconds);
+		write_json_percentiles(json, "cpuSubmitMs", submitMilliseconds);
+		write_json_percentiles(json, "gpuMs", gpuMilliseconds);
+		json << ",\"gpuScopesMs\":{";
+		for (size_t i = 0; i < gpuScopes.size(); ++i)
+		{
+			json << (i > 0 ? "," : "");
+			write_json_string(json, gpuScopes[i].name);
+			json << ":" << gpuScopes[i].averageMilliseconds;
+		}
+		json << "}";
+		json << ",\"draws\":" << drawCount << ",\"triangles\":" << triangleCount;
+		json << ",\"deviceMemoryBytes\":" << deviceMemoryBytes << "}";
+		return json.str();
+	}
+
+	BenchmarkResult run_benchmark(VulkanRenderer& renderer, const BenchmarkScene& scene)
+	{
+		BenchmarkResult result{
+			.sceneFileName = scene.fileName,
+			.deviceName = renderer.get_device_name(),
+			.width = scene.width,
+			.height = scene.height,
+			.frameCount = scene.frameCount,
+		};
+
+		// Scene
+		const auto loadStart{ std::chrono::steady_clock::now() };
+		for (const BenchmarkModel& model : scene.models)
+		{
+			const uint32_t gridSize{ static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<float>(model.instanceCount)))) };
+			const float gridOffset{ 0.5f * (gridSize - 1) * model.spacing };
+			for (uint32_t i = 0; i < model.instanceCount; ++i)
+			{
+				const glm::vec3 position{ (i % gridSize) * model.spacing - gridOffset, 0.f, (i / gridSize) * model.spacing - gridOffset };
+				const size_t modelId{ renderer.create_mesh_model(model.fileName) };
+				renderer.update_model_matrix(modelId, glm::scale(glm::translate(glm::mat4(1.f), position), glm::vec3(model.scale)));
+			}
+		}
+		const std::chrono::duration<double, std::milli> loadTime{ std::chrono::steady_clock::now() - loadStart };
+		result.loadMilliseconds = loadTime.count();
+
+		// Pipelines, texture streaming and caches settle during the warmup
+		if (!scene.cameraPath.empty())
+		{
+			renderer.update_view_matrix(get_camera_view(scene.cameraPath, 0.f));
+		}
+		for (uint32_t frame = 0; frame < scene.warmupFrameCount; ++frame)
+		{
+			renderer.draw();
+		}
+
+		std::vector<double> frameTimes, waitTimes, updateTimes, recordTimes, submitTimes, gpuTimes;
+		frameTimes.reserve(scene.frameCount);
+		auto frameStart{ std::chrono::steady_clock::now() };
+		for (uint32_t frame = 0; frame < scene.frameCount; ++frame)
+		{
+			if (!scene.cameraPath.empty())
+			{
+				const float time{ scene.frameCount > 1 ? static_cast<float>(frame) / (scene.frameCount - 1) : 0.f };
+				renderer.update_view_matrix(get_camera_view(scene.cameraPath, time));
+			}
+
+			renderer.draw();
+
+			const FrameStats& stats{ renderer.get_frame_stats() };
+			waitTimes.push_back(stats.waitMilliseconds);
+			updateTimes.push_back(stats.updateMilliseconds);
+			recordTimes.push_back(stats.recordMilliseconds);
+			submitTimes.push_back(stats.submitMilliseconds);
+			// GPU times are of the frame MAX_FRAME_DRAWS earlier, the first ones are still warmup frames
+			if (frame >= MAX_FRAME_DRAWS && stats.gpuMilliseconds >= 0.)
+			{
+				gpuTimes.push_back(stats.gpuMilliseconds);
+			}
+			result.drawCount = stats.drawCount;
+			result.triangleCount = stats.triangleCount;
+
+			// From the start of this frame to the start of the next one
+			const auto frameEnd{ std::chrono::steady_clock::now() };
+			const std::chrono::duration<double, std::milli> frameTime{ frameEnd - frameStart };
+			frameTimes.push_back(frameTime.count());
+			frameStart = frameEnd;
+		}
+
+		result.frameMilliseconds = get_percentiles(frameTimes);
+		result.waitMilliseconds = get_percentiles(waitTimes);
+		result.updateMilliseconds = get_percentiles(updateTimes);
+		result.recordMilliseconds = get_percentiles(recordTimes);
+		result.submitMilliseconds = get_percentiles(submitTimes);
+		result.gpuMilliseconds = get_percentiles(gpuTimes);
+		result.gpuScopes = renderer.get_gpu_profiler().get_timings();
+		result.deviceMemoryBytes = renderer.get_device_memory_usage();
+
+		return result;
+	}
+
+}
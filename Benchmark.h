@@ -0,0 +1,77 @@
+#pragma once
+
+#include "VulkanRenderer.h"
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace VkCourse {
+
+	// Instances of a model laid out on a square grid in the XZ plane, centered on the origin
+	struct BenchmarkModel {
+		std::string fileName;
+		uint32_t instanceCount{ 1 };
+		float spacing{ 1.f };
+		float scale{ 1.f };
+	};
+
+	// The camera moves linearly between keyframes, time goes from 0 (first measured frame) to 1 (last one)
+	struct BenchmarkCameraKeyframe {
+		float time;
+		glm::vec3 position;
+		glm::vec3 target;
+	};
+
+	// Read from a text file, one setting per line ('#' starts a comment):
+	//   resolution <width> <height>
+	//   frames <measured frame count>
+	//   warmup <frames drawn before measuring>
+	//   model <file> <instance count> <spacing> <scale>
+	//   camera <time> <position x y z> <target x y z>
+	struct BenchmarkScene {
+		std::string fileName;
+		uint32_t width{ 1280 };
+		uint32_t height{ 720 };
+		uint32_t frameCount{ 600 };
+		uint32_t warmupFrameCount{ 60 };
+		std::vector<BenchmarkModel> models{};
+		std::vector<BenchmarkCameraKeyframe> cameraPath{};		// Sorted by time, the default view of the renderer if empty
+
+		// Throws if the file can't be read or a line is invalid
+		static BenchmarkScene load(const std::string& fileName);
+	};
+
+	struct BenchmarkPercentiles {
+		double mean{};
+		double p50{};
+		double p95{};
+		double p99{};
+		double max{};
+	};
+
+	struct BenchmarkResult {
+		std::string sceneFileName;
+		std::string deviceName;
+		uint32_t width{};
+		uint32_t height{};
+		uint32_t frameCount{};
+		double loadMilliseconds{};
+		BenchmarkPercentiles frameMilliseconds{};		// Between the starts of consecutive draw() calls
+		BenchmarkPercentiles waitMilliseconds{};		// See FrameStats
+		BenchmarkPercentiles updateMilliseconds{};
+		BenchmarkPercentiles recordMilliseconds{};
+		BenchmarkPercentiles submitMilliseconds{};
+		BenchmarkPercentiles gpuMilliseconds{};			// Over the frames that were measured
+		std::vector<GpuScopeTiming> gpuScopes{};		// Averages over the last measured frames of each pass and subpass
+		uint32_t drawCount{};							// Per frame, of the last one
+		uint64_t triangleCount{};
+		uint64_t deviceMemoryBytes{};					// After the last frame, 0 if not reported by the driver
+
+		std::string to_json() const;
+	};
+
+	// Loads the scene into an initialized renderer, draws the warmup frames then measures the others
+	BenchmarkResult run_benchmark(VulkanRenderer& renderer, const BenchmarkScene& scene);
+
+}
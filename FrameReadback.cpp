@@ -0,0 +1,141 @@
+#include "FrameReadback.h"
+#include "Utilities.h"
+
+#include <stdexcept>
+
+namespace VkCourse {
+
+	FrameReadback::FrameReadback()
+	{
+	}
+
+	FrameReadback::~FrameReadback()
+	{
+	}
+
+	void FrameReadback::create(VkPhysicalDevice physicalDevice, VkDevice device, VkExtent2D extent, VkFormat format, uint32_t slotCount)
+	{
+		m_device = device;
+		m_extent = extent;
+		m_format = format;
+
+		// The CPU reads every byte, cached memory avoids uncached reads where the device has some
+		VkMemoryPropertyFlags memoryPropertyFlags{ VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT };
+		uint32_t memoryTypeIndex;
+		if (!try_find_memory_type_index(physicalDevice, UINT32_MAX, memoryPropertyFlags, &memoryTypeIndex))
+		{
+			memoryPropertyFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+		}
+
+		const VkDeviceSize bufferSize{ static_cast<VkDeviceSize>(extent.width) * extent.height * 4 };
+		m_slots.resize(slotCount);
+		for (Slot& slot : m_slots)
+		{
+			create_buffer(physicalDevice, m_device, bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT, memoryPropertyFlags,
+				&slot.buffer, &slot.memory);
+
+			void* data;
+			if (vkMapMemory(m_device, slot.memory, 0, VK_WHOLE_SIZE, 0, &data) != VK_SUCCESS)
+			{
+				throw std::runtime_error("Failed to map a readback buffer!");
+			}
+			slot.data = static_cast<unsigned char*>(data);
+			slot.frameNumber = 0;
+			slot.pending = false;
+		}
+
+		// Same memory type for every slot, non coherent memory is invalidated before it is read
+		VkPhysicalDeviceMemoryProperties memoryProperties;
+		vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+		VkMemoryRequirements memoryRequirements;
+		vkGetBufferMemoryRequirements(m_device, m_slots[0].buffer, &memoryRequirements);
+		const uint32_t slotMemoryTypeIndex{ find_memory_type_index(physicalDevice, memoryRequirements.memoryTypeBits, memoryPropertyFlags) };
+		m_coherent = (memoryProperties.memoryTypes[slotMemoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+	}
+
+	void FrameReadback::destroy()
+	{
+		for (const Slot& slot : m_slots)
+		{
+			vkUnmapMemory(m_device, slot.memory);
+			vkDestroyBuffer(m_device, slot.buffer, nullptr);
+			vkFreeMemory(m_device, slot.memory, nullptr);
+		}
+		m_slots.clear();
+	}
+
+	bool FrameReadback::is_created() const
+	{
+		return !m_slots.empty();
+	}
+
+	void FrameReadback::record_copy(VkCommandBuffer commandBuffer, uint32_t slot, VkImage image, uint64_t frameNumber)
+	{
+		// Tightly packed rows
+		VkBufferImageCopy imageRegion{
+			.bufferOffset = 0,
+			.bufferRowLength = 0,
+			.bufferImageHeight = 0,
+			.imageSubresource = {
+				.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+				.mipLevel = 0,
+				.baseArrayLayer = 0,
+				.layerCount = 1,
+			},
+			.imageOffset = { 0, 0, 0 },
+			.imageExtent = { m_extent.width, m_extent.height, 1 },
+		};
+
+		vkCmdCopyImageToBuffer(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, m_slots[slot].buffer, 1, &imageRegion);
+
+		// Makes the copy visible to the host once the fence is signaled
+		VkBufferMemoryBarrier bufferMemoryBarrier{
+			.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+			.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+			.dstAccessMask = VK_ACCESS_HOST_READ_BIT,
+			.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+			.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+			.buffer = m_slots[slot].buffer,
+			.offset = 0,
+			.size = VK_WHOLE_SIZE,
+		};
+
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0,
+			0, nullptr, 1, &bufferMemoryBarrier, 0, nullptr);
+
+		m_slots[slot].frameNumber = frameNumber;
+		m_slots[slot].pending = true;
+	}
+
+	void FrameReadback::deliver(uint32_t slot, const ReadbackCallback& callback)
+	{
+		if (slot >= m_slots.size() || !m_slots[slot].pending)
+		{
+			return;
+		}
+		m_slots[slot].pending = false;
+
+		const size_t size{ static_cast<size_t>(m_extent.width) * m_extent.height * 4 };
+		if (!m_coherent)
+		{
+			VkMappedMemoryRange memoryRange{
+				.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE,
+				.memory = m_slots[slot].memory,
+				.offset = 0,
+				.size = VK_WHOLE_SIZE,
+			};
+			vkInvalidateMappedMemoryRanges(m_device, 1, &memoryRange);
+		}
+
+		const ReadbackFrame frame{
+			.frameNumber = m_slots[slot].frameNumber,
+			.width = m_extent.width,
+			.height = m_extent.height,
+			.format = m_format,
+			.rowPitch = m_extent.width * 4,
+			.pixels = { m_slots[slot].data, size },
+		};
+		callback(frame);
+	}
+
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <functional>
+#include <span>
+#include <vector>
+#include <cstdint>
+
+namespace VkCourse {
+
+	// Pixels of a rendered frame, only valid during the callback (copy them to keep them)
+	struct ReadbackFrame {
+		uint64_t frameNumber;
+		uint32_t width;
+		uint32_t height;
+		VkFormat format;					// 4 bytes per pixel, R8G8B8A8 or B8G8R8A8 depending on the swapchain
+		uint32_t rowPitch;					// Bytes
+		std::span<const unsigned char> pixels;
+	};
+
+	using ReadbackCallback = std::function<void(const ReadbackFrame&)>;
+
+	// Copies the final image of each frame into a host visible staging buffer at the end of its command buffer.
+	// There is one buffer per frame in flight, so a frame is handed over once the fence of its slot has been waited
+	// for anyway, and the CPU never waits for the GPU because of the readback.
+	class FrameReadback
+	{
+	public:
+		FrameReadback();
+
+		~FrameReadback();
+
+		void create(VkPhysicalDevice physicalDevice, VkDevice device, VkExtent2D extent, VkFormat format, uint32_t slotCount);
+
+		void destroy();
+
+		bool is_created() const;
+
+		// The image has to be in TRANSFER_SRC_OPTIMAL with its writes visible to transfers
+		void record_copy(VkCommandBuffer commandBuffer, uint32_t slot, VkImage image, uint64_t frameNumber);
+
+		// Once the commands that copied into the slot have completed, hands their frame to the callback
+		void deliver(uint32_t slot, const ReadbackCallback& callback);
+
+	private:
+		struct Slot {
+			VkBuffer buffer;
+			VkDeviceMemory memory;
+			unsigned char* data;			// Persistently mapped
+			uint64_t frameNumber;
+			bool pending;					// Copy recorded, not delivered yet
+		};
+
+		VkDevice m_device{ VK_NULL_HANDLE };
+		VkExtent2D m_extent{};
+		VkFormat m_format{ VK_FORMAT_UNDEFINED };
+		bool m_coherent{ true };
+		std::vector<Slot> m_slots{};
+	};
+
+}
@@ -0,0 +1,238 @@
+#include "GpuProfiler.h"
+
+#include <stdexcept>
+#include <cstring>
+
+namespace VkCourse {
+
+	GpuProfiler::GpuProfiler()
+	{
+	}
+
+	GpuProfiler::~GpuProfiler()
+	{
+	}
+
+	void GpuProfiler::create(VkPhysicalDevice physicalDevice, VkDevice device, uint32_t queueFamilyIndex, uint32_t frameCount)
+	{
+		m_device = device;
+
+		uint32_t queueFamilyCount{};
+		vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, nullptr);
+		std::vector<VkQueueFamilyProperties> queueFamilyProperties(queueFamilyCount);
+		vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilyProperties.data());
+		m_timestampValidBits = queueFamilyProperties[queueFamilyIndex].timestampValidBits;
+
+		VkPhysicalDeviceProperties properties;
+		vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+		m_timestampPeriod = properties.limits.timestampPeriod;
+
+		if (m_timestampValidBits == 0)
+		{
+			return;
+		}
+
+		VkQueryPoolCreateInfo queryPoolCreateInfo{
+			.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+			.queryType = VK_QUERY_TYPE_TIMESTAMP,
+			.queryCount = 2 * MAX_GPU_SCOPES,
+		};
+
+		m_frames.resize(frameCount);
+		for (Frame& frame : m_frames)
+		{
+			if (vkCreateQueryPool(m_device, &queryPoolCreateInfo, nullptr, &frame.queryPool) != VK_SUCCESS)
+			{
+				throw std::runtime_error("Failed to create a timestamp query pool!");
+			}
+			frame.scopes.reserve(MAX_GPU_SCOPES);
+		}
+	}
+
+	void GpuProfiler::destroy()
+	{
+		for (const Frame& frame : m_frames)
+		{
+			vkDestroyQueryPool(m_device, frame.queryPool, nullptr);
+		}
+		m_frames.clear();
+	}
+
+	bool GpuProfiler::is_supported() const
+	{
+		return !m_frames.empty();
+	}
+
+	bool GpuProfiler::begin_frame(VkCommandBuffer commandBuffer, uint32_t frame)
+	{
+		if (!is_supported())
+		{
+			return false;
+		}
+
+		m_commandBuffer = commandBuffer;
+		m_frame = frame;
+
+		const bool read{ read_results(m_frames[m_frame]) };
+		m_frames[m_frame].scopes.clear();
+		vkCmdResetQueryPool(m_commandBuffer, m_frames[m_frame].queryPool, 0, 2 * MAX_GPU_SCOPES);
+
+		m_frameScope = begin_scope("frame");
+		return read;
+	}
+
+	void GpuProfiler::end_frame()
+	{
+		end_scope(m_frameScope);
+		m_frameScope = UINT32_MAX;
+		m_commandBuffer = VK_NULL_HANDLE;
+	}
+
+	uint32_t GpuProfiler::begin_scope(const char* name)
+	{
+		if (m_commandBuffer == VK_NULL_HANDLE || m_frames[m_frame].scopes.size() >= MAX_GPU_SCOPES)
+		{
+			return UINT32_MAX;
+		}
+
+		std::vector<RecordedScope>& scopes{ m_frames[m_frame].scopes };
+		const uint32_t scope{ static_cast<uint32_t>(scopes.size()) };
+		scopes.push_back({ .name = name, .firstQuery = 2 * scope });
+
+		vkCmdWriteTimestamp(m_commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, m_frames[m_frame].queryPool, 2 * scope);
+		return scope;
+	}
+
+	void GpuProfiler::end_scope(uint32_t scope)
+	{
+		if (m_commandBuffer == VK_NULL_HANDLE || scope == UINT32_MAX)
+		{
+			return;
+		}
+
+		vkCmdWriteTimestamp(m_commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_frames[m_frame].queryPool, 2 * scope + 1);
+	}
+
+	double GpuProfiler::get_last_milliseconds(const std::string& name) const
+	{
+		const auto history{ m_scopeHistories.find(name) };
+		if (history == m_scopeHistories.end())
+		{
+			return -1.;
+		}
+
+		const uint32_t lastSample{ (history->second.nextSample + GPU_PROFILER_AVERAGE_FRAMES - 1) % GPU_PROFILER_AVERAGE_FRAMES };
+		return history->second.samples[lastSample];
+	}
+
+	double GpuProfiler::get_average_milliseconds(const std::string& name) const
+	{
+		const auto history{ m_scopeHistories.find(name) };
+		if (history == m_scopeHistories.end())
+		{
+			return -1.;
+		}
+
+		return history->second.sum / history->second.sampleCount;
+	}
+
+	std::vector<GpuScopeTiming> GpuProfiler::get_timings() const
+	{
+		std::vector<GpuScopeTiming> timings{};
+		timings.reserve(m_scopeNames.size());
+		for (const std::string& name : m_scopeNames)
+		{
+			timings.push_back({
+				.name = name,
+				.lastMilliseconds = get_last_milliseconds(name),
+				.averageMilliseconds = get_average_milliseconds(name),
+			});
+		}
+		return timings;
+	}
+
+	bool GpuProfiler::read_results(Frame& frame)
+	{
+		if (frame.scopes.empty())
+		{
+			return false;
+		}
+
+		// Without waiting, the fence of this frame has been waited for by the renderer
+		std::array<uint64_t, 2 * MAX_GPU_SCOPES> timestamps{};
+		const uint32_t queryCount{ static_cast<uint32_t>(2 * frame.scopes.size()) };
+		VkResult result{ vkGetQueryPoolResults(m_device, frame.queryPool, 0, queryCount, queryCount * sizeof(uint64_t),
+			timestamps.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) };
+		if (result != VK_SUCCESS)
+		{
+			return false;
+		}
+
+		// Only the valid bits count, they wrap around
+		const uint64_t mask{ m_timestampValidBits >= 64 ? UINT64_MAX : (1ull << m_timestampValidBits) - 1 };
+
+		// Scopes sharing a name add up
+		std::vector<std::pair<const char*, double>> totals{};
+		for (const RecordedScope& scope : frame.scopes)
+		{
+			const uint64_t ticks{ (timestamps[scope.firstQuery + 1] - timestamps[scope.firstQuery]) & mask };
+			const double milliseconds{ static_cast<double>(ticks) * m_timestampPeriod / 1e6 };
+
+			auto total{ totals.begin() };
+			while (total != totals.end() && strcmp(total->first, scope.name) != 0)
+			{
+				++total;
+			}
+
+			if (total == totals.end())
+			{
+				totals.push_back({ scope.name, milliseconds });
+			}
+			else
+			{
+				total->second += milliseconds;
+			}
+		}
+
+		for (const auto& [name, milliseconds] : totals)
+		{
+			add_sample(name, milliseconds);
+		}
+		return true;
+	}
+
+	void GpuProfiler::add_sample(const std::string& name, double milliseconds)
+	{
+		auto [history, inserted] { m_scopeHistories.try_emplace(name, ScopeHistory{}) };
+		if (inserted)
+		{
+			m_scopeNames.push_back(name);
+		}
+
+		// The oldest sample leaves the window once it is full
+		ScopeHistory& scopeHistory{ history->second };
+		if (scopeHistory.sampleCount == GPU_PROFILER_AVERAGE_FRAMES)
+		{
+			scopeHistory.sum -= scopeHistory.samples[scopeHistory.nextSample];
+		}
+		else
+		{
+			++scopeHistory.sampleCount;
+		}
+
+		scopeHistory.samples[scopeHistory.nextSample] = milliseconds;
+		scopeHistory.sum += milliseconds;
+		scopeHistory.nextSample = (scopeHistory.nextSample + 1) % GPU_PROFILER_AVERAGE_FRAMES;
+	}
+
+	GpuScope::GpuScope(GpuProfiler& profiler, const char* name)
+		: m_profiler{ profiler }, m_scope{ profiler.begin_scope(name) }
+	{
+	}
+
+	GpuScope::~GpuScope()
+	{
+		m_profiler.end_scope(m_scope);
+	}
+
+}
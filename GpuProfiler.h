@@ -0,0 +1,110 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <array>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <cstdint>
+
+// Times the GPU work recorded until the end of the enclosing block, name is a string literal
+#define GPU_SCOPE_CONCAT_IMPL(a, b) a##b
+#define GPU_SCOPE_CONCAT(a, b) GPU_SCOPE_CONCAT_IMPL(a, b)
+#define GPU_SCOPE(profiler, name) VkCourse::GpuScope GPU_SCOPE_CONCAT(gpuScope, __LINE__){ profiler, name }
+
+namespace VkCourse {
+
+	constexpr uint32_t MAX_GPU_SCOPES{ 32 };				// Per frame, the frame itself included
+	constexpr uint32_t GPU_PROFILER_AVERAGE_FRAMES{ 60 };	// Frames the averages are over
+
+	struct GpuScopeTiming {
+		std::string name;
+		double lastMilliseconds;				// Of the latest frame measured
+		double averageMilliseconds;				// Over the last GPU_PROFILER_AVERAGE_FRAMES frames measured
+	};
+
+	// Timestamps around the scopes of each frame's command buffer, in one query pool per frame in flight. A pool is
+	// read when its frame is recorded again, so its previous submission has completed and results come without
+	// stalling, MAX_FRAME_DRAWS frames late. Scopes with the same name in a frame add up. The whole command buffer
+	// is the "frame" scope. Does nothing if the queue doesn't support timestamps.
+	class GpuProfiler
+	{
+	public:
+		GpuProfiler();
+
+		~GpuProfiler();
+
+		void create(VkPhysicalDevice physicalDevice, VkDevice device, uint32_t queueFamilyIndex, uint32_t frameCount);
+
+		void destroy();
+
+		bool is_supported() const;
+
+		// At the start of the frame's command buffer, outside of a render pass (the queries are reset there), once the
+		// frame's previous submission has completed. True if its results were read.
+		bool begin_frame(VkCommandBuffer commandBuffer, uint32_t frame);
+		void end_frame();
+
+		// Returns the scope to end, scopes over MAX_GPU_SCOPES are not timed
+		uint32_t begin_scope(const char* name);
+		void end_scope(uint32_t scope);
+
+		// Negative if the scope was never measured
+		double get_last_milliseconds(const std::string& name) const;
+		double get_average_milliseconds(const std::string& name) const;
+
+		// In the order the scopes were first measured
+		std::vector<GpuScopeTiming> get_timings() const;
+
+	private:
+		struct RecordedScope {
+			const char* name;
+			uint32_t firstQuery;				// Begin timestamp, the end one follows
+		};
+
+		struct Frame {
+			VkQueryPool queryPool;
+			std::vector<RecordedScope> scopes;	// Recorded in the command buffer last submitted for this frame
+		};
+
+		struct ScopeHistory {
+			std::array<double, GPU_PROFILER_AVERAGE_FRAMES> samples;
+			uint32_t sampleCount;
+			uint32_t nextSample;
+			double sum;
+		};
+
+		VkDevice m_device{ VK_NULL_HANDLE };
+		uint32_t m_timestampValidBits{};		// 0 if timestamps are not supported
+		float m_timestampPeriod{};				// Nanoseconds per tick
+		std::vector<Frame> m_frames{};
+
+		VkCommandBuffer m_commandBuffer{ VK_NULL_HANDLE };		// Being recorded
+		uint32_t m_frame{};
+		uint32_t m_frameScope{ UINT32_MAX };
+
+		std::vector<std::string> m_scopeNames{};
+		std::unordered_map<std::string, ScopeHistory> m_scopeHistories{};
+
+		bool read_results(Frame& frame);
+		void add_sample(const std::string& name, double milliseconds);
+	};
+
+	// Ends its scope when destroyed, see GPU_SCOPE
+	class GpuScope
+	{
+	public:
+		GpuScope(GpuProfiler& profiler, const char* name);
+
+		~GpuScope();
+
+		GpuScope(const GpuScope&) = delete;
+		GpuScope& operator=(const GpuScope&) = delete;
+
+	private:
+		GpuProfiler& m_profiler;
+		uint32_t m_scope;
+	};
+
+}
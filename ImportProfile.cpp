@@ -0,0 +1,82 @@
+#include "ImportProfile.h"
+#include "Json.h"
+
+#include <sstream>
+
+namespace VkCourse {
+
+	ImportStage ImportProfile::get_stage(const std::string& name) const
+	{
+		ImportStage total{ .name = name };
+		for (const ImportStage& stage : stages)
+		{
+			if (stage.name == name)
+			{
+				total.milliseconds += stage.milliseconds;
+				total.bytes += stage.bytes;
+				total.items += stage.items;
+			}
+		}
+		return total;
+	}
+
+	std::string ImportProfile::to_json() const
+	{
+		std::ostringstream json{};
+		json << "{\"model\":";
+		write_json_string(json, modelFileName);
+		json << ",\"meshCacheHit\":" << (meshCacheHit ? "true" : "false");
+		json << ",\"totalMs\":" << totalMilliseconds;
+		json << ",\"stages\":[";
+		for (size_t i = 0; i < stages.size(); ++i)
+		{
+			const ImportStage& stage{ stages[i] };
+			json << (i > 0 ? ",{\"name\":" : "{\"name\":");
+			write_json_string(json, stage.name);
+			json << ",\"ms\":" << stage.milliseconds << ",\"bytes\":" << stage.bytes << ",\"items\":" << stage.items << "}";
+		}
+		json << "],\"meshes\":[";
+		for (size_t i = 0; i < meshStats.size(); ++i)
+		{
+			const ImportMeshStats& mesh{ meshStats[i] };
+			json << (i > 0 ? "," : "") << "{\"acmrBefore\":" << mesh.acmrBefore << ",\"acmrAfter\":" << mesh.acmrAfter
+				<< ",\"atvrBefore\":" << mesh.atvrBefore << ",\"atvrAfter\":" << mesh.atvrAfter << "}";
+		}
+		json << "]}";
+		return json.str();
+	}
+
+	ImportStageTimer::ImportStageTimer(ImportProfile* profile, const std::string& name)
+		: m_profile{ profile }, m_stage{ .name = name }, m_start{ std::chrono::steady_clock::now() }
+	{
+	}
+
+	ImportStageTimer::~ImportStageTimer()
+	{
+		stop();
+	}
+
+	void ImportStageTimer::add_bytes(uint64_t bytes)
+	{
+		m_stage.bytes += bytes;
+	}
+
+	void ImportStageTimer::add_items(uint64_t items)
+	{
+		m_stage.items += items;
+	}
+
+	void ImportStageTimer::stop()
+	{
+		if (m_profile == nullptr)
+		{
+			return;
+		}
+
+		const std::chrono::duration<double, std::milli> time{ std::chrono::steady_clock::now() - m_start };
+		m_stage.milliseconds = time.count();
+		m_profile->stages.push_back(m_stage);
+		m_profile = nullptr;	// Recorded once
+	}
+
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <chrono>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace VkCourse {
+
+	struct ImportStage {
+		std::string name;
+		double milliseconds{};		// Wall time
+		uint64_t bytes{};			// Data read, decoded or uploaded by the stage
+		uint64_t items{};			// Meshes, materials, textures... depending on the stage
+	};
+
+	// Vertex cache statistics of one mesh before and after the import optimization, zero if it wasn't optimized
+	struct ImportMeshStats {
+		float acmrBefore{};
+		float acmrAfter{};
+		float atvrBefore{};
+		float atvrAfter{};
+	};
+
+	// Where the time of one create_mesh_model() call went, stage by stage in the order they ran
+	struct ImportProfile {
+		std::string modelFileName{};
+		bool meshCacheHit{ false };
+		double totalMilliseconds{};
+		std::vector<ImportStage> stages{};
+		std::vector<ImportMeshStats> meshStats{};		// Per mesh, empty on a mesh cache hit
+
+		// Sums of every stage with the given name, zero if it didn't run
+		ImportStage get_stage(const std::string& name) const;
+
+		std::string to_json() const;
+	};
+
+	// Adds a stage to the profile, timed from construction to stop() or destruction. A null profile records nothing
+	class ImportStageTimer
+	{
+	public:
+		ImportStageTimer(ImportProfile* profile, const std::string& name);
+
+		~ImportStageTimer();
+
+		ImportStageTimer(const ImportStageTimer&) = delete;
+		ImportStageTimer& operator=(const ImportStageTimer&) = delete;
+
+		void add_bytes(uint64_t bytes);
+		void add_items(uint64_t items);
+		void stop();
+
+	private:
+		ImportProfile* m_profile;
+		ImportStage m_stage;
+		std::chrono::steady_clock::time_point m_start;
+	};
+
+}
@@ -0,0 +1,43 @@
+#include "Json.h"
+
+#include <cstdio>
+
+namespace VkCourse {
+
+	void write_json_string(std::ostream& json, std::string_view value)
+	{
+		json << '"';
+		for (const char c : value)
+		{
+			switch (c)
+			{
+			case '"':
+				json << "\\\"";
+				break;
+			case '\\':
+				json << "\\\\";
+				break;
+			case '\n':
+				json << "\\n";
+				break;
+			case '\t':
+				json << "\\t";
+				break;
+			default:
+				if (static_cast<unsigned char>(c) < 0x20)
+				{
+					char escaped[8];
+					snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+					json << escaped;
+				}
+				else
+				{
+					json << c;
+				}
+				break;
+			}
+		}
+		json << '"';
+	}
+
+}
@@ -0,0 +1,11 @@
+#pragma once
+
+#include <ostream>
+#include <string_view>
+
+namespace VkCourse {
+
+	// Quoted and escaped (quotes, backslashes and control characters), for the JSON reports
+	void write_json_string(std::ostream& json, std::string_view value);
+
+}
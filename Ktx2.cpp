@@ -0,0 +1,346 @@
+#include "Ktx2.h"
+#include "MappedFile.h"
+
+#include <algorithm>
+#include <fstream>
+#include <cstring>
+#include <stdexcept>
+
+namespace VkCourse {
+
+	namespace {
+		constexpr unsigned char KTX2_IDENTIFIER[12]{ 0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A };
+
+		struct Ktx2Header {
+			unsigned char identifier[12];
+			uint32_t vkFormat;
+			uint32_t typeSize;
+			uint32_t pixelWidth;
+			uint32_t pixelHeight;
+			uint32_t pixelDepth;
+			uint32_t layerCount;
+			uint32_t faceCount;
+			uint32_t levelCount;
+			uint32_t supercompressionScheme;
+			uint32_t dfdByteOffset;
+			uint32_t dfdByteLength;
+			uint32_t kvdByteOffset;
+			uint32_t kvdByteLength;
+			uint64_t sgdByteOffset;
+			uint64_t sgdByteLength;
+		};
+		static_assert(sizeof(Ktx2Header) == 80);
+
+		struct Ktx2LevelIndex {
+			uint64_t byteOffset;
+			uint64_t byteLength;
+			uint64_t uncompressedByteLength;
+		};
+
+		// Data Format Descriptor values (Khronos Data Format Specification 1.3)
+		constexpr uint8_t KHR_DF_MODEL_RGBSDA{ 1 };
+		constexpr uint8_t KHR_DF_MODEL_BC1A{ 128 };
+		constexpr uint8_t KHR_DF_MODEL_BC3{ 130 };
+		constexpr uint8_t KHR_DF_MODEL_BC7{ 134 };
+		constexpr uint8_t KHR_DF_PRIMARIES_BT709{ 1 };
+		constexpr uint8_t KHR_DF_TRANSFER_LINEAR{ 1 };
+		constexpr uint8_t KHR_DF_CHANNEL_ALPHA{ 15 };
+
+		uint32_t get_block_size(VkFormat format)
+		{
+			switch (format)
+			{
+			case VK_FORMAT_R8G8B8A8_UNORM:
+				return 4;
+			case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+			case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+				return 8;
+			case VK_FORMAT_BC3_UNORM_BLOCK:
+			case VK_FORMAT_BC7_UNORM_BLOCK:
+				return 16;
+			default:
+				return 0;
+			}
+		}
+
+		bool is_block_compressed(VkFormat format)
+		{
+			return format != VK_FORMAT_R8G8B8A8_UNORM;
+		}
+
+		uint64_t align_to(uint64_t offset, uint64_t alignment)
+		{
+			return (offset + alignment - 1) / alignment * alignment;
+		}
+
+		void append_bytes(std::vector<unsigned char>* buffer, const void* data, size_t size)
+		{
+			const auto* bytes{ static_cast<const unsigned char*>(data) };
+			buffer->insert(buffer->end(), bytes, bytes + size);
+		}
+
+		struct DfdSample {
+			uint16_t bitOffset;
+			uint8_t bitLength;		// Minus one
+			uint8_t channelType;
+			uint8_t samplePosition[4];
+			uint32_t sampleLower;
+			uint32_t sampleUpper;
+		};
+
+		// Basic Data Format Descriptor block describing format
+		std::vector<unsigned char> build_dfd(VkFormat format)
+		{
+			uint8_t colorModel{};
+			uint8_t texelBlockDimension{};	// Minus one, same for x and y
+			std::vector<DfdSample> samples{};
+
+			switch (format)
+			{
+			case VK_FORMAT_R8G8B8A8_UNORM:
+				colorModel = KHR_DF_MODEL_RGBSDA;
+				for (uint8_t i = 0; i < 4; ++i)
+				{
+					samples.push_back({
+						.bitOffset = static_cast<uint16_t>(i * 8),
+						.bitLength = 7,
+						.channelType = static_cast<uint8_t>(i == 3 ? KHR_DF_CHANNEL_ALPHA : i),
+						.sampleUpper = 255,
+					});
+				}
+				break;
+			case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+			case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+				colorModel = KHR_DF_MODEL_BC1A;
+				texelBlockDimension = 3;
+				samples.push_back({ .bitOffset = 0, .bitLength = 63, .channelType = 0, .sampleUpper = UINT32_MAX });
+				break;
+			case VK_FORMAT_BC3_UNORM_BLOCK:
+				colorModel = KHR_DF_MODEL_BC3;
+				texelBlockDimension = 3;
+				samples.push_back({ .bitOffset = 0, .bitLength = 63, .channelType = KHR_DF_CHANNEL_ALPHA, .sampleUpper = UINT32_MAX });
+				samples.push_back({ .bitOffset = 64, .bitLength = 63, .channelType = 0, .sampleUpper = UINT32_MAX });
+				break;
+			case VK_FORMAT_BC7_UNORM_BLOCK:
+				colorModel = KHR_DF_MODEL_BC7;
+				texelBlockDimension = 3;
+				samples.push_back({ .bitOffset = 0, .bitLength = 127, .channelType = 0, .sampleUpper = UINT32_MAX });
+				break;
+			default:
+				throw std::runtime_error("Unsupported KTX2 format!");
+			}
+
+			const uint16_t blockSize{ static_cast<uint16_t>(24 + 16 * samples.size()) };
+			const uint32_t totalSize{ 4u + blockSize };
+			const uint32_t vendorAndType{ 0 };		// Khronos vendor, basic descriptor type
+			const uint16_t versionNumber{ 2 };
+			const uint8_t colorInfo[4]{ colorModel, KHR_DF_PRIMARIES_BT709, KHR_DF_TRANSFER_LINEAR, 0 };
+			const uint8_t texelBlockDimensions[4]{ texelBlockDimension, texelBlockDimension, 0, 0 };
+			const uint8_t bytesPlane[8]{ static_cast<uint8_t>(get_block_size(format)) };
+
+			std::vector<unsigned char> dfd{};
+			append_bytes(&dfd, &totalSize, sizeof(totalSize));
+			append_bytes(&dfd, &vendorAndType, sizeof(vendorAndType));
+			append_bytes(&dfd, &versionNumber, sizeof(versionNumber));
+			append_bytes(&dfd, &blockSize, sizeof(blockSize));
+			append_bytes(&dfd, colorInfo, sizeof(colorInfo));
+			append_bytes(&dfd, texelBlockDimensions, sizeof(texelBlockDimensions));
+			append_bytes(&dfd, bytesPlane, sizeof(bytesPlane));
+			for (const auto& sample : samples)
+			{
+				append_bytes(&dfd, &sample.bitOffset, sizeof(sample.bitOffset));
+				append_bytes(&dfd, &sample.bitLength, sizeof(sample.bitLength));
+				append_bytes(&dfd, &sample.channelType, sizeof(sample.channelType));
+				append_bytes(&dfd, sample.samplePosition, sizeof(sample.samplePosition));
+				append_bytes(&dfd, &sample.sampleLower, sizeof(sample.sampleLower));
+				append_bytes(&dfd, &sample.sampleUpper, sizeof(sample.sampleUpper));
+			}
+
+			return dfd;
+		}
+	}
+
+	uint64_t get_ktx2_image_size(VkFormat format, uint32_t width, uint32_t height)
+	{
+		if (is_block_compressed(format))
+		{
+			const uint64_t blocksX{ (width + 3) / 4 };
+			const uint64_t blocksY{ (height + 3) / 4 };
+			return blocksX * blocksY * get_block_size(format);
+		}
+
+		return static_cast<uint64_t>(width) * height * get_block_size(format);
+	}
+
+	bool read_ktx2_info(const std::string& fileName, Ktx2Info* info)
+	{
+		MappedFile file{};
+		if (!file.open(fileName))
+		{
+			return false;
+		}
+
+		return read_ktx2_info(file.span(), info);
+	}
+
+	bool read_ktx2_info(std::span<const unsigned char> file, Ktx2Info* info)
+	{
+		const uint64_t fileSize{ file.size() };
+
+		Ktx2Header header;
+		if (fileSize < sizeof(Ktx2Header))
+		{
+			return false;
+		}
+		memcpy(&header, file.data(), sizeof(Ktx2Header));
+
+		const VkFormat format{ static_cast<VkFormat>(header.vkFormat) };
+		if (memcmp(header.identifier, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) != 0
+			|| get_block_size(format) == 0
+			|| header.pixelWidth == 0 || header.pixelHeight == 0 || header.pixelDepth != 0
+			|| header.layerCount > 1 || header.faceCount != 1
+			|| header.levelCount == 0 || header.levelCount > 32		// 0 asks the loader to generate the mips
+			|| header.supercompressionScheme != 0)
+		{
+			return false;
+		}
+
+		std::vector<Ktx2LevelIndex> levelIndex(header.levelCount);
+		if (fileSize - sizeof(Ktx2Header) < sizeof(Ktx2LevelIndex) * levelIndex.size())
+		{
+			return false;
+		}
+		memcpy(levelIndex.data(), file.data() + sizeof(Ktx2Header), sizeof(Ktx2LevelIndex) * levelIndex.size());
+
+		info->format = format;
+		info->width = header.pixelWidth;
+		info->height = header.pixelHeight;
+		info->levels.resize(header.levelCount);
+
+		for (uint32_t i = 0; i < header.levelCount; ++i)
+		{
+			Ktx2Level& level{ info->levels[i] };
+			level.width = std::max(1u, header.pixelWidth >> i);
+			level.height = std::max(1u, header.pixelHeight >> i);
+			level.byteOffset = levelIndex[i].byteOffset;
+			level.byteLength = levelIndex[i].byteLength;
+
+			if (level.byteLength != get_ktx2_image_size(format, level.width, level.height)
+				|| level.byteOffset > fileSize || level.byteLength > fileSize - level.byteOffset)
+			{
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	void read_ktx2_levels(const std::string& fileName, const Ktx2Info& info,
+		const std::vector<uint64_t>& levelOffsets, void* dst)
+	{
+		MappedFile file{};
+		if (!file.open(fileName))
+		{
+			throw std::runtime_error("Failed to open texture file " + fileName + "!");
+		}
+
+		if (!read_ktx2_levels(file.span(), info, 0, levelOffsets, dst))
+		{
+			throw std::runtime_error("Failed to read texture file " + fileName + "!");
+		}
+	}
+
+	bool read_ktx2_levels(std::span<const unsigned char> file, const Ktx2Info& info, uint32_t firstLevel,
+		const std::vector<uint64_t>& levelOffsets, void* dst)
+	{
+		if (firstLevel + levelOffsets.size() > info.levels.size())
+		{
+			return false;
+		}
+
+		// Levels are copied from the mapping straight into the destination (the staging buffer)
+		for (size_t i = 0; i < levelOffsets.size(); ++i)
+		{
+			const Ktx2Level& level{ info.levels[firstLevel + i] };
+			if (level.byteOffset > file.size() || level.byteLength > file.size() - level.byteOffset)
+			{
+				return false;
+			}
+			memcpy(static_cast<char*>(dst) + levelOffsets[i], file.data() + level.byteOffset, level.byteLength);
+		}
+
+		return true;
+	}
+
+	void write_ktx2(const std::string& fileName, VkFormat format, uint32_t width, uint32_t height,
+		const std::vector<std::vector<unsigned char>>& levels)
+	{
+		const std::vector<unsigned char> dfd{ build_dfd(format) };
+
+		// Key/value data, just the writer (recommended by the specification)
+		const char writerKey[]{ "KTXwriter" };
+		const char writerValue[]{ "VulkanCourse TextureCooker" };
+		const uint32_t writerLength{ sizeof(writerKey) + sizeof(writerValue) };
+		std::vector<unsigned char> kvd{};
+		append_bytes(&kvd, &writerLength, sizeof(writerLength));
+		append_bytes(&kvd, writerKey, sizeof(writerKey));
+		append_bytes(&kvd, writerValue, sizeof(writerValue));
+		kvd.resize(align_to(kvd.size(), 4), 0);
+
+		Ktx2Header header{
+			.vkFormat = static_cast<uint32_t>(format),
+			.typeSize = 1,
+			.pixelWidth = width,
+			.pixelHeight = height,
+			.pixelDepth = 0,
+			.layerCount = 0,
+			.faceCount = 1,
+			.levelCount = static_cast<uint32_t>(levels.size()),
+			.supercompressionScheme = 0,
+		};
+		memcpy(header.identifier, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER));
+
+		header.dfdByteOffset = static_cast<uint32_t>(sizeof(Ktx2Header) + sizeof(Ktx2LevelIndex) * levels.size());
+		header.dfdByteLength = static_cast<uint32_t>(dfd.size());
+		header.kvdByteOffset = header.dfdByteOffset + header.dfdByteLength;
+		header.kvdByteLength = static_cast<uint32_t>(kvd.size());
+
+		// Mip data goes from the smallest level to the largest, each level aligned to lcm(block size, 4)
+		const uint64_t levelAlignment{ std::max<uint64_t>(get_block_size(format), 4) };
+		std::vector<Ktx2LevelIndex> levelIndex(levels.size());
+		uint64_t offset{ header.kvdByteOffset + header.kvdByteLength };
+		for (size_t i = levels.size(); i-- > 0;)
+		{
+			offset = align_to(offset, levelAlignment);
+			levelIndex[i] = {
+				.byteOffset = offset,
+				.byteLength = levels[i].size(),
+				.uncompressedByteLength = levels[i].size(),
+			};
+			offset += levels[i].size();
+		}
+
+		std::vector<unsigned char> fileBuffer(offset, 0);
+		memcpy(fileBuffer.data(), &header, sizeof(Ktx2Header));
+		memcpy(fileBuffer.data() + sizeof(Ktx2Header), levelIndex.data(), sizeof(Ktx2LevelIndex) * levelIndex.size());
+		memcpy(fileBuffer.data() + header.dfdByteOffset, dfd.data(), dfd.size());
+		memcpy(fileBuffer.data() + header.kvdByteOffset, kvd.data(), kvd.size());
+		for (size_t i = 0; i < levels.size(); ++i)
+		{
+			memcpy(fileBuffer.data() + levelIndex[i].byteOffset, levels[i].data(), levels[i].size());
+		}
+
+		std::ofstream file(fileName, std::ios::binary | std::ios::trunc);
+		if (!file.is_open())
+		{
+			throw std::runtime_error("Failed to create texture file " + fileName + "!");
+		}
+
+		file.write(reinterpret_cast<const char*>(fileBuffer.data()), fileBuffer.size());
+		if (!file)
+		{
+			throw std::runtime_error("Failed to write texture file " + fileName + "!");
+		}
+	}
+
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <string>
+#include <span>
+#include <vector>
+#include <cstdint>
+
+namespace VkCourse {
+
+	// Minimal KTX2 (https://registry.khronos.org/KTX/specs/2.0/ktxspec.v2.html) support, shared by the
+	// renderer and the texture cooker. Only what the cooker writes is accepted: 2D, one layer, one face,
+	// no supercompression.
+
+	struct Ktx2Level {
+		uint64_t byteOffset;	// From the start of the file
+		uint64_t byteLength;
+		uint32_t width;
+		uint32_t height;
+	};
+
+	struct Ktx2Info {
+		VkFormat format;
+		uint32_t width;
+		uint32_t height;
+		std::vector<Ktx2Level> levels;	// Level 0 (full size) first
+	};
+
+	// Size in bytes of a width x height image, for the formats the cooker can write
+	uint64_t get_ktx2_image_size(VkFormat format, uint32_t width, uint32_t height);
+
+	// Returns false if the file is missing or is not a KTX2 file we can load
+	bool read_ktx2_info(const std::string& fileName, Ktx2Info* info);
+	bool read_ktx2_info(std::span<const unsigned char> file, Ktx2Info* info);
+
+	// Copies every level into dst, level i at dst + levelOffsets[i]
+	void read_ktx2_levels(const std::string& fileName, const Ktx2Info& info,
+		const std::vector<uint64_t>& levelOffsets, void* dst);
+
+	// Same from a file already in memory, for levels firstLevel to firstLevel + levelOffsets.size() - 1 only
+	// (level firstLevel + i goes at dst + levelOffsets[i]). Returns false if a level is out of bounds
+	bool read_ktx2_levels(std::span<const unsigned char> file, const Ktx2Info& info, uint32_t firstLevel,
+		const std::vector<uint64_t>& levelOffsets, void* dst);
+
+	// levels[i] holds the data of mip level i (level 0 being width x height)
+	void write_ktx2(const std::string& fileName, VkFormat format, uint32_t width, uint32_t height,
+		const std::vector<std::vector<unsigned char>>& levels);
+
+}
@@ -0,0 +1,186 @@
+#include "MappedFile.h"
+
+#include <utility>
+#include <stdexcept>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace VkCourse {
+
+	MappedFile::MappedFile()
+	{
+	}
+
+	MappedFile::MappedFile(const std::string& fileName, MappedFileAccess access)
+	{
+		if (!open(fileName, access))
+		{
+			throw std::runtime_error("Failed to map file " + fileName + "!");
+		}
+	}
+
+	MappedFile::MappedFile(MappedFile&& other) noexcept
+	{
+		*this = std::move(other);
+	}
+
+	MappedFile::~MappedFile()
+	{
+		close();
+	}
+
+	MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+	{
+		if (this != &other)
+		{
+			close();
+			std::swap(m_data, other.m_data);
+			std::swap(m_size, other.m_size);
+			std::swap(m_open, other.m_open);
+#ifdef _WIN32
+			std::swap(m_fileHandle, other.m_fileHandle);
+			std::swap(m_mappingHandle, other.m_mappingHandle);
+#endif
+		}
+		return *this;
+	}
+
+	bool MappedFile::open(const std::string& fileName, MappedFileAccess access)
+	{
+		close();
+
+#ifdef _WIN32
+		HANDLE file{ CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, 
+			FILE_ATTRIBUTE_NORMAL | (access == MappedFileAccess::Sequential ? FILE_FLAG_SEQUENTIAL_SCAN : 0), nullptr) };
+		if (file == INVALID_HANDLE_VALUE)
+		{
+			return false;
+		}
+
+		LARGE_INTEGER fileSize;
+		if (!GetFileSizeEx(file, &fileSize))
+		{
+			CloseHandle(file);
+			return false;
+		}
+
+		m_fileHandle = file;
+		m_size = static_cast<size_t>(fileSize.QuadPart);
+		m_open = true;
+
+		// Empty files can't be mapped
+		if (m_size == 0)
+		{
+			return true;
+		}
+
+		m_mappingHandle = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (m_mappingHandle == nullptr)
+		{
+			close();
+			return false;
+		}
+
+		m_data = static_cast<const unsigned char*>(MapViewOfFile(m_mappingHandle, FILE_MAP_READ, 0, 0, 0));
+		if (m_data == nullptr)
+		{
+			close();
+			return false;
+		}
+#else
+		const int file{ ::open(fileName.c_str(), O_RDONLY) };
+		if (file < 0)
+		{
+			return false;
+		}
+
+		struct stat fileStat;
+		if (fstat(file, &fileStat) != 0)
+		{
+			::close(file);
+			return false;
+		}
+
+		m_size = static_cast<size_t>(fileStat.st_size);
+		m_open = true;
+
+		if (m_size > 0)
+		{
+			void* mapping{ mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, file, 0) };
+			if (mapping == MAP_FAILED)
+			{
+				::close(file);
+				close();
+				return false;
+			}
+
+			madvise(mapping, m_size, access == MappedFileAccess::Sequential ? MADV_SEQUENTIAL : MADV_NORMAL);
+			m_data = static_cast<const unsigned char*>(mapping);
+		}
+
+		// The mapping stays valid without the descriptor
+		::close(file);
+#endif
+
+		return true;
+	}
+
+	void MappedFile::close()
+	{
+#ifdef _WIN32
+		if (m_data != nullptr)
+		{
+			UnmapViewOfFile(m_data);
+		}
+		if (m_mappingHandle != nullptr)
+		{
+			CloseHandle(m_mappingHandle);
+		}
+		if (m_fileHandle != nullptr)
+		{
+			CloseHandle(m_fileHandle);
+		}
+		m_mappingHandle = nullptr;
+		m_fileHandle = nullptr;
+#else
+		if (m_data != nullptr)
+		{
+			munmap(const_cast<unsigned char*>(m_data), m_size);
+		}
+#endif
+
+		m_data = nullptr;
+		m_size = 0;
+		m_open = false;
+	}
+
+	bool MappedFile::is_open() const
+	{
+		return m_open;
+	}
+
+	const unsigned char* MappedFile::data() const
+	{
+		return m_data;
+	}
+
+	size_t MappedFile::size() const
+	{
+		return m_size;
+	}
+
+	std::span<const unsigned char> MappedFile::span() const
+	{
+		return { m_data, m_size };
+	}
+
+}
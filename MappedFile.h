@@ -0,0 +1,50 @@
+#pragma once
+
+#include <string>
+#include <span>
+#include <cstddef>
+
+namespace VkCourse {
+
+	// Read-ahead hint for the mapping
+	enum class MappedFileAccess {
+		Normal,			// Read at arbitrary offsets (asset pack, mesh cache), the system default read-ahead
+		Sequential,		// Read once from start to end, read ahead aggressively
+	};
+
+	// Read only memory mapping of a whole file, the contents are read straight from the page cache.
+	// Spans returned by span()/data() are valid until the file is closed, moved from or destroyed.
+	class MappedFile
+	{
+	public:
+		MappedFile();
+		explicit MappedFile(const std::string& fileName, MappedFileAccess access = MappedFileAccess::Normal);		// Throws if the file can't be mapped
+		MappedFile(const MappedFile&) = delete;
+		MappedFile(MappedFile&& other) noexcept;
+
+		~MappedFile();
+
+		MappedFile& operator=(const MappedFile&) = delete;
+		MappedFile& operator=(MappedFile&& other) noexcept;
+
+		// Returns false if the file can't be opened or mapped
+		bool open(const std::string& fileName, MappedFileAccess access = MappedFileAccess::Normal);
+		void close();
+
+		bool is_open() const;
+		const unsigned char* data() const;		// nullptr for empty files
+		size_t size() const;
+		std::span<const unsigned char> span() const;
+
+	private:
+		const unsigned char* m_data{ nullptr };
+		size_t m_size{};
+		bool m_open{ false };
+
+#ifdef _WIN32
+		void* m_fileHandle{ nullptr };
+		void* m_mappingHandle{ nullptr };
+#endif
+	};
+
+}
@@ -0,0 +1,167 @@
+#include "MappedIOSystem.h"
+
+#include <filesystem>
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+namespace VkCourse {
+
+	MappedIOStream::MappedIOStream(AssetFile&& file)
+		: m_file(std::move(file))
+	{
+	}
+
+	MappedIOStream::~MappedIOStream()
+	{
+	}
+
+	size_t MappedIOStream::Read(void* buffer, size_t size, size_t count)
+	{
+		if (size == 0 || count == 0)
+		{
+			return 0;
+		}
+
+		// Only whole elements, like fread
+		const size_t elementCount{ std::min(count, (m_file.size() - m_position) / size) };
+		if (elementCount > 0)
+		{
+			memcpy(buffer, m_file.data() + m_position, elementCount * size);
+			m_position += elementCount * size;
+		}
+		return elementCount;
+	}
+
+	size_t MappedIOStream::Write(const void*, size_t, size_t)
+	{
+		return 0;
+	}
+
+	aiReturn MappedIOStream::Seek(size_t offset, aiOrigin origin)
+	{
+		size_t position;
+		switch (origin)
+		{
+		case aiOrigin_SET:
+			position = offset;
+			break;
+		case aiOrigin_CUR:
+			position = m_position + offset;
+			break;
+		case aiOrigin_END:
+			position = m_file.size() + offset;		// Offset is negative (as unsigned) from the end, wraps around
+			break;
+		default:
+			return aiReturn_FAILURE;
+		}
+
+		if (position > m_file.size())
+		{
+			return aiReturn_FAILURE;
+		}
+
+		m_position = position;
+		return aiReturn_SUCCESS;
+	}
+
+	size_t MappedIOStream::Tell() const
+	{
+		return m_position;
+	}
+
+	size_t MappedIOStream::FileSize() const
+	{
+		return m_file.size();
+	}
+
+	void MappedIOStream::Flush()
+	{
+	}
+
+	MappedIOSystem::MappedIOSystem(const AssetPack* assetPack)
+		: m_assetPack(assetPack)
+	{
+	}
+
+	MappedIOSystem::~MappedIOSystem()
+	{
+	}
+
+	bool MappedIOSystem::Exists(const char* fileName) const
+	{
+		if (m_assetPack != nullptr && m_assetPack->find(fileName) != nullptr)
+		{
+			return true;
+		}
+
+		std::error_code error;
+		return std::filesystem::is_regular_file(fileName, error);
+	}
+
+	char MappedIOSystem::getOsSeparator() const
+	{
+#ifdef _WIN32
+		return '\\';
+#else
+		return '/';
+#endif
+	}
+
+	Assimp::IOStream* MappedIOSystem::Open(const char* fileName, const char* mode)
+	{
+		// Importers never write
+		if (std::strchr(mode, 'w') != nullptr || std::strchr(mode, 'a') != nullptr || std::strchr(mode, '+') != nullptr)
+		{
+			return nullptr;
+		}
+
+		AssetFile file{};
+		if (m_assetPack != nullptr)
+		{
+			if (!m_assetPack->open_asset(fileName, &file))
+			{
+				return nullptr;
+			}
+		}
+		else
+		{
+			// Importers mostly parse the file from start to end
+			MappedFile looseFile{};
+			if (!looseFile.open(fileName, MappedFileAccess::Sequential))
+			{
+				return nullptr;
+			}
+			file = AssetFile(std::move(looseFile));
+		}
+
+		++m_openedFileCount;
+		m_openedBytes += file.size();
+		if (std::find(m_openedFileNames.begin(), m_openedFileNames.end(), fileName) == m_openedFileNames.end())
+		{
+			m_openedFileNames.push_back(fileName);
+		}
+		return new MappedIOStream(std::move(file));
+	}
+
+	void MappedIOSystem::Close(Assimp::IOStream* file)
+	{
+		delete file;
+	}
+
+	size_t MappedIOSystem::get_opened_file_count() const
+	{
+		return m_openedFileCount;
+	}
+
+	uint64_t MappedIOSystem::get_opened_bytes() const
+	{
+		return m_openedBytes;
+	}
+
+	const std::vector<std::string>& MappedIOSystem::get_opened_file_names() const
+	{
+		return m_openedFileNames;
+	}
+
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include "AssetPack.h"
+
+#include <string>
+#include <vector>
+
+#pragma warning( push )
+#pragma warning( disable : 26451 )
+#include <assimp/IOStream.hpp>
+#include <assimp/IOSystem.hpp>
+#pragma warning( pop )
+
+namespace VkCourse {
+
+	// Assimp file access through AssetPack/MappedFile, so importers read the model (and its .mtl, textures...)
+	// from the asset pack or the page cache instead of going through stdio buffers. Read only.
+	class MappedIOStream : public Assimp::IOStream
+	{
+	public:
+		MappedIOStream(AssetFile&& file);
+
+		~MappedIOStream() override;
+
+		size_t Read(void* buffer, size_t size, size_t count) override;
+		size_t Write(const void* buffer, size_t size, size_t count) override;
+		aiReturn Seek(size_t offset, aiOrigin origin) override;
+		size_t Tell() const override;
+		size_t FileSize() const override;
+		void Flush() override;
+
+	private:
+		AssetFile m_file;
+		size_t m_position{};
+	};
+
+	// Pass to Assimp::Importer::SetIOHandler, which takes ownership
+	class MappedIOSystem : public Assimp::IOSystem
+	{
+	public:
+		MappedIOSystem(const AssetPack* assetPack = nullptr);		// Files in the pack take precedence
+
+		~MappedIOSystem() override;
+
+		bool Exists(const char* fileName) const override;
+		char getOsSeparator() const override;
+		Assimp::IOStream* Open(const char* fileName, const char* mode = "rb") override;
+		void Close(Assimp::IOStream* file) override;
+
+		// Files (model, materials...) opened so far and their total size, for the import profile
+		size_t get_opened_file_count() const;
+		uint64_t get_opened_bytes() const;
+
+		// Each file opened so far once, in the order they were first opened (the mesh cache keys on them)
+		const std::vector<std::string>& get_opened_file_names() const;
+
+	private:
+		const AssetPack* m_assetPack;
+		size_t m_openedFileCount{};
+		uint64_t m_openedBytes{};
+		std::vector<std::string> m_openedFileNames{};
+	};
+
+}
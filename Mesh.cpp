@@ -6,15 +6,20 @@ VkCourse::Mesh::Mesh()
 
 VkCourse::Mesh::Mesh(VkPhysicalDevice physicalDevice, VkDevice device,
 	VkQueue transferQueue, VkCommandPool transferCommandPool,
-	std::vector<Vertex>* vertices, std::vector<uint32_t>* indices,
-	size_t texId)
+	const EncodedMesh& encodedMesh, size_t texId)
 {
-	m_vertexCount = static_cast<uint32_t>(vertices->size());
-	m_indexCount = static_cast<uint32_t>(indices->size());
+	m_vertexCount = encodedMesh.vertexCount;
+	m_indexCount = encodedMesh.indexCount;
+	m_indexType = encodedMesh.indexType;
+	m_attributeOffset = encodedMesh.attributeOffset;
+	m_dequantization = encodedMesh.dequantization;
+	m_boundingSphere = encodedMesh.boundingSphere;
 	m_device.physicalDevice = physicalDevice;
 	m_device.logicalDevice = device;
-	create_vertex_buffer(transferQueue, transferCommandPool, vertices);
-	create_index_buffer(transferQueue, transferCommandPool, indices);
+
+	// Already in the layout the pipeline reads, only copied into the staging buffers
+	create_vertex_buffer(transferQueue, transferCommandPool, encodedMesh.vertexData);
+	create_index_buffer(transferQueue, transferCommandPool, encodedMesh.indexData);
 	m_model = { .model = glm::mat4(1.f) };
 	m_textureId = texId;
 }
@@ -47,11 +52,21 @@ VkBuffer VkCourse::Mesh::get_vertex_buffer()
 	return m_vertexBuffer;
 }
 
+VkDeviceSize VkCourse::Mesh::get_attribute_offset()
+{
+	return m_attributeOffset;
+}
+
 VkBuffer VkCourse::Mesh::get_index_buffer()
 {
 	return m_indexBuffer;
 }
 
+VkIndexType VkCourse::Mesh::get_index_type()
+{
+	return m_indexType;
+}
+
 void VkCourse::Mesh::set_model(glm::mat4 modelMatrix)
 {
 	m_model.model = modelMatrix;
@@ -62,15 +77,26 @@ VkCourse::Model& VkCourse::Mesh::get_model_matrix()
 	return m_model;
 }
 
+const glm::mat4& VkCourse::Mesh::get_dequantization_matrix()
+{
+	return m_dequantization;
+}
+
+const glm::vec4& VkCourse::Mesh::get_bounding_sphere()
+{
+	return m_boundingSphere;
+}
+
 size_t VkCourse::Mesh::get_texture_id()
 {
 	return m_textureId;
 }
 
 void VkCourse::Mesh::create_vertex_buffer(VkQueue transferQueue, VkCommandPool transferCommandPool,
-	std::vector<Vertex>* vertices)
+	std::span<const unsigned char> vertexData)
 {
-	VkDeviceSize bufferSize{ sizeof(Vertex) * vertices->size() };
+	// One buffer holds both streams
+	VkDeviceSize bufferSize{ vertexData.size() };
 
 	// Create staging buffer (temporary buffer to store vertex data before transferring to GPU)
 	VkBuffer stagingBuffer;
@@ -83,7 +109,7 @@ void VkCourse::Mesh::create_vertex_buffer(VkQueue transferQueue, VkCommandPool t
 	// Map memory to staging buffer
 	void* data;																			// Pointer to a point in normal memory
 	vkMapMemory(m_device.logicalDevice, stagingBufferMemory, 0, bufferSize, 0, &data);	// Map vertex buffer memory to data
-	memcpy(data, vertices->data(), static_cast<size_t>(bufferSize));					// Copy memory from vertices to data
+	memcpy(data, vertexData.data(), static_cast<size_t>(bufferSize));					// Copy memory from vertices to data
 	vkUnmapMemory(m_device.logicalDevice, stagingBufferMemory);
 
 	// Create GPU local vertex buffer with TRANSFER_DST_BIT to mark as recipient of transfer data
@@ -99,11 +125,10 @@ void VkCourse::Mesh::create_vertex_buffer(VkQueue transferQueue, VkCommandPool t
 }
 
 void VkCourse::Mesh::create_index_buffer(VkQueue transferQueue, VkCommandPool transferCommandPool,
-	std::vector<uint32_t>* indices)
+	std::span<const unsigned char> indexData)
 {
 	// Very similar to create_vertex_buffer() above
-
-	VkDeviceSize bufferSize{ sizeof(uint32_t) * indices->size() };
+	VkDeviceSize bufferSize{ indexData.size() };
 
 	VkBuffer stagingBuffer;
 	VkDeviceMemory stagingBufferMemory;
@@ -113,7 +138,7 @@ void VkCourse::Mesh::create_index_buffer(VkQueue transferQueue, VkCommandPool tr
 
 	void* data;
 	vkMapMemory(m_device.logicalDevice, stagingBufferMemory, 0, bufferSize, 0, &data);
-	memcpy(data, indices->data(), static_cast<size_t>(bufferSize));
+	memcpy(data, indexData.data(), static_cast<size_t>(bufferSize));
 	vkUnmapMemory(m_device.logicalDevice, stagingBufferMemory);
 
 	// Now the destination is for an index buffer
@@ -1,10 +1,12 @@
 #pragma once
 
 #include "Utilities.h"
+#include "VertexFormat.h"
 
 #include <vulkan/vulkan.h>
 
 #include <vector>
+#include <span>
 
 namespace VkCourse {
 
@@ -12,14 +14,27 @@ namespace VkCourse {
 		glm::mat4 model;
 	};
 
+	// A mesh as the GPU reads it: vertex streams in a VertexFormat and 16 or 32-bit indices. The bytes are not owned,
+	// they are in a mesh cache mapping or in the storage of a freshly encoded model (see EncodedModelData)
+	struct EncodedMesh {
+		std::span<const unsigned char> vertexData;		// Position stream, then the attribute stream
+		VkDeviceSize attributeOffset;
+		uint32_t vertexCount;
+		glm::mat4 dequantization;						// Maps the stored positions back to the mesh space
+		glm::vec4 boundingSphere;						// Center (xyz) and radius (w) in the mesh space
+		std::span<const unsigned char> indexData;
+		VkIndexType indexType;
+		uint32_t indexCount;
+		uint32_t materialIndex;
+	};
+
 	class Mesh
 	{
 	public:
 		Mesh();
 		Mesh(VkPhysicalDevice physicalDevice, VkDevice device, 
 			VkQueue transferQueue, VkCommandPool transferCommandPool, 
-			std::vector<Vertex>* vertices, std::vector<uint32_t>* indices,
-			size_t texId);
+			const EncodedMesh& encodedMesh, size_t texId);
 		
 		~Mesh();
 		
@@ -29,10 +44,18 @@ namespace VkCourse {
 		uint32_t get_index_count();
 
 		VkBuffer get_vertex_buffer();
+		VkDeviceSize get_attribute_offset();		// Of the attribute stream in the vertex buffer, positions start at 0
 		VkBuffer get_index_buffer();
+		VkIndexType get_index_type();
 
 		Model& get_model_matrix();
 
+		// Maps the positions stored in the vertex buffer to the mesh space
+		const glm::mat4& get_dequantization_matrix();
+
+		// Center (xyz) and radius (w) in the mesh space
+		const glm::vec4& get_bounding_sphere();
+
 		size_t get_texture_id();
 
 		void set_model(glm::mat4 modelMatrix);
@@ -43,10 +66,14 @@ namespace VkCourse {
 		size_t m_textureId;
 
 		uint32_t m_vertexCount{};
+		glm::mat4 m_dequantization{ 1.f };
+		glm::vec4 m_boundingSphere{ 0.f };
+		VkDeviceSize m_attributeOffset{};
 		VkBuffer m_vertexBuffer;
 		VkDeviceMemory m_vertexBufferMemory;
 
 		uint32_t m_indexCount{};
+		VkIndexType m_indexType{ VK_INDEX_TYPE_UINT32 };		// UINT16 whenever every vertex can be addressed with it
 		VkBuffer m_indexBuffer;
 		VkDeviceMemory m_indexBufferMemory;
 
@@ -56,9 +83,9 @@ namespace VkCourse {
 		} m_device;
 
 		void create_vertex_buffer(VkQueue transferQueue, VkCommandPool transferCommandPool,
-			std::vector<Vertex>* vertices);
+			std::span<const unsigned char> vertexData);
 		void create_index_buffer(VkQueue transferQueue, VkCommandPool transferCommandPool,
-			std::vector<uint32_t>* indices);
+			std::span<const unsigned char> indexData);
 	};
 }
 
@@ -0,0 +1,317 @@
+#include "MeshCache.h"
+#include "MappedFile.h"
+
+#include <filesystem>
+#include <fstream>
+#include <cstring>
+#include <cstdio>
+#include <string_view>
+
+namespace VkCourse {
+
+	namespace {
+		constexpr char MESH_CACHE_MAGIC[8]{ 'V', 'K', 'C', 'M', 'E', 'S', 'H', '\0' };
+
+		uint64_t align_offset(uint64_t offset)
+		{
+			return (offset + MeshCache::MESH_CACHE_ALIGNMENT - 1) & ~(MeshCache::MESH_CACHE_ALIGNMENT - 1);
+		}
+	}
+
+	MeshCache::MeshCache()
+	{
+	}
+
+	MeshCache::MeshCache(const std::string& cacheDirectory)
+		: m_cacheDirectory(cacheDirectory)
+	{
+	}
+
+	MeshCache::~MeshCache()
+	{
+	}
+
+	bool MeshCache::load(const AssetPack& assetPack, const std::string& modelFileName, uint32_t importFlags, VertexFormat vertexFormat,
+		EncodedModelData* modelData) const
+	{
+		MeshCacheStamp sourceStamp;
+		if (!get_stamp(assetPack, modelFileName, &sourceStamp))
+		{
+			return false;
+		}
+
+		MappedFile file{};
+		if (!file.open(get_cache_file_name(modelFileName)))
+		{
+			return false;
+		}
+
+		const uint64_t fileSize{ file.size() };
+		if (fileSize < sizeof(MeshCacheHeader))
+		{
+			return false;
+		}
+
+		// The tables are read in place in the mapping (page aligned, so the section alignment holds), the encoded
+		// meshes stay there until they are copied into the staging buffers
+		const char* fileData{ reinterpret_cast<const char*>(file.data()) };
+
+		MeshCacheHeader header;
+		memcpy(&header, fileData, sizeof(MeshCacheHeader));
+
+		// Key: format version, source file stamp, import flags, vertex format and path (different paths can share a
+		// cache file name), then the stamps of the dependencies below
+		if (memcmp(header.magic, MESH_CACHE_MAGIC, sizeof(MESH_CACHE_MAGIC)) != 0
+			|| header.version != MESH_CACHE_VERSION
+			|| header.importFlags != importFlags
+			|| header.source != sourceStamp
+			|| header.vertexFormat != static_cast<uint32_t>(vertexFormat)
+			|| header.fileSize != fileSize)
+		{
+			return false;
+		}
+
+		// Reject truncated or corrupted tables before reading through them
+		auto fits{ [fileSize](uint64_t offset, uint64_t size) { return offset <= fileSize && size <= fileSize - offset; } };
+		if (!fits(header.meshRangesOffset, sizeof(MeshCacheRange) * static_cast<uint64_t>(header.meshCount))
+			|| !fits(header.materialNamesOffset, sizeof(MeshCacheString) * static_cast<uint64_t>(header.materialCount))
+			|| !fits(header.dependenciesOffset, sizeof(MeshCacheDependency) * static_cast<uint64_t>(header.dependencyCount))
+			|| !fits(header.stringsOffset, header.sourcePathLength)
+			|| header.dataOffset > fileSize)
+		{
+			return false;
+		}
+
+		const char* strings{ fileData + header.stringsOffset };
+		if (std::string_view(strings, header.sourcePathLength) != modelFileName)
+		{
+			return false;
+		}
+
+		const auto* meshRanges{ reinterpret_cast<const MeshCacheRange*>(fileData + header.meshRangesOffset) };
+		const auto* materialNames{ reinterpret_cast<const MeshCacheString*>(fileData + header.materialNamesOffset) };
+		const auto* dependencies{ reinterpret_cast<const MeshCacheDependency*>(fileData + header.dependenciesOffset) };
+
+		// Material libraries are read by the import, editing one changes the texture names
+		for (size_t i = 0; i < header.dependencyCount; ++i)
+		{
+			const MeshCacheString& path{ dependencies[i].path };
+			if (!fits(header.stringsOffset + path.offset, path.length))
+			{
+				return false;
+			}
+
+			MeshCacheStamp dependencyStamp;
+			if (!get_stamp(assetPack, std::string(strings + path.offset, path.length), &dependencyStamp)
+				|| dependencyStamp != dependencies[i].stamp)
+			{
+				return false;
+			}
+		}
+
+		modelData->textureNames.resize(header.materialCount);
+		for (size_t i = 0; i < header.materialCount; ++i)
+		{
+			if (!fits(header.stringsOffset + materialNames[i].offset, materialNames[i].length))
+			{
+				return false;
+			}
+			modelData->textureNames[i].assign(strings + materialNames[i].offset, materialNames[i].length);
+		}
+
+		const unsigned char* data{ file.data() + header.dataOffset };
+		const uint64_t dataSize{ fileSize - header.dataOffset };
+		auto fitsData{ [dataSize](uint64_t offset, uint64_t size) { return offset <= dataSize && size <= dataSize - offset; } };
+
+		modelData->meshes.resize(header.meshCount);
+		for (size_t i = 0; i < header.meshCount; ++i)
+		{
+			const MeshCacheRange& range{ meshRanges[i] };
+			const uint64_t indexSize{ range.indexType == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t) : sizeof(uint32_t) };
+			const uint64_t indexDataSize{ indexSize * range.indexCount };
+
+			if ((range.indexType != VK_INDEX_TYPE_UINT16 && range.indexType != VK_INDEX_TYPE_UINT32)
+				|| !fitsData(range.vertexDataOffset, range.vertexDataSize)
+				|| range.attributeOffset > range.vertexDataSize
+				|| !fitsData(range.indexDataOffset, indexDataSize)
+				|| range.materialIndex >= header.materialCount)
+			{
+				return false;
+			}
+
+			modelData->meshes[i] = {
+				.vertexData = std::span<const unsigned char>(data + range.vertexDataOffset, range.vertexDataSize),
+				.attributeOffset = range.attributeOffset,
+				.vertexCount = range.vertexCount,
+				.dequantization = range.dequantization,
+				.boundingSphere = range.boundingSphere,
+				.indexData = std::span<const unsigned char>(data + range.indexDataOffset, indexDataSize),
+				.indexType = static_cast<VkIndexType>(range.indexType),
+				.indexCount = range.indexCount,
+				.materialIndex = range.materialIndex,
+			};
+		}
+
+		// Moving the mapping keeps its address, so the spans stay valid
+		modelData->cacheFile = std::move(file);
+		return true;
+	}
+
+	bool MeshCache::store(const AssetPack& assetPack, const std::string& modelFileName, uint32_t importFlags, VertexFormat vertexFormat,
+		const std::vector<std::string>& dependencyFileNames, const EncodedModelData& modelData) const
+	{
+		MeshCacheHeader header{};
+		memcpy(header.magic, MESH_CACHE_MAGIC, sizeof(MESH_CACHE_MAGIC));
+		header.version = MESH_CACHE_VERSION;
+		header.importFlags = importFlags;
+		header.vertexFormat = static_cast<uint32_t>(vertexFormat);
+		header.meshCount = static_cast<uint32_t>(modelData.meshes.size());
+		header.materialCount = static_cast<uint32_t>(modelData.textureNames.size());
+		header.sourcePathLength = static_cast<uint32_t>(modelFileName.size());
+		header.dependencyCount = static_cast<uint32_t>(dependencyFileNames.size());
+
+		if (!get_stamp(assetPack, modelFileName, &header.source))
+		{
+			return false;
+		}
+
+		// Build the tables, the encoded data of each mesh is aligned like the sections
+		std::vector<MeshCacheRange> meshRanges(modelData.meshes.size());
+		uint64_t dataSize{};
+		for (size_t i = 0; i < modelData.meshes.size(); ++i)
+		{
+			const EncodedMesh& mesh{ modelData.meshes[i] };
+			meshRanges[i] = {
+				.dequantization = mesh.dequantization,
+				.boundingSphere = mesh.boundingSphere,
+				.vertexDataOffset = dataSize,
+				.vertexDataSize = mesh.vertexData.size(),
+				.attributeOffset = mesh.attributeOffset,
+				.indexDataOffset = align_offset(dataSize + mesh.vertexData.size()),
+				.vertexCount = mesh.vertexCount,
+				.indexCount = mesh.indexCount,
+				.indexType = static_cast<uint32_t>(mesh.indexType),
+				.materialIndex = mesh.materialIndex,
+			};
+			dataSize = align_offset(meshRanges[i].indexDataOffset + mesh.indexData.size());
+		}
+
+		std::string strings{ modelFileName };
+		std::vector<MeshCacheString> materialNames(modelData.textureNames.size());
+		for (size_t i = 0; i < modelData.textureNames.size(); ++i)
+		{
+			materialNames[i] = {
+				.offset = static_cast<uint32_t>(strings.size()),
+				.length = static_cast<uint32_t>(modelData.textureNames[i].size()),
+			};
+			strings += modelData.textureNames[i];
+		}
+
+		// Without a stamp for every dependency the entry could not be validated, so it is not written
+		std::vector<MeshCacheDependency> dependencies(dependencyFileNames.size());
+		for (size_t i = 0; i < dependencyFileNames.size(); ++i)
+		{
+			if (!get_stamp(assetPack, dependencyFileNames[i], &dependencies[i].stamp))
+			{
+				return false;
+			}
+			dependencies[i].path = {
+				.offset = static_cast<uint32_t>(strings.size()),
+				.length = static_cast<uint32_t>(dependencyFileNames[i].size()),
+			};
+			strings += dependencyFileNames[i];
+		}
+
+		// Lay out the sections
+		header.meshRangesOffset = align_offset(sizeof(MeshCacheHeader));
+		header.materialNamesOffset = align_offset(header.meshRangesOffset + sizeof(MeshCacheRange) * meshRanges.size());
+		header.dependenciesOffset = align_offset(header.materialNamesOffset + sizeof(MeshCacheString) * materialNames.size());
+		header.stringsOffset = align_offset(header.dependenciesOffset + sizeof(MeshCacheDependency) * dependencies.size());
+		header.dataOffset = align_offset(header.stringsOffset + strings.size());
+		header.fileSize = header.dataOffset + dataSize;
+
+		std::vector<char> fileBuffer(header.fileSize, 0);
+		memcpy(fileBuffer.data(), &header, sizeof(MeshCacheHeader));
+		memcpy(fileBuffer.data() + header.meshRangesOffset, meshRanges.data(), sizeof(MeshCacheRange) * meshRanges.size());
+		memcpy(fileBuffer.data() + header.materialNamesOffset, materialNames.data(), sizeof(MeshCacheString) * materialNames.size());
+		memcpy(fileBuffer.data() + header.dependenciesOffset, dependencies.data(), sizeof(MeshCacheDependency) * dependencies.size());
+		memcpy(fileBuffer.data() + header.stringsOffset, strings.data(), strings.size());
+
+		char* data{ fileBuffer.data() + header.dataOffset };
+		for (size_t i = 0; i < modelData.meshes.size(); ++i)
+		{
+			const EncodedMesh& mesh{ modelData.meshes[i] };
+			memcpy(data + meshRanges[i].vertexDataOffset, mesh.vertexData.data(), mesh.vertexData.size());
+			memcpy(data + meshRanges[i].indexDataOffset, mesh.indexData.data(), mesh.indexData.size());
+		}
+
+		// Write to a temporary file and swap it in, so a reader never sees a partially written cache
+		std::error_code error;
+		std::filesystem::create_directories(m_cacheDirectory, error);
+
+		const std::string cacheFileName{ get_cache_file_name(modelFileName) };
+		const std::string temporaryFileName{ cacheFileName + ".tmp" };
+		{
+			std::ofstream file(temporaryFileName, std::ios::binary | std::ios::trunc);
+			if (!file.is_open())
+			{
+				return false;
+			}
+
+			file.write(fileBuffer.data(), fileBuffer.size());
+			if (!file)
+			{
+				return false;
+			}
+		}
+
+		std::filesystem::rename(temporaryFileName, cacheFileName, error);
+		if (error)
+		{
+			std::filesystem::remove(temporaryFileName, error);
+			return false;
+		}
+
+		return true;
+	}
+
+	std::string MeshCache::get_cache_file_name(const std::string& modelFileName) const
+	{
+		const uint64_t pathHash{ hash_bytes(modelFileName.data(), modelFileName.size()) };
+
+		char hashText[17];
+		snprintf(hashText, sizeof(hashText), "%016llx", static_cast<unsigned long long>(pathHash));
+
+		return m_cacheDirectory + "/" + std::filesystem::path(modelFileName).stem().string() + "-" + hashText + ".meshcache";
+	}
+
+	bool MeshCache::get_stamp(const AssetPack& assetPack, const std::string& fileName, MeshCacheStamp* stamp)
+	{
+		// The importer reads packed files from the pack, whatever loose file has the same name
+		const AssetPack::AssetPackEntry* entry{ assetPack.find(fileName) };
+		if (entry != nullptr)
+		{
+			*stamp = {
+				.size = entry->dataSize,
+				.modifiedTime = 0,
+				.contentHash = entry->contentHash,
+			};
+			return true;
+		}
+
+		std::error_code error;
+		*stamp = {
+			.size = std::filesystem::file_size(fileName, error),
+			.modifiedTime = 0,
+			.contentHash = 0,
+		};
+		if (error)
+		{
+			return false;
+		}
+
+		stamp->modifiedTime = static_cast<int64_t>(std::filesystem::last_write_time(fileName, error).time_since_epoch().count());
+		return !error;
+	}
+
+}
@@ -0,0 +1,105 @@
+#pragma once
+#include "MeshModel.h"
+#include "AssetPack.h"
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace VkCourse {
+
+	// Increase whenever the layout of the cache file, the vertex formats or the import processing changes
+	constexpr uint32_t MESH_CACHE_VERSION{ 7 };
+
+	// Binary cache of imported models, encoded for the GPU (vertex streams in the VertexFormat, 16 or 32-bit indices),
+	// so that warm starts neither go through Assimp nor encode the meshes again: the streams are copied from the mapping
+	// straight into the staging buffers.
+	// File layout (every section aligned to MESH_CACHE_ALIGNMENT, so it can be read in place):
+	// - MeshCacheHeader
+	// - MeshCacheRange[meshCount]			(one per mesh, in MeshModel order)
+	// - MeshCacheString[materialCount]	(texture name of each material, may be empty)
+	// - MeshCacheDependency[dependencyCount]	(files the import read, .mtl libraries...)
+	// - Source path + texture names + dependency paths characters
+	// - Encoded data: the vertex streams, then the indices, of each mesh
+	class MeshCache
+	{
+	public:
+		static constexpr uint64_t MESH_CACHE_ALIGNMENT{ 16 };
+
+		// Files read from the asset pack are identified by their pack entry, loose files by their size and time
+		struct MeshCacheStamp {
+			uint64_t size;
+			int64_t modifiedTime;		// 0 for packed files
+			uint64_t contentHash;		// Of the pack entry, 0 for loose files
+
+			bool operator==(const MeshCacheStamp&) const = default;
+		};
+
+		struct MeshCacheHeader {
+			char magic[8];
+			uint32_t version;
+			uint32_t importFlags;
+			MeshCacheStamp source;
+			uint32_t vertexFormat;				// VertexFormat of the vertex streams
+			uint32_t meshCount;
+			uint32_t materialCount;
+			uint32_t sourcePathLength;
+			uint32_t dependencyCount;
+			uint32_t padding;
+			uint64_t meshRangesOffset;
+			uint64_t materialNamesOffset;
+			uint64_t dependenciesOffset;
+			uint64_t stringsOffset;
+			uint64_t dataOffset;
+			uint64_t fileSize;
+		};
+
+		struct MeshCacheRange {
+			glm::mat4 dequantization;
+			glm::vec4 boundingSphere;
+			uint64_t vertexDataOffset;		// Relative to dataOffset
+			uint64_t vertexDataSize;
+			uint64_t attributeOffset;		// In the vertex data
+			uint64_t indexDataOffset;		// Relative to dataOffset
+			uint32_t vertexCount;
+			uint32_t indexCount;
+			uint32_t indexType;				// VkIndexType, UINT16 or UINT32
+			uint32_t materialIndex;
+		};
+
+		struct MeshCacheString {
+			uint32_t offset;	// Relative to stringsOffset
+			uint32_t length;
+		};
+
+		// An entry is stale once any of its dependencies changes or disappears
+		struct MeshCacheDependency {
+			MeshCacheString path;
+			MeshCacheStamp stamp;
+		};
+
+		MeshCache();
+		MeshCache(const std::string& cacheDirectory);
+
+		~MeshCache();
+
+		// Returns false if there is no valid cache entry for this source file, its dependencies, import flags and
+		// vertex format. The meshes point into modelData->cacheFile. Files are stamped in assetPack if it has them,
+		// like MappedIOSystem reads them
+		bool load(const AssetPack& assetPack, const std::string& modelFileName, uint32_t importFlags, VertexFormat vertexFormat,
+			EncodedModelData* modelData) const;
+
+		// Returns false if the entry could not be written (the cache is optional, so this is not an error).
+		// dependencyFileNames are the files the import read (MappedIOSystem::get_opened_file_names).
+		bool store(const AssetPack& assetPack, const std::string& modelFileName, uint32_t importFlags, VertexFormat vertexFormat,
+			const std::vector<std::string>& dependencyFileNames, const EncodedModelData& modelData) const;
+
+	private:
+		std::string m_cacheDirectory{ "Cache" };
+
+		std::string get_cache_file_name(const std::string& modelFileName) const;
+
+		static bool get_stamp(const AssetPack& assetPack, const std::string& fileName, MeshCacheStamp* stamp);
+	};
+
+}
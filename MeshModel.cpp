@@ -1,5 +1,7 @@
 #include "MeshModel.h"
 
+#include <cstring>
+
 namespace VkCourse {
 
 	MeshModel::MeshModel()
@@ -44,37 +46,33 @@ namespace VkCourse {
 		return textureList;
 	}
 
-	std::vector<Mesh> MeshModel::load_node(VkPhysicalDevice physicalDevice, VkDevice device, 
-		VkQueue transferQueue, VkCommandPool transferCommandPool, 
-		aiNode* node, const aiScene* scene, const std::vector<size_t>& materialsToTextures)
+	std::vector<MeshData> MeshModel::load_node(aiNode* node, const aiScene* scene)
 	{
-		std::vector<Mesh> meshList{};
+		std::vector<MeshData> meshList{};
 
-		// Go through each mesh at this node, create it and add to the list
+		// Go through each mesh at this node, load it and add to the list
 		for (size_t i = 0; i < node->mNumMeshes; ++i)
 		{
 			// The scene contains all meshes and nodes contain references to those meshes
-			meshList.push_back(load_mesh(physicalDevice, device, transferQueue, transferCommandPool,
-				scene->mMeshes[node->mMeshes[i]], scene, materialsToTextures));
+			meshList.push_back(load_mesh(scene->mMeshes[node->mMeshes[i]], scene));
 		}
 
 		// Go through each children node, load it and append meshes to this node's list
 		for (size_t i = 0; i < node->mNumChildren; ++i)
 		{
-			std::vector<Mesh> childMeshList{ load_node(physicalDevice, device, transferQueue, transferCommandPool,
-				node->mChildren[i], scene, materialsToTextures) };
-			meshList.insert(meshList.end(), childMeshList.begin(), childMeshList.end());
+			std::vector<MeshData> childMeshList{ load_node(node->mChildren[i], scene) };
+			meshList.insert(meshList.end(), 
+				std::make_move_iterator(childMeshList.begin()), std::make_move_iterator(childMeshList.end()));
 		}
 
 		return meshList;
 	}
 
-	Mesh MeshModel::load_mesh(VkPhysicalDevice physicalDevice, VkDevice device, 
-		VkQueue transferQueue, VkCommandPool transferCommandPool, 
-		aiMesh* mesh, const aiScene* scene, const std::vector<size_t>& materialsToTextures)
+	MeshData MeshModel::load_mesh(aiMesh* mesh, const aiScene* scene)
 	{
-		std::vector<Vertex> vertices{};
-		std::vector<uint32_t> indices{};
+		MeshData meshData{};
+		std::vector<Vertex>& vertices{ meshData.vertices };
+		std::vector<uint32_t>& indices{ meshData.indices };
 
 		vertices.resize(mesh->mNumVertices);
 
@@ -91,12 +89,10 @@ namespace VkCourse {
 			{
 				vertices[i].texCoords = { 0.f, 0.f };
 			}
-
-			// (not in use by current shaders)
-			//vertices[i].color = { 1.f, 1.f, 1.f };
 		}
 
 		// Iterate over indices and copy
+		indices.reserve(static_cast<size_t>(mesh->mNumFaces) * 3);
 		for (size_t i = 0; i < mesh->mNumFaces; ++i)
 		{
 			aiFace face{ mesh->mFaces[i] };
@@ -106,8 +102,85 @@ namespace VkCourse {
 			}
 		}
 
-		// Mesh
-		return { physicalDevice, device, transferQueue, transferCommandPool, &vertices, &indices, materialsToTextures[mesh->mMaterialIndex] };
+		meshData.materialIndex = mesh->mMaterialIndex;
+		meshData.triangleList = mesh->mPrimitiveTypes == aiPrimitiveType_TRIANGLE;
+
+		return meshData;
+	}
+
+	EncodedModelData MeshModel::encode_model(const ModelData& modelData, VertexFormat vertexFormat)
+	{
+		EncodedModelData encodedModelData{ .textureNames = modelData.textureNames };
+		encodedModelData.meshes.reserve(modelData.meshes.size());
+		encodedModelData.encodedData.reserve(2 * modelData.meshes.size());
+
+		for (const MeshData& meshData : modelData.meshes)
+		{
+			VertexStreams vertexStreams{ encode_vertices(meshData.vertices, vertexFormat) };
+
+			// Sphere around the bounding box, enough for the texture streaming distance heuristic
+			glm::vec4 boundingSphere{ 0.f };
+			if (!meshData.vertices.empty())
+			{
+				glm::vec3 minPosition{ meshData.vertices[0].position };
+				glm::vec3 maxPosition{ meshData.vertices[0].position };
+				for (const Vertex& vertex : meshData.vertices)
+				{
+					minPosition = glm::min(minPosition, vertex.position);
+					maxPosition = glm::max(maxPosition, vertex.position);
+				}
+				boundingSphere = glm::vec4((minPosition + maxPosition) * 0.5f, glm::length(maxPosition - minPosition) * 0.5f);
+			}
+
+			// Half the memory and index fetch bandwidth for meshes with few enough vertices
+			const bool shortIndices{ meshData.vertices.size() <= UINT16_MAX + 1 };
+			std::vector<unsigned char> indexData((shortIndices ? sizeof(uint16_t) : sizeof(uint32_t)) * meshData.indices.size());
+			if (shortIndices)
+			{
+				for (size_t i = 0; i < meshData.indices.size(); ++i)
+				{
+					const uint16_t index{ static_cast<uint16_t>(meshData.indices[i]) };
+					memcpy(indexData.data() + i * sizeof(uint16_t), &index, sizeof(uint16_t));
+				}
+			}
+			else
+			{
+				memcpy(indexData.data(), meshData.indices.data(), indexData.size());
+			}
+
+			// Moving the vectors into encodedData keeps their data where the spans point
+			encodedModelData.meshes.push_back({
+				.vertexData = vertexStreams.data,
+				.attributeOffset = vertexStreams.attributeOffset,
+				.vertexCount = static_cast<uint32_t>(meshData.vertices.size()),
+				.dequantization = vertexStreams.dequantization,
+				.boundingSphere = boundingSphere,
+				.indexData = indexData,
+				.indexType = shortIndices ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32,
+				.indexCount = static_cast<uint32_t>(meshData.indices.size()),
+				.materialIndex = meshData.materialIndex,
+			});
+			encodedModelData.encodedData.push_back(std::move(vertexStreams.data));
+			encodedModelData.encodedData.push_back(std::move(indexData));
+		}
+
+		return encodedModelData;
+	}
+
+	std::vector<Mesh> MeshModel::create_meshes(VkPhysicalDevice physicalDevice, VkDevice device,
+		VkQueue transferQueue, VkCommandPool transferCommandPool,
+		const std::vector<EncodedMesh>& encodedMeshes, const std::vector<size_t>& materialsToTextures)
+	{
+		std::vector<Mesh> meshList{};
+		meshList.reserve(encodedMeshes.size());
+
+		for (const EncodedMesh& encodedMesh : encodedMeshes)
+		{
+			meshList.emplace_back(physicalDevice, device, transferQueue, transferCommandPool, 
+				encodedMesh, materialsToTextures[encodedMesh.materialIndex]);
+		}
+
+		return meshList;
 	}
 
 	size_t MeshModel::get_mesh_count()
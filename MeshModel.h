@@ -1,5 +1,6 @@
 #pragma once
 #include "Mesh.h"
+#include "MappedFile.h"
 
 #include <glm/glm.hpp>
 
@@ -9,9 +10,32 @@
 #pragma warning( pop )
 
 #include <vector>
+#include <string>
 
 namespace VkCourse {
 
+	// Mesh data as imported, before being uploaded to the GPU
+	struct MeshData {
+		std::vector<Vertex> vertices;
+		std::vector<uint32_t> indices;
+		uint32_t materialIndex;
+		bool triangleList{ true };		// Only triangles, aiProcess_Triangulate leaves points and lines as they are
+	};
+
+	// Everything needed to build a MeshModel, either from Assimp or from the mesh cache
+	struct ModelData {
+		std::vector<std::string> textureNames;	// 1:1 with the model materials
+		std::vector<MeshData> meshes;
+	};
+
+	// A model ready to be uploaded, either mapped from the mesh cache or encoded after an import
+	struct EncodedModelData {
+		std::vector<std::string> textureNames;	// 1:1 with the model materials
+		std::vector<EncodedMesh> meshes;		// Point into cacheFile or encodedData
+		MappedFile cacheFile{};
+		std::vector<std::vector<unsigned char>> encodedData{};		// Vertex streams and indices of each mesh
+	};
+
 	class MeshModel
 	{
 	public:
@@ -32,13 +56,16 @@ namespace VkCourse {
 
 		static std::vector<std::string> load_materials(const aiScene* scene);
 
-		static std::vector<Mesh> load_node(VkPhysicalDevice physicalDevice, VkDevice device,
-			VkQueue transferQueue, VkCommandPool transferCommandPool,
-			aiNode* node, const aiScene* scene, const std::vector<size_t>& materialsToTextures);
+		static std::vector<MeshData> load_node(aiNode* node, const aiScene* scene);
+
+		static MeshData load_mesh(aiMesh* mesh, const aiScene* scene);
+
+		// Indices are 16-bit whenever every vertex can be addressed with them
+		static EncodedModelData encode_model(const ModelData& modelData, VertexFormat vertexFormat);
 
-		static Mesh load_mesh(VkPhysicalDevice physicalDevice, VkDevice device,
+		static std::vector<Mesh> create_meshes(VkPhysicalDevice physicalDevice, VkDevice device,
 			VkQueue transferQueue, VkCommandPool transferCommandPool,
-			aiMesh* mesh, const aiScene* scene, const std::vector<size_t>& materialsToTextures);
+			const std::vector<EncodedMesh>& encodedMeshes, const std::vector<size_t>& materialsToTextures);
 
 
 	private:
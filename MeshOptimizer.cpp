@@ -0,0 +1,359 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <numeric>
+#include <cmath>
+
+namespace VkCourse {
+
+	namespace {
+		// Forsyth's scoring, https://tomforsyth1000.github.io/papers/fast_vert_cache_opt.html
+		constexpr size_t FORSYTH_CACHE_SIZE{ 32 };
+		constexpr float FORSYTH_CACHE_DECAY_POWER{ 1.5f };
+		constexpr float FORSYTH_LAST_TRIANGLE_SCORE{ 0.75f };
+		constexpr float FORSYTH_VALENCE_BOOST_SCALE{ 2.f };
+		constexpr float FORSYTH_VALENCE_BOOST_POWER{ 0.5f };
+
+		constexpr uint32_t INVALID_INDEX{ UINT32_MAX };
+
+		float get_vertex_score(int cachePosition, uint32_t remainingTriangles)
+		{
+			if (remainingTriangles == 0)
+			{
+				return -1.f;	// No triangle needs it anymore
+			}
+
+			float score{};
+			if (cachePosition >= 0)
+			{
+				// The vertices of the last triangle get a fixed score, so the next one doesn't favour any edge
+				if (cachePosition < 3)
+				{
+					score = FORSYTH_LAST_TRIANGLE_SCORE;
+				}
+				else
+				{
+					const float scaler{ 1.f / (FORSYTH_CACHE_SIZE - 3) };
+					score = std::pow(1.f - (cachePosition - 3) * scaler, FORSYTH_CACHE_DECAY_POWER);
+				}
+			}
+
+			// Boost vertices with few triangles left, so that lone triangles are not left behind
+			score += FORSYTH_VALENCE_BOOST_SCALE * std::pow(static_cast<float>(remainingTriangles), -FORSYTH_VALENCE_BOOST_POWER);
+			return score;
+		}
+	}
+
+	VertexCacheStats analyze_vertex_cache(const std::vector<uint32_t>& indices, size_t vertexCount, uint32_t cacheSize)
+	{
+		if (indices.empty())
+		{
+			return { 0.f, 0.f };
+		}
+
+		// FIFO cache, vertices are added at the timestamp they are transformed
+		std::vector<uint32_t> cacheTimestamps(vertexCount, 0);
+		std::vector<bool> used(vertexCount, false);
+		uint32_t timestamp{ cacheSize + 1 };
+		size_t transformCount{};
+		size_t usedVertexCount{};
+
+		for (uint32_t index : indices)
+		{
+			if (timestamp - cacheTimestamps[index] > cacheSize)
+			{
+				cacheTimestamps[index] = timestamp++;
+				++transformCount;
+			}
+
+			if (!used[index])
+			{
+				used[index] = true;
+				++usedVertexCount;
+			}
+		}
+
+		return {
+			.acmr = static_cast<float>(transformCount) / (indices.size() / 3),
+			.atvr = static_cast<float>(transformCount) / usedVertexCount,
+		};
+	}
+
+	void optimize_vertex_cache(std::vector<uint32_t>& indices, size_t vertexCount)
+	{
+		const size_t triangleCount{ indices.size() / 3 };
+		if (triangleCount == 0)
+		{
+			return;
+		}
+
+		// Triangles using each vertex, compacted as triangles are emitted
+		std::vector<uint32_t> remainingTriangles(vertexCount, 0);
+		for (uint32_t index : indices)
+		{
+			++remainingTriangles[index];
+		}
+
+		std::vector<uint32_t> vertexTriangleOffsets(vertexCount + 1, 0);
+		std::partial_sum(remainingTriangles.begin(), remainingTriangles.end(), vertexTriangleOffsets.begin() + 1);
+
+		std::vector<uint32_t> vertexTriangles(indices.size());
+		{
+			std::vector<uint32_t> vertexTriangleCounts(vertexCount, 0);
+			for (size_t i = 0; i < indices.size(); ++i)
+			{
+				const uint32_t index{ indices[i] };
+				vertexTriangles[vertexTriangleOffsets[index] + vertexTriangleCounts[index]++] = static_cast<uint32_t>(i / 3);
+			}
+		}
+
+		std::vector<int> cachePositions(vertexCount, -1);
+		std::vector<float> vertexScores(vertexCount);
+		for (size_t i = 0; i < vertexCount; ++i)
+		{
+			vertexScores[i] = get_vertex_score(-1, remainingTriangles[i]);
+		}
+
+		std::vector<float> triangleScores(triangleCount);
+		std::vector<bool> emitted(triangleCount, false);
+		for (size_t i = 0; i < triangleCount; ++i)
+		{
+			triangleScores[i] = vertexScores[indices[i * 3]] + vertexScores[indices[i * 3 + 1]] + vertexScores[indices[i * 3 + 2]];
+		}
+
+		std::vector<uint32_t> optimizedIndices{};
+		optimizedIndices.reserve(indices.size());
+
+		std::vector<uint32_t> cache{};
+		std::vector<uint32_t> newCache{};
+		cache.reserve(FORSYTH_CACHE_SIZE + 3);
+		newCache.reserve(FORSYTH_CACHE_SIZE + 3);
+
+		uint32_t bestTriangle{ static_cast<uint32_t>(std::max_element(triangleScores.begin(), triangleScores.end()) - triangleScores.begin()) };
+		size_t inputCursor{};
+
+		for (size_t emittedCount = 0; emittedCount < triangleCount; ++emittedCount)
+		{
+			// Nothing in the cache is connected to a remaining triangle, continue with the next one in input order
+			if (bestTriangle == INVALID_INDEX)
+			{
+				while (emitted[inputCursor])
+				{
+					++inputCursor;
+				}
+				bestTriangle = static_cast<uint32_t>(inputCursor);
+			}
+
+			const uint32_t* triangle{ &indices[static_cast<size_t>(bestTriangle) * 3] };
+			optimizedIndices.insert(optimizedIndices.end(), triangle, triangle + 3);
+			emitted[bestTriangle] = true;
+
+			// Remove the triangle from the lists of its vertices
+			for (size_t i = 0; i < 3; ++i)
+			{
+				const uint32_t vertex{ triangle[i] };
+				uint32_t* begin{ &vertexTriangles[vertexTriangleOffsets[vertex]] };
+				uint32_t* end{ begin + remainingTriangles[vertex] };
+				std::iter_swap(std::find(begin, end, bestTriangle), end - 1);
+				--remainingTriangles[vertex];
+			}
+
+			// Triangle vertices go to the front of the cache, in LRU order
+			newCache.assign(triangle, triangle + 3);
+			for (uint32_t vertex : cache)
+			{
+				if (vertex != triangle[0] && vertex != triangle[1] && vertex != triangle[2])
+				{
+					newCache.push_back(vertex);
+				}
+			}
+			std::swap(cache, newCache);
+
+			// Update the scores of the vertices in the cache, and those just evicted from it
+			for (size_t i = 0; i < cache.size(); ++i)
+			{
+				const uint32_t vertex{ cache[i] };
+				cachePositions[vertex] = i < FORSYTH_CACHE_SIZE ? static_cast<int>(i) : -1;
+				vertexScores[vertex] = get_vertex_score(cachePositions[vertex], remainingTriangles[vertex]);
+			}
+
+			// Only the triangles of these vertices changed score, the best of them is emitted next
+			bestTriangle = INVALID_INDEX;
+			float bestScore{ -1.f };
+			for (uint32_t vertex : cache)
+			{
+				const uint32_t* begin{ &vertexTriangles[vertexTriangleOffsets[vertex]] };
+				for (const uint32_t* t = begin; t != begin + remainingTriangles[vertex]; ++t)
+				{
+					const size_t base{ static_cast<size_t>(*t) * 3 };
+					const float score{ vertexScores[indices[base]] + vertexScores[indices[base + 1]] + vertexScores[indices[base + 2]] };
+					triangleScores[*t] = score;
+					if (score > bestScore)
+					{
+						bestScore = score;
+						bestTriangle = *t;
+					}
+				}
+			}
+
+			if (cache.size() > FORSYTH_CACHE_SIZE)
+			{
+				cache.resize(FORSYTH_CACHE_SIZE);
+			}
+		}
+
+		indices = std::move(optimizedIndices);
+	}
+
+	void optimize_overdraw(std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices, 
+		uint32_t cacheSize, float threshold)
+	{
+		const size_t triangleCount{ indices.size() / 3 };
+		if (triangleCount < 2)
+		{
+			return;
+		}
+
+		// Split the cache optimized order into clusters where the cache was flushed (every vertex of the triangle
+		// is a miss), so that reordering the clusters barely changes the cache efficiency
+		std::vector<size_t> clusterStarts{ 0 };
+		{
+			std::vector<uint32_t> cacheTimestamps(vertices.size(), 0);
+			uint32_t timestamp{ cacheSize + 1 };
+			for (size_t i = 0; i < triangleCount; ++i)
+			{
+				uint32_t missCount{};
+				for (size_t j = 0; j < 3; ++j)
+				{
+					const uint32_t index{ indices[i * 3 + j] };
+					if (timestamp - cacheTimestamps[index] > cacheSize)
+					{
+						cacheTimestamps[index] = timestamp++;
+						++missCount;
+					}
+				}
+
+				if (missCount == 3 && i != clusterStarts.back())
+				{
+					clusterStarts.push_back(i);
+				}
+			}
+		}
+
+		if (clusterStarts.size() < 2)
+		{
+			return;
+		}
+
+		glm::vec3 meshCentroid{ 0.f };
+		float meshArea{};
+		std::vector<float> clusterSortKeys(clusterStarts.size());
+		std::vector<glm::vec3> clusterCentroids(clusterStarts.size());
+		std::vector<glm::vec3> clusterNormals(clusterStarts.size());
+
+		for (size_t c = 0; c < clusterStarts.size(); ++c)
+		{
+			const size_t end{ c + 1 < clusterStarts.size() ? clusterStarts[c + 1] : triangleCount };
+
+			glm::vec3 centroid{ 0.f };
+			glm::vec3 normal{ 0.f };
+			float area{};
+			for (size_t i = clusterStarts[c]; i < end; ++i)
+			{
+				const glm::vec3& p0{ vertices[indices[i * 3]].position };
+				const glm::vec3& p1{ vertices[indices[i * 3 + 1]].position };
+				const glm::vec3& p2{ vertices[indices[i * 3 + 2]].position };
+
+				const glm::vec3 areaNormal{ glm::cross(p1 - p0, p2 - p0) };		// Length is twice the area
+				const float triangleArea{ glm::length(areaNormal) };
+
+				centroid += (p0 + p1 + p2) * (triangleArea / 3.f);
+				normal += areaNormal;
+				area += triangleArea;
+			}
+
+			meshCentroid += centroid;
+			meshArea += area;
+
+			clusterCentroids[c] = area > 0.f ? centroid / area : centroid;
+			const float normalLength{ glm::length(normal) };
+			clusterNormals[c] = normalLength > 0.f ? normal / normalLength : normal;
+		}
+
+		if (meshArea > 0.f)
+		{
+			meshCentroid /= meshArea;
+		}
+
+		// Clusters facing away from the center are more likely to occlude the others, draw them first
+		for (size_t c = 0; c < clusterStarts.size(); ++c)
+		{
+			clusterSortKeys[c] = glm::dot(clusterCentroids[c] - meshCentroid, clusterNormals[c]);
+		}
+
+		std::vector<size_t> clusterOrder(clusterStarts.size());
+		std::iota(clusterOrder.begin(), clusterOrder.end(), 0);
+		std::stable_sort(clusterOrder.begin(), clusterOrder.end(), 
+			[&clusterSortKeys](size_t a, size_t b) { return clusterSortKeys[a] > clusterSortKeys[b]; });
+
+		std::vector<uint32_t> sortedIndices{};
+		sortedIndices.reserve(indices.size());
+		for (size_t c : clusterOrder)
+		{
+			const size_t end{ c + 1 < clusterStarts.size() ? clusterStarts[c + 1] : triangleCount };
+			sortedIndices.insert(sortedIndices.end(), indices.begin() + clusterStarts[c] * 3, indices.begin() + end * 3);
+		}
+
+		// Keep the cache order if reordering the clusters costs too many transforms
+		const float acmr{ analyze_vertex_cache(indices, vertices.size(), cacheSize).acmr };
+		const float sortedAcmr{ analyze_vertex_cache(sortedIndices, vertices.size(), cacheSize).acmr };
+		if (sortedAcmr <= acmr * threshold)
+		{
+			indices = std::move(sortedIndices);
+		}
+	}
+
+	void optimize_vertex_fetch(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+	{
+		std::vector<uint32_t> remap(vertices.size(), INVALID_INDEX);
+		std::vector<Vertex> fetchOrderVertices{};
+		fetchOrderVertices.reserve(vertices.size());
+
+		for (uint32_t& index : indices)
+		{
+			if (remap[index] == INVALID_INDEX)
+			{
+				remap[index] = static_cast<uint32_t>(fetchOrderVertices.size());
+				fetchOrderVertices.push_back(vertices[index]);
+			}
+			index = remap[index];
+		}
+
+		vertices = std::move(fetchOrderVertices);
+	}
+
+	MeshOptimizeStats optimize_mesh(MeshData* meshData, const MeshOptimizeOptions& options)
+	{
+		std::vector<Vertex>& vertices{ meshData->vertices };
+		std::vector<uint32_t>& indices{ meshData->indices };
+
+		MeshOptimizeStats stats{};
+		if (!meshData->triangleList)
+		{
+			return stats;		// Points or lines
+		}
+
+		stats.before = analyze_vertex_cache(indices, vertices.size(), options.cacheSize);
+
+		optimize_vertex_cache(indices, vertices.size());
+		if (options.optimizeOverdraw)
+		{
+			optimize_overdraw(indices, vertices, options.cacheSize, options.overdrawThreshold);
+		}
+		optimize_vertex_fetch(vertices, indices);
+
+		stats.after = analyze_vertex_cache(indices, vertices.size(), options.cacheSize);
+		return stats;
+	}
+
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include "MeshModel.h"
+
+#include <vector>
+#include <cstdint>
+
+namespace VkCourse {
+
+	// Import time reordering of mesh data for the GPU:
+	// - triangles for the post-transform vertex cache (Forsyth's linear-speed algorithm)
+	// - optionally, clusters of those triangles so that outward facing ones are drawn first (less overdraw)
+	// - vertices in order of first use, for vertex fetch locality
+
+	struct MeshOptimizeOptions {
+		bool optimizeOverdraw{ true };
+		float overdrawThreshold{ 1.05f };	// Max ACMR increase accepted to reduce overdraw
+		uint32_t cacheSize{ 16 };			// FIFO cache simulated for the statistics and the overdraw clusters
+	};
+
+	struct VertexCacheStats {
+		float acmr;		// Average cache miss ratio, vertex shader invocations per triangle (0.5 - 3)
+		float atvr;		// Average transform to vertex ratio, vertex shader invocations per vertex (1 is optimal)
+	};
+
+	struct MeshOptimizeStats {
+		VertexCacheStats before;
+		VertexCacheStats after;
+	};
+
+	VertexCacheStats analyze_vertex_cache(const std::vector<uint32_t>& indices, size_t vertexCount, uint32_t cacheSize);
+
+	void optimize_vertex_cache(std::vector<uint32_t>& indices, size_t vertexCount);
+
+	// Expects indices already optimized for the vertex cache
+	void optimize_overdraw(std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices, 
+		uint32_t cacheSize, float threshold);
+
+	// Unreferenced vertices are removed
+	void optimize_vertex_fetch(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
+
+	// Runs every step on a triangle list mesh, meshes with other primitives are left as they are
+	MeshOptimizeStats optimize_mesh(MeshData* meshData, const MeshOptimizeOptions& options);
+
+}
@@ -0,0 +1,44 @@
+#include "Mipmaps.h"
+
+#include <algorithm>
+#include <cstddef>
+
+namespace VkCourse {
+
+	uint32_t get_mip_level_count(uint32_t width, uint32_t height)
+	{
+		uint32_t levelCount{ 1 };
+		for (uint32_t size = std::max(width, height); size > 1; size /= 2)
+		{
+			++levelCount;
+		}
+		return levelCount;
+	}
+
+	void downsample_rgba(const unsigned char* src, uint32_t width, uint32_t height, unsigned char* dst)
+	{
+		const uint32_t dstWidth{ std::max(1u, width / 2) };
+		const uint32_t dstHeight{ std::max(1u, height / 2) };
+
+		auto texel{ [src, width](uint32_t x, uint32_t y, uint32_t c) -> uint32_t {
+			return src[(static_cast<size_t>(y) * width + x) * 4 + c];
+		} };
+
+		for (uint32_t y = 0; y < dstHeight; ++y)
+		{
+			const uint32_t y0{ std::min(y * 2, height - 1) };
+			const uint32_t y1{ std::min(y * 2 + 1, height - 1) };
+			for (uint32_t x = 0; x < dstWidth; ++x)
+			{
+				const uint32_t x0{ std::min(x * 2, width - 1) };
+				const uint32_t x1{ std::min(x * 2 + 1, width - 1) };
+				for (uint32_t c = 0; c < 4; ++c)
+				{
+					const uint32_t sum{ texel(x0, y0, c) + texel(x1, y0, c) + texel(x0, y1, c) + texel(x1, y1, c) };
+					dst[(static_cast<size_t>(y) * dstWidth + x) * 4 + c] = static_cast<unsigned char>((sum + 2) / 4);
+				}
+			}
+		}
+	}
+
+}
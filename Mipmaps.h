@@ -0,0 +1,14 @@
+#pragma once
+
+#include <cstdint>
+
+namespace VkCourse {
+
+	// Number of levels of a full mip chain, down to 1x1
+	uint32_t get_mip_level_count(uint32_t width, uint32_t height);
+
+	// 2x2 box filter of tightly packed RGBA8, dst receives max(1, width / 2) x max(1, height / 2) texels.
+	// For odd sizes the last row/column is reused.
+	void downsample_rgba(const unsigned char* src, uint32_t width, uint32_t height, unsigned char* dst);
+
+}
@@ -0,0 +1,152 @@
+#include "PipelineCache.h"
+#include "MappedFile.h"
+
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+#include <cstring>
+
+namespace VkCourse {
+
+	PipelineCache::PipelineCache()
+	{
+	}
+
+	PipelineCache::PipelineCache(const std::string& fileName)
+		: m_fileName{ fileName }
+	{
+	}
+
+	PipelineCache::~PipelineCache()
+	{
+	}
+
+	void PipelineCache::create(VkPhysicalDevice physicalDevice, VkDevice device)
+	{
+		m_device = device;
+		m_warm = false;
+
+		VkPhysicalDeviceProperties properties;
+		vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+		// The file only has to stay mapped until the driver has copied the initial data
+		MappedFile file{};
+		if (file.open(m_fileName, MappedFileAccess::Sequential) && !is_compatible(file.data(), file.size(), properties))
+		{
+			std::cerr << m_fileName << " was written for another device or driver, ignoring it" << std::endl;
+			file.close();
+		}
+
+		VkPipelineCacheCreateInfo pipelineCacheCreateInfo{
+			.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+			.initialDataSize = file.is_open() ? file.size() : 0,
+			.pInitialData = file.is_open() ? file.data() : nullptr
+		};
+
+		VkResult result{ vkCreatePipelineCache(m_device, &pipelineCacheCreateInfo, nullptr, &m_pipelineCache) };
+		if (result == VK_SUCCESS)
+		{
+			m_warm = pipelineCacheCreateInfo.initialDataSize > 0;
+			return;
+		}
+
+		// Data the driver still rejects, start from an empty cache
+		pipelineCacheCreateInfo.initialDataSize = 0;
+		pipelineCacheCreateInfo.pInitialData = nullptr;
+		result = vkCreatePipelineCache(m_device, &pipelineCacheCreateInfo, nullptr, &m_pipelineCache);
+		if (result != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create pipeline cache!");
+		}
+	}
+
+	bool PipelineCache::save() const
+	{
+		if (m_pipelineCache == VK_NULL_HANDLE)
+		{
+			return false;
+		}
+
+		size_t dataSize{};
+		if (vkGetPipelineCacheData(m_device, m_pipelineCache, &dataSize, nullptr) != VK_SUCCESS || dataSize == 0)
+		{
+			return false;
+		}
+
+		std::vector<char> data(dataSize);
+		if (vkGetPipelineCacheData(m_device, m_pipelineCache, &dataSize, data.data()) != VK_SUCCESS)
+		{
+			return false;
+		}
+
+		// Write to a temporary file and swap it in, so a reader never sees a partially written cache
+		std::error_code error;
+		const std::filesystem::path directory{ std::filesystem::path(m_fileName).parent_path() };
+		if (!directory.empty())
+		{
+			std::filesystem::create_directories(directory, error);
+		}
+
+		const std::string temporaryFileName{ m_fileName + ".tmp" };
+		{
+			std::ofstream file(temporaryFileName, std::ios::binary | std::ios::trunc);
+			if (!file.is_open())
+			{
+				return false;
+			}
+
+			file.write(data.data(), dataSize);
+			if (!file)
+			{
+				return false;
+			}
+		}
+
+		std::filesystem::rename(temporaryFileName, m_fileName, error);
+		if (error)
+		{
+			std::filesystem::remove(temporaryFileName, error);
+			return false;
+		}
+
+		return true;
+	}
+
+	void PipelineCache::destroy()
+	{
+		if (m_pipelineCache != VK_NULL_HANDLE)
+		{
+			vkDestroyPipelineCache(m_device, m_pipelineCache, nullptr);
+			m_pipelineCache = VK_NULL_HANDLE;
+		}
+	}
+
+	VkPipelineCache PipelineCache::get() const
+	{
+		return m_pipelineCache;
+	}
+
+	bool PipelineCache::is_warm() const
+	{
+		return m_warm;
+	}
+
+	bool PipelineCache::is_compatible(const unsigned char* data, size_t size, const VkPhysicalDeviceProperties& properties)
+	{
+		VkPipelineCacheHeaderVersionOne header;
+		if (size < sizeof(header))
+		{
+			return false;
+		}
+		memcpy(&header, data, sizeof(header));
+
+		return header.headerSize >= sizeof(header) && header.headerSize <= size
+			&& header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE
+			&& header.vendorID == properties.vendorID
+			&& header.deviceID == properties.deviceID
+			&& memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+	}
+
+}
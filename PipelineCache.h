@@ -0,0 +1,42 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <string>
+
+namespace VkCourse {
+
+	// VkPipelineCache kept on disk between runs, so only the first start pays for the shader compilation.
+	// The data is only used if its header was written by the same driver for the same device, otherwise
+	// the cache starts empty and the file is replaced on save().
+	class PipelineCache
+	{
+	public:
+		PipelineCache();
+		PipelineCache(const std::string& fileName);
+
+		~PipelineCache();
+
+		// Never fails because of the file, a missing or stale cache only means a cold start
+		void create(VkPhysicalDevice physicalDevice, VkDevice device);
+
+		// Writes the cache data back, returns false if it could not be written (the cache is optional)
+		bool save() const;
+
+		void destroy();
+
+		VkPipelineCache get() const;
+
+		// True if the cache was created from the data on disk
+		bool is_warm() const;
+
+	private:
+		std::string m_fileName{ "Cache/Pipelines.bin" };
+		VkDevice m_device{ VK_NULL_HANDLE };
+		VkPipelineCache m_pipelineCache{ VK_NULL_HANDLE };
+		bool m_warm{ false };
+
+		static bool is_compatible(const unsigned char* data, size_t size, const VkPhysicalDeviceProperties& properties);
+	};
+
+}
@@ -0,0 +1,326 @@
+#include "PipelineRegistry.h"
+
+#include <array>
+#include <chrono>
+#include <stdexcept>
+#include <type_traits>
+
+namespace VkCourse {
+
+	namespace {
+		template <typename T>
+		void append_key(std::string* key, const T& value)
+		{
+			static_assert(std::is_trivially_copyable_v<T>);
+			key->append(reinterpret_cast<const char*>(&value), sizeof(T));
+		}
+
+		// Shader code is identified by its address, as the registry keeps one module per code span
+		void append_key(std::string* key, std::span<const uint32_t> code)
+		{
+			append_key(key, code.data());
+			append_key(key, code.size());
+		}
+	}
+
+	PipelineRegistry::PipelineRegistry()
+	{
+	}
+
+	PipelineRegistry::~PipelineRegistry()
+	{
+	}
+
+	void PipelineRegistry::create(VkDevice device, VkPipelineCache pipelineCache)
+	{
+		m_device = device;
+		m_pipelineCache = pipelineCache;
+	}
+
+	size_t PipelineRegistry::request(const GraphicsPipelineDescription& description)
+	{
+		const std::string key{ get_key(description) };
+		auto pipelineId{ m_pipelineIds.find(key) };
+		if (pipelineId != m_pipelineIds.end())
+		{
+			return pipelineId->second;
+		}
+
+		// Modules are created here, so that workers only call vkCreateGraphicsPipelines (thread safe with the same cache)
+		VkShaderModule vertexShaderModule{ get_shader_module(description.vertexShader) };
+		VkShaderModule fragmentShaderModule{ description.fragmentShader.empty() ? VK_NULL_HANDLE : get_shader_module(description.fragmentShader) };
+
+		m_pipelines.push_back(std::async(std::launch::async, compile, m_device, m_pipelineCache, description,
+			vertexShaderModule, fragmentShaderModule).share());
+		m_pipelineIds.emplace(key, m_pipelines.size() - 1);
+		return m_pipelines.size() - 1;
+	}
+
+	VkPipeline PipelineRegistry::get(size_t pipelineId)
+	{
+		if (pipelineId >= m_pipelines.size())
+		{
+			throw std::runtime_error("Attempted to access invalid pipeline id!");
+		}
+		return m_pipelines[pipelineId].get();
+	}
+
+	bool PipelineRegistry::is_ready(size_t pipelineId) const
+	{
+		if (pipelineId >= m_pipelines.size())
+		{
+			throw std::runtime_error("Attempted to access invalid pipeline id!");
+		}
+		return m_pipelines[pipelineId].wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+	}
+
+	size_t PipelineRegistry::get_pipeline_count() const
+	{
+		return m_pipelines.size();
+	}
+
+	void PipelineRegistry::destroy()
+	{
+		for (auto& pipeline : m_pipelines)
+		{
+			try
+			{
+				vkDestroyPipeline(m_device, pipeline.get(), nullptr);
+			}
+			catch (const std::runtime_error&)
+			{
+				// Failed compilation, nothing to destroy
+			}
+		}
+		m_pipelines.clear();
+		m_pipelineIds.clear();
+
+		for (const auto& [code, shaderModule] : m_shaderModules)
+		{
+			vkDestroyShaderModule(m_device, shaderModule, nullptr);
+		}
+		m_shaderModules.clear();
+	}
+
+	VkShaderModule PipelineRegistry::get_shader_module(std::span<const uint32_t> code)
+	{
+		auto shaderModule{ m_shaderModules.find(code.data()) };
+		if (shaderModule != m_shaderModules.end())
+		{
+			return shaderModule->second;
+		}
+
+		VkShaderModuleCreateInfo shaderModuleCreateInfo{
+			.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+			.codeSize = code.size_bytes(),
+			.pCode = code.data()
+		};
+
+		VkShaderModule newShaderModule;
+		VkResult result{ vkCreateShaderModule(m_device, &shaderModuleCreateInfo, nullptr, &newShaderModule) };
+		if (result != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create shader module!");
+		}
+
+		m_shaderModules.emplace(code.data(), newShaderModule);
+		return newShaderModule;
+	}
+
+	std::string PipelineRegistry::get_key(const GraphicsPipelineDescription& description)
+	{
+		// Every field, so two descriptions have the same key only if they would build the same pipeline
+		std::string key{};
+		append_key(&key, description.vertexShader);
+		append_key(&key, description.fragmentShader);
+		append_key(&key, description.specializationConstants.size());
+		for (uint32_t constant : description.specializationConstants)
+		{
+			append_key(&key, constant);
+		}
+		append_key(&key, description.vertexBindings.size());
+		for (const VkVertexInputBindingDescription& binding : description.vertexBindings)
+		{
+			append_key(&key, binding);
+		}
+		append_key(&key, description.vertexAttributes.size());
+		for (const VkVertexInputAttributeDescription& attribute : description.vertexAttributes)
+		{
+			append_key(&key, attribute);
+		}
+		append_key(&key, description.topology);
+		append_key(&key, description.polygonMode);
+		append_key(&key, description.cullMode);
+		append_key(&key, description.frontFace);
+		append_key(&key, description.samples);
+		append_key(&key, description.depthTest);
+		append_key(&key, description.depthWrite);
+		append_key(&key, description.depthCompareOp);
+		append_key(&key, description.alphaBlend);
+		append_key(&key, description.colorWriteMask);
+		append_key(&key, description.layout);
+		append_key(&key, description.renderPass);
+		append_key(&key, description.subpass);
+		return key;
+	}
+
+	VkPipeline PipelineRegistry::compile(VkDevice device, VkPipelineCache pipelineCache, const GraphicsPipelineDescription& description,
+		VkShaderModule vertexShaderModule, VkShaderModule fragmentShaderModule)
+	{
+		// Constant i is read from bytes [4i, 4i + 4) of the constants, ids a stage doesn't declare are ignored
+		std::vector<VkSpecializationMapEntry> specializationMapEntries(description.specializationConstants.size());
+		for (uint32_t i = 0; i < specializationMapEntries.size(); ++i)
+		{
+			specializationMapEntries[i] = {
+				.constantID = i,
+				.offset = i * static_cast<uint32_t>(sizeof(uint32_t)),
+				.size = sizeof(uint32_t),
+			};
+		}
+
+		const VkSpecializationInfo specializationInfo{
+			.mapEntryCount = static_cast<uint32_t>(specializationMapEntries.size()),
+			.pMapEntries = specializationMapEntries.data(),
+			.dataSize = description.specializationConstants.size() * sizeof(uint32_t),
+			.pData = description.specializationConstants.data(),
+		};
+		const VkSpecializationInfo* stageSpecializationInfo{ specializationMapEntries.empty() ? nullptr : &specializationInfo };
+
+		// Configure stages of the pipeline with create infos
+		std::vector<VkPipelineShaderStageCreateInfo> shaderStages{};
+		shaderStages.push_back({
+			.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+			.stage = VK_SHADER_STAGE_VERTEX_BIT,
+			.module = vertexShaderModule,
+			.pName = "main",
+			.pSpecializationInfo = stageSpecializationInfo,
+		});
+
+		if (fragmentShaderModule != VK_NULL_HANDLE)
+		{
+			shaderStages.push_back({
+				.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+				.stage = VK_SHADER_STAGE_FRAGMENT_BIT,
+				.module = fragmentShaderModule,
+				.pName = "main",
+				.pSpecializationInfo = stageSpecializationInfo,
+			});
+		}
+
+		// -- Vertex input --
+		VkPipelineVertexInputStateCreateInfo vertexInputStateCreateInfo{
+			.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
+			.vertexBindingDescriptionCount = static_cast<uint32_t>(description.vertexBindings.size()),
+			.pVertexBindingDescriptions = description.vertexBindings.data(),		// e.g. data spacing, stride...
+			.vertexAttributeDescriptionCount = static_cast<uint32_t>(description.vertexAttributes.size()),
+			.pVertexAttributeDescriptions = description.vertexAttributes.data(),	// data format, where to bind to/from
+		};
+
+		// -- Input Assembly --
+		VkPipelineInputAssemblyStateCreateInfo inputAssemblyStateCreateInfo{
+			.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
+			.topology = description.topology,
+			.primitiveRestartEnable = VK_FALSE		// Used for strip topology to start new primitives
+		};
+
+		// -- Viewport and scissor --
+		// Set with vkCmdSetViewport and vkCmdSetScissor, so a resize doesn't invalidate the pipeline
+		VkPipelineViewportStateCreateInfo viewportStateCreateInfo{
+			.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
+			.viewportCount = 1,
+			.pViewports = nullptr,
+			.scissorCount = 1,
+			.pScissors = nullptr,
+		};
+
+		// -- Dynamic states --
+		std::array<VkDynamicState, 2> dynamicStates{
+			VK_DYNAMIC_STATE_VIEWPORT,
+			VK_DYNAMIC_STATE_SCISSOR,
+		};
+
+		VkPipelineDynamicStateCreateInfo dynamicStateCreateInfo{
+			.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
+			.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size()),
+			.pDynamicStates = dynamicStates.data(),
+		};
+
+		// -- Rasterizer --
+		VkPipelineRasterizationStateCreateInfo rasterizationStateCreateInfo{
+			.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
+			.depthClampEnable = VK_FALSE,			// Change if fragments beyond near/far planes are clipped or clamped to plane
+			.rasterizerDiscardEnable = VK_FALSE,	// Discard primitives before fragment shader
+			.polygonMode = description.polygonMode,
+			.cullMode = description.cullMode,
+			.frontFace = description.frontFace,
+			.depthBiasEnable = VK_FALSE,
+			.lineWidth = 1.f,
+		};
+
+		// -- Multisampling --
+		VkPipelineMultisampleStateCreateInfo multisampleStateCreateInfo{
+			.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
+			.rasterizationSamples = description.samples,
+			.sampleShadingEnable = VK_FALSE,
+		};
+
+		// -- Blending --
+		// ---- Blending eq: (srcColorBlendFactor * new color) colorBlendOp (dstColorBlendFactor * old color)
+		VkPipelineColorBlendAttachmentState colorBlendAttachmentState{
+			.blendEnable = description.alphaBlend ? VK_TRUE : VK_FALSE,
+			.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA,
+			.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA,
+			.colorBlendOp = VK_BLEND_OP_ADD,
+			.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE,
+			.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO,
+			.alphaBlendOp = VK_BLEND_OP_ADD,
+			.colorWriteMask = description.colorWriteMask,
+		};
+
+		VkPipelineColorBlendStateCreateInfo colorBlendStateCreateInfo{
+			.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
+			.logicOpEnable = VK_FALSE,		// Alternative to calculations
+			.attachmentCount = 1,
+			.pAttachments = &colorBlendAttachmentState,
+		};
+
+		VkPipelineDepthStencilStateCreateInfo depthStencilStateCreateInfo{
+			.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO,
+			.depthTestEnable = description.depthTest ? VK_TRUE : VK_FALSE,
+			.depthWriteEnable = description.depthWrite ? VK_TRUE : VK_FALSE,
+			.depthCompareOp = description.depthCompareOp,
+			.depthBoundsTestEnable = VK_FALSE,			// Check depth value is between bounds
+			.stencilTestEnable = VK_FALSE,
+		};
+
+		// Final graphics pipeline
+		VkGraphicsPipelineCreateInfo graphicsPipelineCreateInfo{
+			.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+			.stageCount = static_cast<uint32_t>(shaderStages.size()),
+			.pStages = shaderStages.data(),
+			.pVertexInputState = &vertexInputStateCreateInfo,
+			.pInputAssemblyState = &inputAssemblyStateCreateInfo,
+			.pViewportState = &viewportStateCreateInfo,
+			.pRasterizationState = &rasterizationStateCreateInfo,
+			.pMultisampleState = &multisampleStateCreateInfo,
+			.pDepthStencilState = &depthStencilStateCreateInfo,
+			.pColorBlendState = &colorBlendStateCreateInfo,
+			.pDynamicState = &dynamicStateCreateInfo,
+			.layout = description.layout,
+			.renderPass = description.renderPass,
+			.subpass = description.subpass,
+			.basePipelineHandle = VK_NULL_HANDLE,	// Used to create pipelines based on other pipelines
+			.basePipelineIndex = -1,
+		};
+
+		VkPipeline pipeline;
+		VkResult result{ vkCreateGraphicsPipelines(device, pipelineCache, 1, &graphicsPipelineCreateInfo, nullptr, &pipeline) };
+		if (result != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create a pipeline!");
+		}
+
+		return pipeline;
+	}
+
+}
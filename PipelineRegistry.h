@@ -0,0 +1,80 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <future>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <cstdint>
+
+namespace VkCourse {
+
+	// Everything that makes two graphics pipelines different. Viewport and scissor are dynamic, set when recording,
+	// so pipelines outlive swapchain resizes.
+	// Descriptions differing only by their specialization constants are variants of the same shaders, each compiled once.
+	struct GraphicsPipelineDescription {
+		std::span<const uint32_t> vertexShader{};		// SPIR-V, embedded (see ShaderCode.h) or kept alive by the caller
+		std::span<const uint32_t> fragmentShader{};		// Empty for depth only pipelines
+		std::vector<uint32_t> specializationConstants{};	// By constant_id, 32 bits each (VkBool32, int or float bits), for every stage
+		std::vector<VkVertexInputBindingDescription> vertexBindings{};
+		std::vector<VkVertexInputAttributeDescription> vertexAttributes{};
+		VkPrimitiveTopology topology{ VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST };
+		VkPolygonMode polygonMode{ VK_POLYGON_MODE_FILL };
+		VkCullModeFlags cullMode{ VK_CULL_MODE_BACK_BIT };
+		VkFrontFace frontFace{ VK_FRONT_FACE_COUNTER_CLOCKWISE };
+		VkSampleCountFlagBits samples{ VK_SAMPLE_COUNT_1_BIT };
+		bool depthTest{ true };
+		bool depthWrite{ true };
+		VkCompareOp depthCompareOp{ VK_COMPARE_OP_LESS };
+		bool alphaBlend{ true };
+		VkColorComponentFlags colorWriteMask{ VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT
+			| VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT };
+		VkPipelineLayout layout{ VK_NULL_HANDLE };
+		VkRenderPass renderPass{ VK_NULL_HANDLE };
+		uint32_t subpass{};
+	};
+
+	// Owns every graphics pipeline. Identical descriptions share one VkPipeline, new ones are compiled on worker
+	// threads (through the pipeline cache) while the caller goes on requesting or doing other work.
+	// Requests and gets are made from a single thread.
+	class PipelineRegistry
+	{
+	public:
+		PipelineRegistry();
+
+		~PipelineRegistry();
+
+		void create(VkDevice device, VkPipelineCache pipelineCache);
+
+		// Returns the id of the pipeline for this description, starting its compilation if it is new
+		size_t request(const GraphicsPipelineDescription& description);
+
+		// Waits for the pipeline to be compiled, rethrows the compilation error if it failed
+		VkPipeline get(size_t pipelineId);
+
+		// True once get() would not wait
+		bool is_ready(size_t pipelineId) const;
+
+		size_t get_pipeline_count() const;
+
+		// Waits for the compilations in progress
+		void destroy();
+
+	private:
+		VkDevice m_device{ VK_NULL_HANDLE };
+		VkPipelineCache m_pipelineCache{ VK_NULL_HANDLE };
+
+		std::unordered_map<std::string, size_t> m_pipelineIds{};		// By description key
+		std::vector<std::shared_future<VkPipeline>> m_pipelines{};
+		std::unordered_map<const uint32_t*, VkShaderModule> m_shaderModules{};		// By code address, kept until destroy()
+
+		VkShaderModule get_shader_module(std::span<const uint32_t> code);
+
+		static std::string get_key(const GraphicsPipelineDescription& description);
+		static VkPipeline compile(VkDevice device, VkPipelineCache pipelineCache, const GraphicsPipelineDescription& description,
+			VkShaderModule vertexShaderModule, VkShaderModule fragmentShaderModule);
+	};
+
+}
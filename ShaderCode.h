@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdint>
+
+namespace VkCourse {
+
+	// SPIR-V of every shader, embedded in the executable so creating the pipelines reads no files.
+	// The .inc files are compiled from the shader sources by the project's custom build step whenever a shader changes
+	// (Shaders/compile-shaders.sh does the same on Linux). inline so every translation unit shares one array, the
+	// shader module cache is keyed by their address.
+	namespace ShaderCode {
+		inline constexpr uint32_t SHADER_VERT[]{
+#include "Shaders/shader_vert.inc"
+		};
+
+		inline constexpr uint32_t SHADER_FRAG[]{
+#include "Shaders/shader_frag.inc"
+		};
+
+		inline constexpr uint32_t DEPTH_VERT[]{
+#include "Shaders/depth_vert.inc"
+		};
+
+		inline constexpr uint32_t SECOND_VERT[]{
+#include "Shaders/second_vert.inc"
+		};
+
+		inline constexpr uint32_t SECOND_FRAG[]{
+#include "Shaders/second_frag.inc"
+		};
+	}
+
+}
@@ -1,5 +1,6 @@
-C:\VulkanSDK\1.3.250.0\Bin\glslangValidator.exe -o shader_vert.spv -V shader.vert
-C:\VulkanSDK\1.3.250.0\Bin\glslangValidator.exe -o shader_frag.spv -V shader.frag
-C:\VulkanSDK\1.3.250.0\Bin\glslangValidator.exe -o second_vert.spv -V second.vert
-C:\VulkanSDK\1.3.250.0\Bin\glslangValidator.exe -o second_frag.spv -V second.frag
+C:\VulkanSDK\1.3.250.0\Bin\glslangValidator.exe -x -o shader_vert.inc -V shader.vert
+C:\VulkanSDK\1.3.250.0\Bin\glslangValidator.exe -x -o shader_frag.inc -V shader.frag
+C:\VulkanSDK\1.3.250.0\Bin\glslangValidator.exe -x -o depth_vert.inc -V depth.vert
+C:\VulkanSDK\1.3.250.0\Bin\glslangValidator.exe -x -o second_vert.inc -V second.vert
+C:\VulkanSDK\1.3.250.0\Bin\glslangValidator.exe -x -o second_frag.inc -V second.frag
 pause
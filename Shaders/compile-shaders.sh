@@ -0,0 +1,13 @@
+#!/bin/sh
+# Linux version of compile-shaders.bat: compiles the shaders into .inc files of SPIR-V words, which
+# ShaderCode.h embeds in the executable. Uses the glslangValidator of $VULKAN_SDK, or the one in PATH.
+set -e
+cd "$(dirname "$0")"
+
+GLSLANG="${VULKAN_SDK:+$VULKAN_SDK/bin/}glslangValidator"
+
+"$GLSLANG" -x -o shader_vert.inc -V shader.vert
+"$GLSLANG" -x -o shader_frag.inc -V shader.frag
+"$GLSLANG" -x -o depth_vert.inc -V depth.vert
+"$GLSLANG" -x -o second_vert.inc -V second.vert
+"$GLSLANG" -x -o second_frag.inc -V second.frag
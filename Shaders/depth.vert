@@ -0,0 +1,21 @@
+#version 450
+
+// Depth only variant of shader.vert, reads just the position stream (binding 0)
+
+layout(location = 0) in vec3 position;
+
+layout(set = 0, binding = 0) uniform UboViewProjection {
+	mat4 view;
+	mat4 projection;
+} uboViewProjection;
+
+layout(push_constant) uniform PushModel{
+	mat4 model;
+} pushModel;
+
+// Same depth as shader.vert, so that later passes can test against it with EQUAL
+invariant gl_Position;
+
+void main() {
+	gl_Position = uboViewProjection.projection * uboViewProjection.view * pushModel.model * vec4(position, 1.);
+}
@@ -3,17 +3,21 @@
 layout(input_attachment_index = 0, binding = 0) uniform subpassInput inputColor;
 layout(input_attachment_index = 1, binding = 1) uniform subpassInput inputDepth;
 
+layout(location = 0) in float screenX;		// 0 at the left edge of the framebuffer, 1 at the right edge
+
+// Set per pipeline variant (see CompositionConstants), so each variant is compiled with them as constants
+layout(constant_id = 0) const bool SHOW_DEPTH = true;			// Right of SPLIT shows the depth buffer
+layout(constant_id = 1) const float SPLIT = .5;				// Fraction of the width, the same variant fits every size
+layout(constant_id = 2) const float DEPTH_LOWER_BOUND = 0.98;	// Depth range spread over the visualization colors
+layout(constant_id = 3) const float DEPTH_UPPER_BOUND = 1.;
+
 layout(location = 0) out vec4 outColor;
 
 void main() {
-	int xHalf = 1200/2;
-	if(gl_FragCoord.x > xHalf)
+	if(SHOW_DEPTH && screenX > SPLIT)
 	{
-		float lowerBound = 0.98;
-		float higherBound = 1.;
-
 		float depth = subpassLoad(inputDepth).r;
-		float scaledDepth = 1. - ((depth - lowerBound)/(higherBound - lowerBound));
+		float scaledDepth = 1. - ((depth - DEPTH_LOWER_BOUND)/(DEPTH_UPPER_BOUND - DEPTH_LOWER_BOUND));
 		outColor = vec4(scaledDepth, 0., scaledDepth, 1.);
 	}
 	else{
@@ -9,6 +9,9 @@ vec2 positions[3] = vec2[](
 	vec2(-1.,  3.)
 );
 
+layout(location = 0) out float outScreenX;		// 0 at the left edge of the framebuffer, 1 at the right edge
+
 void main() {
 	gl_Position = vec4(positions[gl_VertexIndex], 0., 1.);
+	outScreenX = positions[gl_VertexIndex].x * .5 + .5;
 }
\ No newline at end of file
@@ -5,8 +5,17 @@ layout(location = 1) in vec2 texCoords;
 
 layout(set = 1, binding = 0) uniform sampler2D textureSampler;
 
+// Set per pipeline variant, untextured variants output the vertex color without sampling
+layout(constant_id = 0) const bool TEXTURED = true;
+
 layout(location = 0) out vec4 outColor;
 
 void main() {
-	outColor = texture(textureSampler, texCoords);
+	if(TEXTURED)
+	{
+		outColor = texture(textureSampler, texCoords);
+	}
+	else{
+		outColor = vec4(color, 1.);
+	}
 }
\ No newline at end of file
@@ -2,9 +2,9 @@
 
 //#extension GL_KHR_vulkan_glsl : enable
 
+// Quantized formats (see VertexFormat.h) are read as 0-1 and dequantized by the model matrix
 layout(location = 0) in vec3 position;
-layout(location = 1) in vec3 color;
-layout(location = 2) in vec2 texCoords;
+layout(location = 1) in vec2 texCoords;
 
 layout(set = 0, binding = 0) uniform UboViewProjection {
 	mat4 view;
@@ -23,8 +23,11 @@ layout(push_constant) uniform PushModel{
 layout(location = 0) out vec3 outColor;
 layout(location = 1) out vec2 outTexCoords;
 
+// Must match depth.vert exactly, for the depth tests against its output
+invariant gl_Position;
+
 void main() {
 	gl_Position = uboViewProjection.projection * uboViewProjection.view * pushModel.model * vec4(position, 1.);
-	outColor = color;
+	outColor = vec3(1.);		// Vertex colors are not imported
 	outTexCoords = texCoords;
 }
\ No newline at end of file
@@ -0,0 +1,83 @@
+#include "MappedIOSystem.h"
+
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <cstdlib>
+
+// Checks MappedIOStream against the fseek/fread semantics Assimp's readers rely on. Returns EXIT_FAILURE if any check fails.
+namespace {
+	int g_failureCount{};
+
+	void check(bool condition, const char* description)
+	{
+		if (!condition)
+		{
+			std::cout << "FAILED: " << description << std::endl;
+			++g_failureCount;
+		}
+	}
+
+	// Assimp passes negative offsets as size_t
+	size_t negative_offset(long offset)
+	{
+		return static_cast<size_t>(offset);
+	}
+}
+
+int main()
+{
+	const std::string fileName{ (std::filesystem::temp_directory_path() / "MappedIOSystemTests.txt").string() };
+	const std::string contents{ "0123456789" };
+	{
+		std::ofstream file(fileName, std::ios::binary | std::ios::trunc);
+		file << contents;
+	}
+
+	{
+		VkCourse::MappedIOSystem ioSystem{};
+		check(ioSystem.Exists(fileName.c_str()), "Exists finds the file");
+		check(ioSystem.Open(fileName.c_str(), "wb") == nullptr, "Open refuses to write");
+
+		std::unique_ptr<Assimp::IOStream> stream{ ioSystem.Open(fileName.c_str(), "rb") };
+		check(stream != nullptr, "Open maps the file");
+		if (stream != nullptr)
+		{
+			check(stream->FileSize() == contents.size(), "FileSize is the file size");
+
+			// SEEK_END with a negative offset
+			check(stream->Seek(negative_offset(-3), aiOrigin_END) == aiReturn_SUCCESS, "Seek 3 bytes before the end");
+			check(stream->Tell() == contents.size() - 3, "Tell after seeking from the end");
+			char tail[4]{};
+			check(stream->Read(tail, 1, 3) == 3 && std::string(tail) == "789", "Read the last 3 bytes");
+
+			check(stream->Seek(0, aiOrigin_END) == aiReturn_SUCCESS && stream->Tell() == contents.size(), "Seek to the end");
+			check(stream->Seek(negative_offset(-static_cast<long>(contents.size())), aiOrigin_END) == aiReturn_SUCCESS
+				&& stream->Tell() == 0, "Seek from the end to the start");
+			check(stream->Seek(negative_offset(-11), aiOrigin_END) != aiReturn_SUCCESS, "Seek before the start fails");
+			check(stream->Seek(1, aiOrigin_END) != aiReturn_SUCCESS, "Seek past the end fails");
+
+			// SEEK_CUR both ways and SEEK_SET
+			check(stream->Seek(4, aiOrigin_SET) == aiReturn_SUCCESS && stream->Tell() == 4, "Seek from the start");
+			check(stream->Seek(negative_offset(-2), aiOrigin_CUR) == aiReturn_SUCCESS && stream->Tell() == 2, "Seek backward from the current position");
+			check(stream->Seek(3, aiOrigin_CUR) == aiReturn_SUCCESS && stream->Tell() == 5, "Seek forward from the current position");
+
+			// Only whole elements, like fread
+			char elements[4]{};
+			check(stream->Read(elements, 2, 4) == 2 && stream->Tell() == 9, "Read stops at the last whole element");
+		}
+	}
+
+	std::filesystem::remove(fileName);
+
+	if (g_failureCount > 0)
+	{
+		std::cout << g_failureCount << " check(s) failed" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	std::cout << "All checks passed" << std::endl;
+	return EXIT_SUCCESS;
+}
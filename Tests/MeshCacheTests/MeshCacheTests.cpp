@@ -0,0 +1,131 @@
+#include "MeshCache.h"
+
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstdlib>
+
+// Checks that MeshCache entries are validated against the files the importer actually reads: the pack entries for
+// packed models and materials, the loose files otherwise. Returns EXIT_FAILURE if any check fails.
+namespace {
+	int g_failureCount{};
+
+	void check(bool condition, const char* description)
+	{
+		if (!condition)
+		{
+			std::cout << "FAILED: " << description << std::endl;
+			++g_failureCount;
+		}
+	}
+
+	void write_file(const std::string& fileName, const std::string& contents)
+	{
+		std::ofstream file(fileName, std::ios::binary | std::ios::trunc);
+		file << contents;
+	}
+
+	// A single triangle, the cache does not look into the streams
+	VkCourse::EncodedModelData make_model_data()
+	{
+		VkCourse::EncodedModelData modelData{};
+		modelData.textureNames = { "Textures/a.png" };
+		modelData.encodedData = {
+			std::vector<unsigned char>(36, 1),
+			{ 0, 0, 1, 0, 2, 0 },
+		};
+		modelData.meshes.push_back({
+			.vertexData = modelData.encodedData[0],
+			.attributeOffset = 24,
+			.vertexCount = 3,
+			.dequantization = glm::mat4(1.0f),
+			.boundingSphere = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f),
+			.indexData = modelData.encodedData[1],
+			.indexType = VK_INDEX_TYPE_UINT16,
+			.indexCount = 3,
+			.materialIndex = 0,
+		});
+		return modelData;
+	}
+
+	bool load(const VkCourse::MeshCache& meshCache, const VkCourse::AssetPack& assetPack, const std::string& modelFileName)
+	{
+		VkCourse::EncodedModelData modelData{};
+		return meshCache.load(assetPack, modelFileName, 0, VkCourse::VertexFormat::Packed, &modelData)
+			&& modelData.meshes.size() == 1 && modelData.meshes[0].indexCount == 3;
+	}
+}
+
+int main()
+{
+	const std::filesystem::path testDirectory{ std::filesystem::temp_directory_path() / "MeshCacheTests" };
+	std::filesystem::remove_all(testDirectory);
+	std::filesystem::create_directories(testDirectory / "Models");
+	const std::filesystem::path previousDirectory{ std::filesystem::current_path() };
+	std::filesystem::current_path(testDirectory);
+
+	const std::string modelFileName{ "Models/model.obj" };
+	const std::string materialFileName{ "Models/model.mtl" };
+	const std::vector<std::string> dependencyFileNames{ modelFileName, materialFileName };
+	const VkCourse::EncodedModelData modelData{ make_model_data() };
+	const VkCourse::MeshCache meshCache{ "Cache" };
+
+	// Loose files only
+	write_file(modelFileName, "v 0 0 0");
+	write_file(materialFileName, "newmtl a");
+	{
+		const VkCourse::AssetPack noPack{};
+		check(meshCache.store(noPack, modelFileName, 0, VkCourse::VertexFormat::Packed, dependencyFileNames, modelData),
+			"Store a loose model");
+		check(load(meshCache, noPack, modelFileName), "Load a loose model");
+
+		write_file(materialFileName, "newmtl ab");
+		check(!load(meshCache, noPack, modelFileName), "Editing a loose material invalidates the entry");
+	}
+
+	// Packed files, with different loose files of the same names next to them
+	write_file("model.obj", "v 1 1 1");
+	write_file("model.mtl", "newmtl packed");
+	check(VkCourse::AssetPack::write("Assets1.pack", {
+		{ .name = modelFileName, .filePath = "model.obj" },
+		{ .name = materialFileName, .filePath = "model.mtl" },
+	}) > 0, "Write the first pack");
+	{
+		VkCourse::AssetPack assetPack{};
+		check(assetPack.open("Assets1.pack"), "Open the first pack");
+		check(!load(meshCache, assetPack, modelFileName), "A loose entry is not valid for the packed model");
+		check(meshCache.store(assetPack, modelFileName, 0, VkCourse::VertexFormat::Packed, dependencyFileNames, modelData),
+			"Store a packed model");
+		check(load(meshCache, assetPack, modelFileName), "Load a packed model");
+
+		write_file(modelFileName, "v 2 2 2 2");
+		write_file(materialFileName, "newmtl abc");
+		check(load(meshCache, assetPack, modelFileName), "Editing the loose files keeps the packed entry");
+	}
+
+	// Same model, packed with another material
+	write_file("model.mtl", "newmtl repacked");
+	check(VkCourse::AssetPack::write("Assets2.pack", {
+		{ .name = modelFileName, .filePath = "model.obj" },
+		{ .name = materialFileName, .filePath = "model.mtl" },
+	}) > 0, "Write the second pack");
+	{
+		VkCourse::AssetPack assetPack{};
+		check(assetPack.open("Assets2.pack"), "Open the second pack");
+		check(!load(meshCache, assetPack, modelFileName), "Repacking the material invalidates the entry");
+	}
+
+	std::filesystem::current_path(previousDirectory);
+	std::filesystem::remove_all(testDirectory);
+
+	if (g_failureCount > 0)
+	{
+		std::cout << g_failureCount << " check(s) failed" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	std::cout << "All checks passed" << std::endl;
+	return EXIT_SUCCESS;
+}
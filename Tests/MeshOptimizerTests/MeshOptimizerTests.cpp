@@ -0,0 +1,145 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <array>
+#include <iostream>
+#include <random>
+#include <vector>
+#include <cstdlib>
+
+// Checks that the import time reordering of MeshOptimizer keeps every triangle, with its winding, and does not
+// make the vertex cache use worse. Returns EXIT_FAILURE if any check fails.
+namespace {
+	int g_failureCount{};
+
+	void check(bool condition, const char* description)
+	{
+		if (!condition)
+		{
+			std::cout << "FAILED: " << description << std::endl;
+			++g_failureCount;
+		}
+	}
+
+	// Grid of gridSize x gridSize quads, triangles shuffled so the cache optimization has work to do
+	VkCourse::MeshData make_grid_mesh(uint32_t gridSize)
+	{
+		VkCourse::MeshData meshData{ .materialIndex = 0 };
+		for (uint32_t y = 0; y <= gridSize; ++y)
+		{
+			for (uint32_t x = 0; x <= gridSize; ++x)
+			{
+				// Slightly curved, so the overdraw clusters face different directions
+				const float fx{ static_cast<float>(x) };
+				const float fy{ static_cast<float>(y) };
+				meshData.vertices.push_back({ .position = { fx, fy, 0.01f * (fx * fx + fy * fy) }, .texCoords = { fx, fy } });
+			}
+		}
+
+		std::vector<std::array<uint32_t, 3>> triangles{};
+		for (uint32_t y = 0; y < gridSize; ++y)
+		{
+			for (uint32_t x = 0; x < gridSize; ++x)
+			{
+				const uint32_t corner{ y * (gridSize + 1) + x };
+				triangles.push_back({ corner, corner + 1, corner + gridSize + 1 });
+				triangles.push_back({ corner + 1, corner + gridSize + 2, corner + gridSize + 1 });
+			}
+		}
+
+		std::mt19937 random{ 42 };
+		std::shuffle(triangles.begin(), triangles.end(), random);
+		for (const auto& triangle : triangles)
+		{
+			meshData.indices.insert(meshData.indices.end(), triangle.begin(), triangle.end());
+		}
+		return meshData;
+	}
+
+	// Triangles by the positions of their corners, rotated to start with the smallest one so that the winding
+	// is kept but not the first corner
+	std::vector<std::array<float, 9>> get_triangles(const VkCourse::MeshData& meshData)
+	{
+		std::vector<std::array<float, 9>> triangles{};
+		for (size_t i = 0; i + 2 < meshData.indices.size(); i += 3)
+		{
+			std::array<std::array<float, 3>, 3> corners{};
+			for (size_t c = 0; c < 3; ++c)
+			{
+				const glm::vec3& position{ meshData.vertices[meshData.indices[i + c]].position };
+				corners[c] = { position.x, position.y, position.z };
+			}
+			std::rotate(corners.begin(), std::min_element(corners.begin(), corners.end()), corners.end());
+
+			std::array<float, 9> triangle{};
+			for (size_t c = 0; c < 3; ++c)
+			{
+				std::copy(corners[c].begin(), corners[c].end(), triangle.begin() + c * 3);
+			}
+			triangles.push_back(triangle);
+		}
+		std::sort(triangles.begin(), triangles.end());
+		return triangles;
+	}
+
+	bool indices_in_range(const VkCourse::MeshData& meshData)
+	{
+		return std::all_of(meshData.indices.begin(), meshData.indices.end(),
+			[&meshData](uint32_t index) { return index < meshData.vertices.size(); });
+	}
+}
+
+int main()
+{
+	constexpr uint32_t GRID_SIZE{ 24 };
+	constexpr uint32_t CACHE_SIZE{ 16 };
+
+	// Vertex cache order alone
+	{
+		VkCourse::MeshData meshData{ make_grid_mesh(GRID_SIZE) };
+		const auto triangles{ get_triangles(meshData) };
+		const VkCourse::VertexCacheStats before{ VkCourse::analyze_vertex_cache(meshData.indices, meshData.vertices.size(), CACHE_SIZE) };
+
+		VkCourse::optimize_vertex_cache(meshData.indices, meshData.vertices.size());
+		check(meshData.indices.size() == triangles.size() * 3, "Vertex cache order keeps the index count");
+		check(indices_in_range(meshData), "Vertex cache order keeps the indices in range");
+		check(get_triangles(meshData) == triangles, "Vertex cache order keeps every triangle and its winding");
+
+		const VkCourse::VertexCacheStats after{ VkCourse::analyze_vertex_cache(meshData.indices, meshData.vertices.size(), CACHE_SIZE) };
+		check(after.acmr < before.acmr, "Vertex cache order lowers the ACMR of a shuffled mesh");
+	}
+
+	// Every step, vertices reordered too
+	{
+		VkCourse::MeshData meshData{ make_grid_mesh(GRID_SIZE) };
+		const auto triangles{ get_triangles(meshData) };
+
+		const VkCourse::MeshOptimizeOptions options{};
+		const VkCourse::MeshOptimizeStats stats{ VkCourse::optimize_mesh(&meshData, options) };
+		check(indices_in_range(meshData), "Optimized indices in range");
+		check(meshData.vertices.size() == (GRID_SIZE + 1) * (GRID_SIZE + 1), "Every referenced vertex kept");
+		check(get_triangles(meshData) == triangles, "Optimization keeps every triangle and its winding");
+		check(stats.after.acmr <= stats.before.acmr, "Optimization does not raise the ACMR");
+		check(stats.after.acmr <= stats.before.acmr * options.overdrawThreshold, "Overdraw order within its ACMR threshold");
+	}
+
+	// Unreferenced vertices are dropped by the fetch order
+	{
+		VkCourse::MeshData meshData{ make_grid_mesh(2) };
+		meshData.vertices.push_back({ .position = { 100.f, 100.f, 100.f }, .texCoords = {} });
+		const auto triangles{ get_triangles(meshData) };
+
+		VkCourse::optimize_vertex_fetch(meshData.vertices, meshData.indices);
+		check(meshData.vertices.size() == 9, "Unreferenced vertex removed");
+		check(get_triangles(meshData) == triangles, "Fetch order keeps every triangle");
+	}
+
+	if (g_failureCount > 0)
+	{
+		std::cout << g_failureCount << " check(s) failed" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	std::cout << "All checks passed" << std::endl;
+	return EXIT_SUCCESS;
+}
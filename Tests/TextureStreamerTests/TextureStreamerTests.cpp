@@ -0,0 +1,153 @@
+#include "TextureStreamer.h"
+
+#include <algorithm>
+#include <iostream>
+#include <vector>
+#include <cstdlib>
+
+// Checks the residency policy of TextureStreamer: the budget, the least recently used eviction order and the
+// fallback to a less detailed level when the requested one doesn't fit. Returns EXIT_FAILURE if any check fails.
+namespace {
+	int g_failureCount{};
+
+	void check(bool condition, const char* description)
+	{
+		if (!condition)
+		{
+			std::cout << "FAILED: " << description << std::endl;
+			++g_failureCount;
+		}
+	}
+
+	// 256x256, one byte per texel
+	constexpr uint32_t TEXTURE_SIZE{ 256 };
+	const std::vector<uint64_t> LEVEL_SIZES{ 65536, 16384, 4096, 1024, 256, 64, 16, 4, 1 };
+
+	uint64_t get_chain_size(uint32_t firstLevel)
+	{
+		uint64_t size{};
+		for (size_t level = firstLevel; level < LEVEL_SIZES.size(); ++level)
+		{
+			size += LEVEL_SIZES[level];
+		}
+		return size;
+	}
+
+	// Projected size that requests the given level
+	float get_projected_size(uint32_t level)
+	{
+		return static_cast<float>(TEXTURE_SIZE >> level);
+	}
+
+	const VkCourse::TextureResidencyChange* find_change(const std::vector<VkCourse::TextureResidencyChange>& changes, size_t textureId)
+	{
+		auto change{ std::find_if(changes.begin(), changes.end(),
+			[textureId](const VkCourse::TextureResidencyChange& change) { return change.textureId == textureId; }) };
+		return change != changes.end() ? &*change : nullptr;
+	}
+
+	bool has_change(const std::vector<VkCourse::TextureResidencyChange>& changes, size_t textureId, uint32_t firstLevel)
+	{
+		const VkCourse::TextureResidencyChange* change{ find_change(changes, textureId) };
+		return change != nullptr && change->firstLevel == firstLevel;
+	}
+}
+
+int main()
+{
+	constexpr uint32_t INITIAL_LEVEL{ 2 };		// 64x64 with initialSize 64
+	const uint32_t levelCount{ static_cast<uint32_t>(LEVEL_SIZES.size()) };
+
+	// Initial level
+	{
+		VkCourse::TextureStreamer streamer{};
+		streamer.set_options({ .budget = 1ull << 20, .initialSize = 64, .maxChangesPerFrame = 4 });
+		check(streamer.get_initial_level(TEXTURE_SIZE, TEXTURE_SIZE, levelCount) == INITIAL_LEVEL, "Initial level no larger than initialSize");
+		check(streamer.get_initial_level(TEXTURE_SIZE, TEXTURE_SIZE, 2) == 1, "Initial level within the level count");
+		check(streamer.get_initial_level(32, 16, 6) == 0, "Small textures start fully resident");
+	}
+
+	// Budget and fallback: only level 1 of the two fits
+	{
+		VkCourse::TextureStreamer streamer{};
+		const uint64_t budget{ get_chain_size(1) + get_chain_size(INITIAL_LEVEL) };
+		streamer.set_options({ .budget = budget, .initialSize = 64, .maxChangesPerFrame = 4 });
+		streamer.add_texture(0, TEXTURE_SIZE, TEXTURE_SIZE, LEVEL_SIZES, INITIAL_LEVEL, true);
+		streamer.add_texture(1, TEXTURE_SIZE, TEXTURE_SIZE, LEVEL_SIZES, INITIAL_LEVEL, true);
+		check(streamer.get_resident_size() == 2 * get_chain_size(INITIAL_LEVEL), "Textures start at their initial level");
+
+		streamer.request_size(0, get_projected_size(0));
+		streamer.request_size(1, get_projected_size(INITIAL_LEVEL));
+		const auto changes{ streamer.update() };
+		check(changes.size() == 1 && has_change(changes, 0, 1), "Falls back to the most detailed level that fits");
+		check(streamer.get_resident_size() <= budget, "Upgrades stay within the budget");
+
+		// Nothing to evict, the used texture keeps its level
+		streamer.request_size(0, get_projected_size(0));
+		streamer.request_size(1, get_projected_size(INITIAL_LEVEL));
+		check(streamer.update().empty(), "No change while the budget is full");
+	}
+
+	// LRU: the least recently used texture is evicted first
+	{
+		VkCourse::TextureStreamer streamer{};
+		const uint64_t budget{ 2 * get_chain_size(1) + get_chain_size(INITIAL_LEVEL) };
+		streamer.set_options({ .budget = budget, .initialSize = 64, .maxChangesPerFrame = 4 });
+		for (size_t textureId = 0; textureId < 3; ++textureId)
+		{
+			streamer.add_texture(textureId, TEXTURE_SIZE, TEXTURE_SIZE, LEVEL_SIZES, INITIAL_LEVEL, true);
+		}
+
+		streamer.request_size(0, get_projected_size(1));
+		check(has_change(streamer.update(), 0, 1), "First texture upgraded");
+		streamer.request_size(1, get_projected_size(1));
+		check(has_change(streamer.update(), 1, 1), "Second texture upgraded");
+
+		streamer.request_size(2, get_projected_size(1));
+		const auto changes{ streamer.update() };
+		check(has_change(changes, 2, 1), "Third texture upgraded after an eviction");
+		check(has_change(changes, 0, INITIAL_LEVEL), "Least recently used texture back to its initial level");
+		check(find_change(changes, 1) == nullptr, "More recently used texture kept");
+		check(streamer.get_resident_size() <= budget, "Evictions keep the budget");
+	}
+
+	// Lowered budget, textures that are not streamed count but are never changed
+	{
+		VkCourse::TextureStreamer streamer{};
+		streamer.set_options({ .budget = 1ull << 20, .initialSize = 64, .maxChangesPerFrame = 4 });
+		streamer.add_texture(0, TEXTURE_SIZE, TEXTURE_SIZE, LEVEL_SIZES, 0, false);
+		streamer.add_texture(1, TEXTURE_SIZE, TEXTURE_SIZE, LEVEL_SIZES, INITIAL_LEVEL, true);
+		streamer.request_size(1, get_projected_size(0));
+		check(has_change(streamer.update(), 1, 0), "Streamed texture fully resident within a large budget");
+
+		const uint64_t budget{ get_chain_size(0) + get_chain_size(INITIAL_LEVEL) };
+		streamer.set_options({ .budget = budget, .initialSize = 64, .maxChangesPerFrame = 4 });
+		const auto changes{ streamer.update() };
+		check(changes.size() == 1 && has_change(changes, 1, INITIAL_LEVEL), "Lowered budget evicts the streamed texture only");
+		check(streamer.get_resident_size() == budget, "Resident size after the eviction");
+
+		streamer.remove_texture(1);
+		check(streamer.get_resident_size() == get_chain_size(0), "Removed textures no longer count");
+	}
+
+	// Changes per frame, the textures furthest from their requested level first
+	{
+		VkCourse::TextureStreamer streamer{};
+		streamer.set_options({ .budget = 1ull << 20, .initialSize = 64, .maxChangesPerFrame = 1 });
+		streamer.add_texture(0, TEXTURE_SIZE, TEXTURE_SIZE, LEVEL_SIZES, INITIAL_LEVEL, true);
+		streamer.add_texture(1, TEXTURE_SIZE, TEXTURE_SIZE, LEVEL_SIZES, INITIAL_LEVEL, true);
+		streamer.request_size(0, get_projected_size(1));
+		streamer.request_size(1, get_projected_size(0));
+		const auto changes{ streamer.update() };
+		check(changes.size() == 1 && has_change(changes, 1, 0), "One change per frame, largest gap first");
+	}
+
+	if (g_failureCount > 0)
+	{
+		std::cout << g_failureCount << " check(s) failed" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	std::cout << "All checks passed" << std::endl;
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,152 @@
+#include "VertexFormat.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <vector>
+#include <cstdlib>
+
+// Checks the encodings of the compact vertex format: float_to_half rounding and the round trip tolerances of the
+// half texture coordinates and of the positions quantized in the mesh bounding box. Returns EXIT_FAILURE if any
+// check fails.
+namespace {
+	int g_failureCount{};
+
+	void check(bool condition, const char* description)
+	{
+		if (!condition)
+		{
+			std::cout << "FAILED: " << description << std::endl;
+			++g_failureCount;
+		}
+	}
+
+	// What the GPU reads back (R16_SFLOAT), for finite values
+	float half_to_float(uint16_t half)
+	{
+		const float sign{ (half & 0x8000) != 0 ? -1.f : 1.f };
+		const int exponent{ (half >> 10) & 0x1f };
+		const int mantissa{ half & 0x3ff };
+		if (exponent == 0)
+		{
+			return sign * std::ldexp(static_cast<float>(mantissa), -24);
+		}
+		return sign * std::ldexp(static_cast<float>(mantissa | 0x400), exponent - 25);
+	}
+
+	// Must match PackedPosition and PackedAttributes in VertexFormat.cpp
+	struct PackedVertex {
+		uint16_t position[4];
+		uint16_t texCoords[2];
+	};
+
+	PackedVertex read_packed_vertex(const VkCourse::VertexStreams& vertexStreams, size_t index)
+	{
+		PackedVertex vertex{};
+		memcpy(vertex.position, vertexStreams.data.data() + index * sizeof(vertex.position), sizeof(vertex.position));
+		memcpy(vertex.texCoords, vertexStreams.data.data() + vertexStreams.attributeOffset + index * sizeof(vertex.texCoords),
+			sizeof(vertex.texCoords));
+		return vertex;
+	}
+}
+
+int main()
+{
+	// Exact values and rounding
+	check(VkCourse::float_to_half(0.f) == 0x0000, "Zero");
+	check(VkCourse::float_to_half(-0.f) == 0x8000, "Negative zero");
+	check(VkCourse::float_to_half(1.f) == 0x3c00, "One");
+	check(VkCourse::float_to_half(-2.f) == 0xc000, "Minus two");
+	check(VkCourse::float_to_half(0.5f) == 0x3800, "One half");
+	check(VkCourse::float_to_half(65504.f) == 0x7bff, "Largest half");
+	check(VkCourse::float_to_half(65520.f) == 0x7c00, "Rounds up to infinity past the largest half");
+	check(VkCourse::float_to_half(std::numeric_limits<float>::infinity()) == 0x7c00, "Infinity");
+	check((VkCourse::float_to_half(std::numeric_limits<float>::quiet_NaN()) & 0x7fff) > 0x7c00, "NaN stays NaN");
+	check(VkCourse::float_to_half(std::ldexp(1.f, -24)) == 0x0001, "Smallest subnormal");
+	check(VkCourse::float_to_half(std::ldexp(1.f, -26)) == 0x0000, "Underflows to zero");
+	check(VkCourse::float_to_half(1.f + std::ldexp(1.f, -11)) == 0x3c00, "Halfway rounds to even (down)");
+	check(VkCourse::float_to_half(1.f + 3.f * std::ldexp(1.f, -11)) == 0x3c02, "Halfway rounds to even (up)");
+	check(VkCourse::float_to_half(1.f + std::ldexp(1.f, -11) + std::ldexp(1.f, -20)) == 0x3c01, "Above halfway rounds up");
+
+	// Texture coordinates within half a unit in the last place (2^-11 relative) for normal values
+	bool texCoordsInTolerance{ true };
+	for (int i = -4096; i <= 4096; ++i)
+	{
+		const float value{ i / 1024.f + 0.000123f };
+		const float roundTrip{ half_to_float(VkCourse::float_to_half(value)) };
+		if (std::abs(roundTrip - value) > std::abs(value) * std::ldexp(1.f, -11))
+		{
+			texCoordsInTolerance = false;
+		}
+	}
+	check(texCoordsInTolerance, "Half round trip within half a unit in the last place");
+
+	// Positions quantized in the bounding box, within half a step of 1/65535 of its extent on each axis
+	const std::vector<VkCourse::Vertex> vertices{
+		{ .position = { -3.f, 10.f, 0.25f }, .texCoords = { 0.f, 1.f } },
+		{ .position = { 5.5f, -2.f, 0.25f }, .texCoords = { 0.333f, 0.667f } },
+		{ .position = { 0.1234f, 4.321f, 0.25f }, .texCoords = { 1.f, 0.f } },
+		{ .position = { 1.f, 1.f, 0.25f }, .texCoords = { 2.5f, -1.5f } },
+	};
+	const VkCourse::VertexStreams packed{ VkCourse::encode_vertices(vertices, VkCourse::VertexFormat::Packed) };
+	check(packed.attributeOffset >= vertices.size() * 8 && packed.data.size() == packed.attributeOffset + vertices.size() * 4,
+		"Packed stream sizes");
+
+	const glm::vec3 extent{ 8.5f, 12.f, 0.f };
+	bool positionsInTolerance{ true };
+	bool packedTexCoordsInTolerance{ true };
+	for (size_t i = 0; i < vertices.size(); ++i)
+	{
+		const PackedVertex vertex{ read_packed_vertex(packed, i) };
+		const glm::vec4 normalized{ vertex.position[0] / 65535.f, vertex.position[1] / 65535.f, vertex.position[2] / 65535.f,
+			vertex.position[3] / 65535.f };
+		const glm::vec4 position{ packed.dequantization * normalized };
+		for (int c = 0; c < 3; ++c)
+		{
+			const float tolerance{ extent[c] / 65535.f * 0.5f + 1e-5f };
+			if (std::abs(position[c] - vertices[i].position[c]) > tolerance)
+			{
+				positionsInTolerance = false;
+			}
+		}
+		if (std::abs(position.w - 1.f) > 1e-6f)
+		{
+			positionsInTolerance = false;
+		}
+
+		for (int c = 0; c < 2; ++c)
+		{
+			const float value{ vertices[i].texCoords[c] };
+			if (std::abs(half_to_float(vertex.texCoords[c]) - value) > std::abs(value) * std::ldexp(1.f, -11))
+			{
+				packedTexCoordsInTolerance = false;
+			}
+		}
+	}
+	check(positionsInTolerance, "Packed positions within half a quantization step, flat axis exact");
+	check(packedTexCoordsInTolerance, "Packed texture coordinates within the half tolerance");
+
+	// Float format is lossless
+	const VkCourse::VertexStreams floats{ VkCourse::encode_vertices(vertices, VkCourse::VertexFormat::Float) };
+	bool floatsExact{ floats.dequantization == glm::mat4(1.f) };
+	for (size_t i = 0; i < vertices.size(); ++i)
+	{
+		glm::vec3 position;
+		glm::vec2 texCoords;
+		memcpy(&position, floats.data.data() + i * sizeof(glm::vec3), sizeof(position));
+		memcpy(&texCoords, floats.data.data() + floats.attributeOffset + i * sizeof(glm::vec2), sizeof(texCoords));
+		floatsExact = floatsExact && position == vertices[i].position && texCoords == vertices[i].texCoords;
+	}
+	check(floatsExact, "Float format round trip is exact");
+
+	if (g_failureCount > 0)
+	{
+		std::cout << g_failureCount << " check(s) failed" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	std::cout << "All checks passed" << std::endl;
+	return EXIT_SUCCESS;
+}
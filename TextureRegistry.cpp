@@ -0,0 +1,176 @@
+#include "TextureRegistry.h"
+#include "MappedFile.h"
+
+#include <cstring>
+
+namespace VkCourse {
+
+	TextureRegistry::TextureRegistry()
+	{
+	}
+
+	TextureRegistry::~TextureRegistry()
+	{
+	}
+
+	TextureRegistry::TextureKey TextureRegistry::get_key(const std::string& filePath)
+	{
+		std::error_code error;
+		std::filesystem::path resolvedPath{ std::filesystem::weakly_canonical(filePath, error) };
+		if (error)
+		{
+			resolvedPath = std::filesystem::absolute(filePath);
+		}
+
+		TextureKey key{
+			.filePath = filePath,
+			.resolvedPath = resolvedPath.string(),
+			.size = 0,
+			.contentHash = 0,
+		};
+
+		const uint64_t size{ std::filesystem::file_size(resolvedPath, error) };
+		if (error)
+		{
+			return key;		// Missing file, reported when the texture is loaded
+		}
+		const auto modifiedTime{ std::filesystem::last_write_time(resolvedPath, error) };
+		if (error)
+		{
+			return key;
+		}
+
+		key.size = size;
+		auto stamp{ m_fileStamps.find(key.resolvedPath) };
+		if (stamp != m_fileStamps.end() && stamp->second.size == size && stamp->second.modifiedTime == modifiedTime)
+		{
+			key.contentHash = stamp->second.contentHash;
+			return key;
+		}
+
+		key.contentHash = hash_file(key.resolvedPath);
+		m_fileStamps[key.resolvedPath] = {
+			.size = size,
+			.modifiedTime = modifiedTime,
+			.contentHash = key.contentHash,
+		};
+
+		return key;
+	}
+
+	TextureRegistry::TextureKey TextureRegistry::get_key(const AssetPack& assetPack, const std::string& filePath)
+	{
+		const AssetPack::AssetPackEntry* entry{ assetPack.find(filePath) };
+		if (entry == nullptr)
+		{
+			return get_key(filePath);
+		}
+
+		// The pack index already holds the content hash
+		return {
+			.filePath = filePath,
+			.resolvedPath = AssetPack::normalize_name(filePath),
+			.size = entry->dataSize,
+			.contentHash = entry->contentHash,
+		};
+	}
+
+	bool TextureRegistry::acquire(const AssetPack& assetPack, const TextureKey& key, size_t* textureId)
+	{
+		if (key.contentHash == 0)
+		{
+			return false;
+		}
+
+		auto [contentTexture, contentTexturesEnd] { m_contentTextures.equal_range(key.contentHash) };
+		for (; contentTexture != contentTexturesEnd; ++contentTexture)
+		{
+			TextureEntry& texture{ m_textures[contentTexture->second] };
+			if (has_same_content(assetPack, key, texture.key))
+			{
+				++texture.referenceCount;
+				*textureId = contentTexture->second;
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	void TextureRegistry::insert(const TextureKey& key, size_t textureId, size_t referenceCount)
+	{
+		m_textures[textureId] = {
+			.key = key,
+			.referenceCount = referenceCount,
+		};
+
+		// Unreadable files can't be matched by content, so they are never shared
+		if (key.contentHash != 0)
+		{
+			m_contentTextures.emplace(key.contentHash, textureId);
+		}
+	}
+
+	bool TextureRegistry::release(size_t textureId)
+	{
+		auto texture{ m_textures.find(textureId) };
+		if (texture == m_textures.end())
+		{
+			return false;
+		}
+
+		if (texture->second.referenceCount > 1)
+		{
+			--texture->second.referenceCount;
+			return false;
+		}
+
+		auto [contentTexture, contentTexturesEnd] { m_contentTextures.equal_range(texture->second.key.contentHash) };
+		for (; contentTexture != contentTexturesEnd; ++contentTexture)
+		{
+			if (contentTexture->second == textureId)
+			{
+				m_contentTextures.erase(contentTexture);
+				break;
+			}
+		}
+		m_textures.erase(texture);
+		return true;
+	}
+
+	bool TextureRegistry::has_same_content(const AssetPack& assetPack, const TextureKey& key, const TextureKey& otherKey)
+	{
+		if (key.contentHash == 0 || key.contentHash != otherKey.contentHash || key.size != otherKey.size)
+		{
+			return false;
+		}
+
+		// The same file, hashed again only when its stamp changed
+		if (key.resolvedPath == otherKey.resolvedPath)
+		{
+			return true;
+		}
+
+		AssetFile file{};
+		AssetFile otherFile{};
+		if (!assetPack.open_asset(key.filePath, &file) || !assetPack.open_asset(otherKey.filePath, &otherFile)
+			|| file.size() != otherFile.size())
+		{
+			return false;
+		}
+
+		return file.size() == 0 || memcmp(file.data(), otherFile.data(), file.size()) == 0;
+	}
+
+	uint64_t TextureRegistry::hash_file(const std::string& filePath)
+	{
+		MappedFile file{};
+		if (!file.open(filePath, MappedFileAccess::Sequential))
+		{
+			return 0;
+		}
+
+		return hash_asset_content(file.span());
+	}
+
+}
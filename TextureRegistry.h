@@ -0,0 +1,66 @@
+#pragma once
+#include "AssetPack.h"
+
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+#include <cstdint>
+
+namespace VkCourse {
+
+	// Tracks which texture files are already loaded, so that every material (of any model) referencing
+	// the same image shares one texture. Textures are identified by the hash of the file content, so copies
+	// of a file under another name are shared as well (once their bytes compare equal, the hash alone could
+	// collide). The registry only counts references, the renderer owns the Vulkan objects behind each texture id.
+	class TextureRegistry
+	{
+	public:
+		struct TextureKey {
+			std::string filePath;		// As given, to open it through the asset pack
+			std::string resolvedPath;	// Canonical path of the file (pack name for packed files)
+			uint64_t size;
+			uint64_t contentHash;		// Of the file content and size, 0 if the file can't be read
+		};
+
+		TextureRegistry();
+
+		~TextureRegistry();
+
+		// Content is only hashed again if the file size or modification time changed
+		TextureKey get_key(const std::string& filePath);
+
+		// Key of the packed file if the pack has it, of the loose file otherwise
+		TextureKey get_key(const AssetPack& assetPack, const std::string& filePath);
+
+		// If a texture with the same content is registered, adds a reference to it and returns true
+		bool acquire(const AssetPack& assetPack, const TextureKey& key, size_t* textureId);
+
+		// Registers a newly loaded texture, already used referenceCount times
+		void insert(const TextureKey& key, size_t textureId, size_t referenceCount);
+
+		// Returns true if that was the last reference, the texture is then no longer registered
+		bool release(size_t textureId);
+
+		// Same size and bytes, only compared when the hashes match
+		static bool has_same_content(const AssetPack& assetPack, const TextureKey& key, const TextureKey& otherKey);
+
+	private:
+		struct FileStamp {
+			uint64_t size;
+			std::filesystem::file_time_type modifiedTime;
+			uint64_t contentHash;
+		};
+
+		struct TextureEntry {
+			TextureKey key;
+			size_t referenceCount;
+		};
+
+		std::unordered_map<std::string, FileStamp> m_fileStamps{};		// By resolved path
+		std::unordered_multimap<uint64_t, size_t> m_contentTextures{};	// Content hash to texture ids (hashes can collide)
+		std::unordered_map<size_t, TextureEntry> m_textures{};			// By texture id
+
+		static uint64_t hash_file(const std::string& filePath);
+	};
+
+}
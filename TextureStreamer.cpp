@@ -0,0 +1,232 @@
+#include "TextureStreamer.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace VkCourse {
+
+	TextureStreamer::TextureStreamer()
+	{
+	}
+
+	TextureStreamer::~TextureStreamer()
+	{
+	}
+
+	void TextureStreamer::set_options(const TextureStreamingOptions& options)
+	{
+		m_options = options;
+	}
+
+	const TextureStreamingOptions& TextureStreamer::get_options() const
+	{
+		return m_options;
+	}
+
+	uint32_t TextureStreamer::get_initial_level(uint32_t width, uint32_t height, uint32_t levelCount) const
+	{
+		uint32_t level{ 0 };
+		while (level + 1 < levelCount && std::max(width >> level, height >> level) > m_options.initialSize)
+		{
+			++level;
+		}
+		return level;
+	}
+
+	void TextureStreamer::add_texture(size_t textureId, uint32_t width, uint32_t height, const std::vector<uint64_t>& levelSizes, 
+		uint32_t firstLevel, bool streamed)
+	{
+		remove_texture(textureId);
+
+		StreamedTexture texture{
+			.width = width,
+			.height = height,
+			.levelSizes = levelSizes,
+			.initialLevel = firstLevel,
+			.firstLevel = firstLevel,
+			.requestedLevel = UINT32_MAX,
+			.lastUsedFrame = m_frame,
+			.streamed = streamed,
+		};
+
+		m_residentSize += get_chain_size(texture, firstLevel);
+		m_textures.emplace(textureId, std::move(texture));
+	}
+
+	void TextureStreamer::remove_texture(size_t textureId)
+	{
+		auto texture{ m_textures.find(textureId) };
+		if (texture == m_textures.end())
+		{
+			return;
+		}
+
+		m_residentSize -= get_chain_size(texture->second, texture->second.firstLevel);
+		m_textures.erase(texture);
+	}
+
+	void TextureStreamer::request_size(size_t textureId, float projectedSize)
+	{
+		auto texture{ m_textures.find(textureId) };
+		if (texture == m_textures.end())
+		{
+			return;
+		}
+
+		StreamedTexture& streamedTexture{ texture->second };
+		const uint32_t lastLevel{ static_cast<uint32_t>(streamedTexture.levelSizes.size()) - 1 };
+
+		// One texel per pixel: each level halves the size
+		const float textureSize{ static_cast<float>(std::max(streamedTexture.width, streamedTexture.height)) };
+		uint32_t level{ lastLevel };
+		if (projectedSize >= textureSize)
+		{
+			level = 0;
+		}
+		else if (projectedSize > 0.f)
+		{
+			level = std::min(lastLevel, static_cast<uint32_t>(std::log2(textureSize / projectedSize)));
+		}
+
+		streamedTexture.requestedLevel = std::min(streamedTexture.requestedLevel, level);
+		streamedTexture.lastUsedFrame = m_frame;
+	}
+
+	std::vector<TextureResidencyChange> TextureStreamer::update()
+	{
+		std::vector<TextureResidencyChange> changes{};
+
+		// Upgrades, the textures furthest from the level they need first
+		std::vector<std::pair<uint32_t, size_t>> upgrades{};
+		for (const auto& [textureId, texture] : m_textures)
+		{
+			if (texture.streamed && texture.requestedLevel < texture.firstLevel)
+			{
+				upgrades.push_back({ texture.firstLevel - texture.requestedLevel, textureId });
+			}
+		}
+		std::sort(upgrades.begin(), upgrades.end(), [](const auto& a, const auto& b) {
+			return a.first != b.first ? a.first > b.first : a.second < b.second;
+		});
+
+		for (const auto& [gap, textureId] : upgrades)
+		{
+			if (changes.size() >= m_options.maxChangesPerFrame)
+			{
+				break;
+			}
+
+			// Settle for a less detailed level if the requested one doesn't fit, even after evictions
+			StreamedTexture& texture{ m_textures[textureId] };
+			const uint64_t residentSize{ get_chain_size(texture, texture.firstLevel) };
+			uint32_t level{ texture.requestedLevel };
+			for (; level < texture.firstLevel; ++level)
+			{
+				const uint64_t newSize{ m_residentSize + get_chain_size(texture, level) - residentSize };
+				if (newSize <= m_options.budget || evict(newSize - m_options.budget, false, &changes))
+				{
+					break;
+				}
+			}
+
+			if (level < texture.firstLevel)
+			{
+				m_residentSize += get_chain_size(texture, level) - residentSize;
+				texture.firstLevel = level;
+				changes.push_back({ textureId, level });
+			}
+		}
+
+		// Budget lowered, or textures that are not streamed added since the last frame
+		if (m_residentSize > m_options.budget)
+		{
+			evict(m_residentSize - m_options.budget, true, &changes);
+		}
+
+		for (auto& [textureId, texture] : m_textures)
+		{
+			texture.requestedLevel = UINT32_MAX;
+		}
+		++m_frame;
+
+		return changes;
+	}
+
+	uint64_t TextureStreamer::get_resident_size() const
+	{
+		return m_residentSize;
+	}
+
+	uint64_t TextureStreamer::get_chain_size(const StreamedTexture& texture, uint32_t firstLevel)
+	{
+		uint64_t size{};
+		for (size_t level = firstLevel; level < texture.levelSizes.size(); ++level)
+		{
+			size += texture.levelSizes[level];
+		}
+		return size;
+	}
+
+	bool TextureStreamer::evict(uint64_t size, bool partial, std::vector<TextureResidencyChange>* changes)
+	{
+		// Textures unused this frame go back to their initial level, used ones to the level they need
+		struct Eviction {
+			size_t textureId;
+			uint32_t level;
+			uint64_t freedSize;
+			uint64_t lastUsedFrame;
+		};
+
+		std::vector<Eviction> evictions{};
+		uint64_t freeableSize{};
+		for (const auto& [textureId, texture] : m_textures)
+		{
+			const bool used{ texture.requestedLevel != UINT32_MAX };
+			const uint32_t level{ used ? texture.requestedLevel : std::max(texture.initialLevel, texture.firstLevel) };
+			if (!texture.streamed || level <= texture.firstLevel)
+			{
+				continue;
+			}
+
+			const uint64_t freedSize{ get_chain_size(texture, texture.firstLevel) - get_chain_size(texture, level) };
+			evictions.push_back({ textureId, level, freedSize, texture.lastUsedFrame });
+			freeableSize += freedSize;
+		}
+
+		if (freeableSize < size && !partial)
+		{
+			return false;
+		}
+
+		// Least recently used first, then the largest
+		std::sort(evictions.begin(), evictions.end(), [](const Eviction& a, const Eviction& b) {
+			if (a.lastUsedFrame != b.lastUsedFrame) return a.lastUsedFrame < b.lastUsedFrame;
+			if (a.freedSize != b.freedSize) return a.freedSize > b.freedSize;
+			return a.textureId < b.textureId;
+		});
+
+		uint64_t freedSize{};
+		for (size_t i = 0; i < evictions.size() && freedSize < size; ++i)
+		{
+			const Eviction& eviction{ evictions[i] };
+			m_textures[eviction.textureId].firstLevel = eviction.level;
+			m_residentSize -= eviction.freedSize;
+			freedSize += eviction.freedSize;
+
+			// A texture is changed at most once per frame
+			auto change{ std::find_if(changes->begin(), changes->end(), 
+				[&eviction](const TextureResidencyChange& change) { return change.textureId == eviction.textureId; }) };
+			if (change != changes->end())
+			{
+				change->firstLevel = eviction.level;
+			}
+			else
+			{
+				changes->push_back({ eviction.textureId, eviction.level });
+			}
+		}
+
+		return freedSize >= size;
+	}
+
+}
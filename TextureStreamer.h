@@ -0,0 +1,77 @@
+#pragma once
+
+#include <unordered_map>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+namespace VkCourse {
+
+	struct TextureStreamingOptions {
+		uint64_t budget{ 256ull << 20 };		// Bytes of texel data all the textures can keep resident
+		uint32_t initialSize{ 128 };			// Streamed textures are created with the levels up to this size only
+		uint32_t maxChangesPerFrame{ 4 };		// Residency changes (uploads) applied per frame
+	};
+
+	struct TextureResidencyChange {
+		size_t textureId;
+		uint32_t firstLevel;		// New most detailed resident level, every level after it is resident too
+	};
+
+	// Decides which mip levels of each texture are resident. Textures start with their low mips only, the levels
+	// requested every frame (from the screen size of the meshes using them) are then loaded, most needed first,
+	// and the high mips of the least recently used textures are evicted to stay within the budget.
+	// Only the policy lives here, the renderer does the uploads. Texture ids never change.
+	class TextureStreamer
+	{
+	public:
+		TextureStreamer();
+
+		~TextureStreamer();
+
+		void set_options(const TextureStreamingOptions& options);
+		const TextureStreamingOptions& get_options() const;
+
+		// Level a new texture is created with, the smallest one no larger than initialSize
+		uint32_t get_initial_level(uint32_t width, uint32_t height, uint32_t levelCount) const;
+
+		// levelSizes holds the byte size of every level of the full chain. Textures that are not streamed
+		// stay fully resident, but they still count towards the budget
+		void add_texture(size_t textureId, uint32_t width, uint32_t height, const std::vector<uint64_t>& levelSizes, 
+			uint32_t firstLevel, bool streamed);
+		void remove_texture(size_t textureId);
+
+		// The texture covers about projectedSize pixels on screen this frame
+		void request_size(size_t textureId, float projectedSize);
+
+		// Ends the frame, returns the residency changes the renderer has to apply (they are considered done).
+		// The renderer calls it once the previous changes are applied, the sizes requested until then add up
+		std::vector<TextureResidencyChange> update();
+
+		uint64_t get_resident_size() const;
+
+	private:
+		struct StreamedTexture {
+			uint32_t width;
+			uint32_t height;
+			std::vector<uint64_t> levelSizes;
+			uint32_t initialLevel;
+			uint32_t firstLevel;				// Resident
+			uint32_t requestedLevel;			// This frame, UINT32_MAX if it was not used
+			uint64_t lastUsedFrame;
+			bool streamed;
+		};
+
+		TextureStreamingOptions m_options{};
+		std::unordered_map<size_t, StreamedTexture> m_textures{};
+		uint64_t m_residentSize{};
+		uint64_t m_frame{};
+
+		static uint64_t get_chain_size(const StreamedTexture& texture, uint32_t firstLevel);
+
+		// Lowers the residency of the least recently used textures until size bytes are free. Returns false if
+		// they can't free that much, in which case nothing is evicted unless partial is set
+		bool evict(uint64_t size, bool partial, std::vector<TextureResidencyChange>* changes);
+	};
+
+}
@@ -0,0 +1,60 @@
+#include "AssetPack.h"
+
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstdlib>
+
+// Packs the assets the renderer loads (Models/ and Textures/) into a single Assets.pack, read by the renderer
+// through one mapping. Run it after the texture cooker, so the cooked KTX2 files are packed too. Packed assets
+// take precedence over loose files, so repack after changing any asset. Shaders are embedded in the executable
+// instead (see ShaderCode.h).
+//
+// Usage: AssetPacker [root directory] [output file]
+//   root directory: directory holding Models/ and Textures/ (working directory by default)
+//   output file:    <root directory>/Assets.pack by default
+
+int main(int argc, char* argv[])
+{
+	const std::filesystem::path rootDirectory{ argc > 1 ? argv[1] : "." };
+	const std::filesystem::path outputFile{ argc > 2 ? std::filesystem::path(argv[2]) : rootDirectory / "Assets.pack" };
+
+	try
+	{
+		std::vector<VkCourse::AssetPack::AssetSource> sources{};
+		for (const char* directory : { "Models", "Textures" })
+		{
+			if (!std::filesystem::is_directory(rootDirectory / directory))
+			{
+				continue;
+			}
+
+			for (const auto& entry : std::filesystem::recursive_directory_iterator(rootDirectory / directory))
+			{
+				if (!entry.is_regular_file())
+				{
+					continue;
+				}
+
+				// Names are what the renderer asks for, relative to its working directory
+				sources.push_back({
+					.name = std::filesystem::relative(entry.path(), rootDirectory).generic_string(),
+					.filePath = entry.path().string(),
+				});
+			}
+		}
+
+		const uint64_t packSize{ VkCourse::AssetPack::write(outputFile.string(), sources) };
+
+		std::cout << "Packed " << sources.size() << " assets into " << outputFile.string() 
+			<< " (" << packSize / 1024 << " KiB)" << std::endl;
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << "ERROR: " << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
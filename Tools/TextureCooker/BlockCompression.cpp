@@ -0,0 +1,236 @@
+#include "BlockCompression.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace VkCourse {
+
+	namespace {
+		// Copies the 4x4 block at (blockX, blockY), clamping to the image edges
+		void fetch_block(const unsigned char* rgba, uint32_t width, uint32_t height,
+			uint32_t blockX, uint32_t blockY, unsigned char block[16][4])
+		{
+			for (uint32_t y = 0; y < 4; ++y)
+			{
+				const uint32_t srcY{ std::min(blockY * 4 + y, height - 1) };
+				for (uint32_t x = 0; x < 4; ++x)
+				{
+					const uint32_t srcX{ std::min(blockX * 4 + x, width - 1) };
+					memcpy(block[y * 4 + x], rgba + (static_cast<size_t>(srcY) * width + srcX) * 4, 4);
+				}
+			}
+		}
+
+		uint16_t to_565(const float color[3])
+		{
+			const auto r{ static_cast<uint16_t>(std::lround(std::clamp(color[0], 0.f, 255.f) * 31.f / 255.f)) };
+			const auto g{ static_cast<uint16_t>(std::lround(std::clamp(color[1], 0.f, 255.f) * 63.f / 255.f)) };
+			const auto b{ static_cast<uint16_t>(std::lround(std::clamp(color[2], 0.f, 255.f) * 31.f / 255.f)) };
+			return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+		}
+
+		void from_565(uint16_t color, int rgb[3])
+		{
+			const int r{ (color >> 11) & 31 };
+			const int g{ (color >> 5) & 63 };
+			const int b{ color & 31 };
+			rgb[0] = (r << 3) | (r >> 2);
+			rgb[1] = (g << 2) | (g >> 4);
+			rgb[2] = (b << 3) | (b >> 2);
+		}
+
+		// Four color BC1 block (also the color half of BC3)
+		void encode_color_block(const unsigned char block[16][4], unsigned char* dst)
+		{
+			// Principal axis of the block colors
+			float mean[3]{};
+			for (size_t i = 0; i < 16; ++i)
+			{
+				for (size_t c = 0; c < 3; ++c)
+				{
+					mean[c] += block[i][c] / 16.f;
+				}
+			}
+
+			float covariance[6]{};	// xx, xy, xz, yy, yz, zz
+			for (size_t i = 0; i < 16; ++i)
+			{
+				const float r{ block[i][0] - mean[0] };
+				const float g{ block[i][1] - mean[1] };
+				const float b{ block[i][2] - mean[2] };
+				covariance[0] += r * r;
+				covariance[1] += r * g;
+				covariance[2] += r * b;
+				covariance[3] += g * g;
+				covariance[4] += g * b;
+				covariance[5] += b * b;
+			}
+
+			float axis[3]{ 1.f, 1.f, 1.f };
+			for (size_t iteration = 0; iteration < 8; ++iteration)
+			{
+				const float x{ covariance[0] * axis[0] + covariance[1] * axis[1] + covariance[2] * axis[2] };
+				const float y{ covariance[1] * axis[0] + covariance[3] * axis[1] + covariance[4] * axis[2] };
+				const float z{ covariance[2] * axis[0] + covariance[4] * axis[1] + covariance[5] * axis[2] };
+				const float length{ std::max({ std::fabs(x), std::fabs(y), std::fabs(z) }) };
+				if (length < 1e-6f)
+				{
+					break;		// Flat block, any axis works
+				}
+				axis[0] = x / length;
+				axis[1] = y / length;
+				axis[2] = z / length;
+			}
+
+			// End points are the extreme projections on the axis
+			float minProjection{ INFINITY };
+			float maxProjection{ -INFINITY };
+			for (size_t i = 0; i < 16; ++i)
+			{
+				const float projection{ (block[i][0] - mean[0]) * axis[0] + (block[i][1] - mean[1]) * axis[1]
+					+ (block[i][2] - mean[2]) * axis[2] };
+				minProjection = std::min(minProjection, projection);
+				maxProjection = std::max(maxProjection, projection);
+			}
+
+			const float axisLengthSquared{ axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2] };
+			float maxColor[3];
+			float minColor[3];
+			for (size_t c = 0; c < 3; ++c)
+			{
+				maxColor[c] = mean[c] + axis[c] * maxProjection / axisLengthSquared;
+				minColor[c] = mean[c] + axis[c] * minProjection / axisLengthSquared;
+			}
+
+			uint16_t color0{ to_565(maxColor) };
+			uint16_t color1{ to_565(minColor) };
+			if (color0 < color1)
+			{
+				std::swap(color0, color1);
+			}
+
+			uint32_t indices{};
+			if (color0 != color1)
+			{
+				// Four color mode palette (color0 > color1)
+				int palette[4][3];
+				from_565(color0, palette[0]);
+				from_565(color1, palette[1]);
+				for (size_t c = 0; c < 3; ++c)
+				{
+					palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+					palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+				}
+
+				for (size_t i = 0; i < 16; ++i)
+				{
+					uint32_t bestIndex{};
+					int bestError{ INT32_MAX };
+					for (uint32_t p = 0; p < 4; ++p)
+					{
+						int error{};
+						for (size_t c = 0; c < 3; ++c)
+						{
+							const int difference{ block[i][c] - palette[p][c] };
+							error += difference * difference;
+						}
+						if (error < bestError)
+						{
+							bestError = error;
+							bestIndex = p;
+						}
+					}
+					indices |= bestIndex << (i * 2);
+				}
+			}
+
+			memcpy(dst, &color0, 2);
+			memcpy(dst + 2, &color1, 2);
+			memcpy(dst + 4, &indices, 4);
+		}
+
+		// Eight value BC3 alpha block
+		void encode_alpha_block(const unsigned char block[16][4], unsigned char* dst)
+		{
+			uint8_t alpha0{ 0 };
+			uint8_t alpha1{ 255 };
+			for (size_t i = 0; i < 16; ++i)
+			{
+				alpha0 = std::max(alpha0, block[i][3]);
+				alpha1 = std::min(alpha1, block[i][3]);
+			}
+
+			uint64_t indices{};
+			if (alpha0 != alpha1)
+			{
+				int palette[8]{ alpha0, alpha1 };
+				for (int p = 1; p < 7; ++p)
+				{
+					palette[p + 1] = ((7 - p) * alpha0 + p * alpha1) / 7;
+				}
+
+				for (size_t i = 0; i < 16; ++i)
+				{
+					uint64_t bestIndex{};
+					int bestError{ INT32_MAX };
+					for (uint64_t p = 0; p < 8; ++p)
+					{
+						const int error{ std::abs(block[i][3] - palette[p]) };
+						if (error < bestError)
+						{
+							bestError = error;
+							bestIndex = p;
+						}
+					}
+					indices |= bestIndex << (i * 3);
+				}
+			}
+
+			dst[0] = alpha0;
+			dst[1] = alpha1;
+			memcpy(dst + 2, &indices, 6);	// Little endian, 48 bits
+		}
+	}
+
+	std::vector<unsigned char> compress_bc1(const unsigned char* rgba, uint32_t width, uint32_t height)
+	{
+		const uint32_t blocksX{ (width + 3) / 4 };
+		const uint32_t blocksY{ (height + 3) / 4 };
+		std::vector<unsigned char> compressed(static_cast<size_t>(blocksX) * blocksY * 8);
+
+		unsigned char block[16][4];
+		for (uint32_t y = 0; y < blocksY; ++y)
+		{
+			for (uint32_t x = 0; x < blocksX; ++x)
+			{
+				fetch_block(rgba, width, height, x, y, block);
+				encode_color_block(block, compressed.data() + (static_cast<size_t>(y) * blocksX + x) * 8);
+			}
+		}
+
+		return compressed;
+	}
+
+	std::vector<unsigned char> compress_bc3(const unsigned char* rgba, uint32_t width, uint32_t height)
+	{
+		const uint32_t blocksX{ (width + 3) / 4 };
+		const uint32_t blocksY{ (height + 3) / 4 };
+		std::vector<unsigned char> compressed(static_cast<size_t>(blocksX) * blocksY * 16);
+
+		unsigned char block[16][4];
+		for (uint32_t y = 0; y < blocksY; ++y)
+		{
+			for (uint32_t x = 0; x < blocksX; ++x)
+			{
+				unsigned char* dst{ compressed.data() + (static_cast<size_t>(y) * blocksX + x) * 16 };
+				fetch_block(rgba, width, height, x, y, block);
+				encode_alpha_block(block, dst);
+				encode_color_block(block, dst + 8);
+			}
+		}
+
+		return compressed;
+	}
+
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+namespace VkCourse {
+
+	// CPU encoders used by the texture cooker. Input is tightly packed RGBA8, any size (edge blocks
+	// repeat the last row/column). Quality is that of a simple range fit along the principal axis,
+	// which is enough for albedo textures.
+
+	// BC1 without alpha, 8 bytes per 4x4 block
+	std::vector<unsigned char> compress_bc1(const unsigned char* rgba, uint32_t width, uint32_t height);
+
+	// BC3 (BC1 color + interpolated alpha), 16 bytes per 4x4 block
+	std::vector<unsigned char> compress_bc3(const unsigned char* rgba, uint32_t width, uint32_t height);
+
+}
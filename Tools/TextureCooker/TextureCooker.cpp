@@ -0,0 +1,207 @@
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+#include "Ktx2.h"
+#include "BlockCompression.h"
+#include "Mipmaps.h"
+
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include <cctype>
+#include <cstdlib>
+
+// Converts the source images of a directory (Textures/ by default) and its subdirectories into KTX2 files with a
+// full mip chain, so the renderer can upload them as they are. Outputs are written next to the sources as
+// <relative path>.ktx2 (sub/foo.png -> sub/foo.png.ktx2, so foo.png and foo.jpg do not collide), the name the
+// renderer looks for, and are only rebuilt when the source is newer, unless --force is given.
+//
+// Usage: TextureCooker [source directory] [output directory] [--format auto|bc1|bc3|rgba8] [--force]
+//   auto:  BC3 if the image has any transparency, BC1 otherwise
+//   rgba8: uncompressed fallback, for devices without BC support
+
+namespace {
+	enum class CookFormat {
+		Auto,
+		BC1,
+		BC3,
+		RGBA8,
+	};
+
+	bool is_source_image(const std::filesystem::path& path)
+	{
+		std::string extension{ path.extension().string() };
+		std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return std::tolower(c); });
+		return extension == ".png" || extension == ".jpg" || extension == ".jpeg" || extension == ".tga" || extension == ".bmp";
+	}
+
+	bool has_transparency(const unsigned char* rgba, size_t pixelCount)
+	{
+		for (size_t i = 0; i < pixelCount; ++i)
+		{
+			if (rgba[i * 4 + 3] != 255)
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void cook_texture(const std::filesystem::path& source, const std::filesystem::path& destination, CookFormat cookFormat)
+	{
+		int width, height, channels;
+		stbi_uc* image{ stbi_load(source.string().c_str(), &width, &height, &channels, STBI_rgb_alpha) };
+		if (!image)
+		{
+			throw std::runtime_error("Failed to load texture file " + source.string() + "!");
+		}
+
+		std::vector<unsigned char> level(image, image + static_cast<size_t>(width) * height * 4);
+		stbi_image_free(image);
+
+		if (cookFormat == CookFormat::Auto)
+		{
+			cookFormat = has_transparency(level.data(), static_cast<size_t>(width) * height) ? CookFormat::BC3 : CookFormat::BC1;
+		}
+
+		VkFormat format{};
+		switch (cookFormat)
+		{
+		case CookFormat::BC1:
+			format = VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+			break;
+		case CookFormat::BC3:
+			format = VK_FORMAT_BC3_UNORM_BLOCK;
+			break;
+		default:
+			format = VK_FORMAT_R8G8B8A8_UNORM;
+			break;
+		}
+
+		// Mips are filtered from the previous uncompressed level, then encoded
+		std::vector<std::vector<unsigned char>> levels{};
+		uint32_t levelWidth{ static_cast<uint32_t>(width) };
+		uint32_t levelHeight{ static_cast<uint32_t>(height) };
+		while (true)
+		{
+			switch (format)
+			{
+			case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+				levels.push_back(VkCourse::compress_bc1(level.data(), levelWidth, levelHeight));
+				break;
+			case VK_FORMAT_BC3_UNORM_BLOCK:
+				levels.push_back(VkCourse::compress_bc3(level.data(), levelWidth, levelHeight));
+				break;
+			default:
+				levels.push_back(level);
+				break;
+			}
+
+			if (levelWidth == 1 && levelHeight == 1)
+			{
+				break;
+			}
+
+			const uint32_t nextWidth{ std::max(1u, levelWidth / 2) };
+			const uint32_t nextHeight{ std::max(1u, levelHeight / 2) };
+			std::vector<unsigned char> nextLevel(static_cast<size_t>(nextWidth) * nextHeight * 4);
+			VkCourse::downsample_rgba(level.data(), levelWidth, levelHeight, nextLevel.data());
+
+			level = std::move(nextLevel);
+			levelWidth = nextWidth;
+			levelHeight = nextHeight;
+		}
+
+		VkCourse::write_ktx2(destination.string(), format, width, height, levels);
+
+		std::cout << source.string() << " -> " << destination.string()
+			<< " (" << width << "x" << height << ", " << levels.size() << " mips)" << std::endl;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	std::vector<std::string> directories{};
+	CookFormat cookFormat{ CookFormat::Auto };
+	bool force{ false };
+
+	for (int i = 1; i < argc; ++i)
+	{
+		const std::string argument{ argv[i] };
+		if (argument == "--force")
+		{
+			force = true;
+		}
+		else if (argument == "--format" && i + 1 < argc)
+		{
+			const std::string formatName{ argv[++i] };
+			if (formatName == "auto")
+			{
+				cookFormat = CookFormat::Auto;
+			}
+			else if (formatName == "bc1")
+			{
+				cookFormat = CookFormat::BC1;
+			}
+			else if (formatName == "bc3")
+			{
+				cookFormat = CookFormat::BC3;
+			}
+			else if (formatName == "rgba8")
+			{
+				cookFormat = CookFormat::RGBA8;
+			}
+			else
+			{
+				std::cerr << "Unknown format " << formatName << std::endl;
+				return EXIT_FAILURE;
+			}
+		}
+		else
+		{
+			directories.push_back(argument);
+		}
+	}
+
+	const std::filesystem::path sourceDirectory{ directories.size() > 0 ? directories[0] : "Textures" };
+	const std::filesystem::path outputDirectory{ directories.size() > 1 ? std::filesystem::path(directories[1]) : sourceDirectory };
+
+	try
+	{
+		std::filesystem::create_directories(outputDirectory);
+
+		size_t cookedCount{};
+		for (const auto& entry : std::filesystem::recursive_directory_iterator(sourceDirectory))
+		{
+			if (!entry.is_regular_file() || !is_source_image(entry.path()))
+			{
+				continue;
+			}
+
+			std::filesystem::path destination{ outputDirectory / std::filesystem::relative(entry.path(), sourceDirectory) };
+			destination += ".ktx2";
+			std::filesystem::create_directories(destination.parent_path());
+
+			if (!force && std::filesystem::exists(destination)
+				&& std::filesystem::last_write_time(destination) >= entry.last_write_time())
+			{
+				continue;
+			}
+
+			cook_texture(entry.path(), destination, cookFormat);
+			++cookedCount;
+		}
+
+		std::cout << "Cooked " << cookedCount << " textures into " << outputDirectory.string() << std::endl;
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << "ERROR: " << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -19,9 +19,9 @@ namespace VkCourse
 		VK_KHR_SWAPCHAIN_EXTENSION_NAME,
 	};
 
+	// Imported vertex, see VertexFormat.h for the layouts used in the vertex buffers
 	struct Vertex {
 		glm::vec3 position;
-		glm::vec3 color;		// RGB
 		glm::vec2 texCoords;
 	};
 
@@ -49,27 +49,21 @@ namespace VkCourse
 		VkImageView imageView;
 	};
 
-	inline std::vector<char> read_file(std::string_view fileName)
+	// FNV-1a hash, used to build keys for cached and pooled assets
+	inline uint64_t hash_bytes(const void* data, size_t size, uint64_t hash = 14695981039346656037ull)
 	{
-		// Binary (we are reading SPIR-V) + start reading from the end of file (to know the size)
-		std::ifstream file(fileName.data(), std::ios::binary | std::ios::ate);
-		if (!file.is_open())
+		const unsigned char* bytes{ static_cast<const unsigned char*>(data) };
+		for (size_t i = 0; i < size; ++i)
 		{
-			throw std::runtime_error("Failed to open file" + std::string(fileName) + "!");
+			hash ^= bytes[i];
+			hash *= 1099511628211ull;
 		}
-
-		size_t fileSize{ static_cast<size_t>(file.tellg()) };
-		std::vector<char> fileBuffer(fileSize);
-
-		// Go back to position 0 to start reading file
-		file.seekg(0);
-		file.read(fileBuffer.data(), fileSize);
-		file.close();
-
-		return fileBuffer;
+		return hash;
 	}
 
-	inline uint32_t find_memory_type_index(VkPhysicalDevice physicalDevice, uint32_t allowedTypes, VkMemoryPropertyFlags memoryPropertyFlags)
+	// Returns false if no allowed memory type has all the requested properties
+	inline bool try_find_memory_type_index(VkPhysicalDevice physicalDevice, uint32_t allowedTypes, VkMemoryPropertyFlags memoryPropertyFlags, 
+		uint32_t* memoryTypeIndex)
 	{
 		// Get properties of physical device memory
 		VkPhysicalDeviceMemoryProperties physicalDeviceMemoryProperties;
@@ -82,11 +76,22 @@ namespace VkCourse
 				// memoryTypes[i].properties is equal to the parameter memoryPropertyFlags
 				&& ((physicalDeviceMemoryProperties.memoryTypes[i].propertyFlags & memoryPropertyFlags) == memoryPropertyFlags))
 			{
-				return i;
+				*memoryTypeIndex = i;
+				return true;
 			}
 		}
 
-		throw std::runtime_error("Failed to find memory type with requested properties!");
+		return false;
+	}
+
+	inline uint32_t find_memory_type_index(VkPhysicalDevice physicalDevice, uint32_t allowedTypes, VkMemoryPropertyFlags memoryPropertyFlags)
+	{
+		uint32_t memoryTypeIndex;
+		if (!try_find_memory_type_index(physicalDevice, allowedTypes, memoryPropertyFlags, &memoryTypeIndex))
+		{
+			throw std::runtime_error("Failed to find memory type with requested properties!");
+		}
+		return memoryTypeIndex;
 	}
 
 	inline void create_buffer(VkPhysicalDevice physicalDevice, VkDevice device, VkDeviceSize bufferSize, 
@@ -199,18 +204,16 @@ namespace VkCourse
 		end_and_submit_command_buffer(device, transferCommandPool, transferQueue, transferCommandBuffer);
 	}
 
-	inline void copy_image_buffer(VkDevice device, VkQueue transferQueue, VkCommandPool transferCommandPool,
-		VkBuffer srcBuffer, VkImage dstImage, uint32_t width, uint32_t height)
+	inline void record_copy_image_buffer(VkCommandBuffer commandBuffer, VkBuffer srcBuffer, VkDeviceSize srcOffset,
+		VkImage dstImage, uint32_t mipLevel, uint32_t width, uint32_t height)
 	{
-		VkCommandBuffer transferCommandBuffer{ begin_command_buffer(device, transferCommandPool) };
-
 		VkBufferImageCopy bufferImageCopyRegion{
-			.bufferOffset = 0,
+			.bufferOffset = srcOffset,	// Where the image data starts inside the buffer
 			.bufferRowLength = 0,		// For data spacing calculation (if 0 --> tightly packed)
 			.bufferImageHeight = 0,
 			.imageSubresource{
 				.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-				.mipLevel = 0,
+				.mipLevel = mipLevel,
 				.baseArrayLayer = 0,
 				.layerCount = 1,
 			},
@@ -222,17 +225,14 @@ namespace VkCourse
 			},
 		};
 
-		vkCmdCopyBufferToImage(transferCommandBuffer, srcBuffer, dstImage, 
+		vkCmdCopyBufferToImage(commandBuffer, srcBuffer, dstImage, 
 			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &bufferImageCopyRegion);
-
-		end_and_submit_command_buffer(device, transferCommandPool, transferQueue, transferCommandBuffer);
 	}
 
-	inline void transition_image_layout(VkDevice device, VkQueue queue, VkCommandPool commandPool, 
-		VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout)
+	// Records the layout transition barrier only, so that several transitions can share one command buffer
+	inline void record_image_layout_transition(VkCommandBuffer commandBuffer, 
+		VkImage image, uint32_t mipLevels, VkImageLayout oldLayout, VkImageLayout newLayout)
 	{
-		VkCommandBuffer commandBuffer{ begin_command_buffer(device, commandPool) };
-
 		VkImageMemoryBarrier imageMemoryBarrier{
 			.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
 			.oldLayout = oldLayout,
@@ -243,7 +243,7 @@ namespace VkCourse
 			.subresourceRange{
 				.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
 				.baseMipLevel = 0,
-				.levelCount = 1,
+				.levelCount = mipLevels,
 				.baseArrayLayer = 0,
 				.layerCount = 1,
 			},
@@ -272,7 +272,7 @@ namespace VkCourse
 		}
 		else
 		{
-			throw std::runtime_error("Unspecified layouts in transition_image_layout()!");
+			throw std::runtime_error("Unspecified layouts in record_image_layout_transition()!");
 		}
 
 		vkCmdPipelineBarrier(
@@ -283,7 +283,86 @@ namespace VkCourse
 			0, nullptr,				// Buffer memory barrier + data
 			1, &imageMemoryBarrier	// Image memory barrier + data
 		);
+	}
+
+	// Fills levels 1..mipLevels-1 by blitting each level into the next one. Expects every level in
+	// TRANSFER_DST_OPTIMAL with level 0 written, leaves every level in SHADER_READ_ONLY_OPTIMAL.
+	// The format must support linear blits (VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT)
+	inline void record_generate_mipmaps(VkCommandBuffer commandBuffer, 
+		VkImage image, uint32_t width, uint32_t height, uint32_t mipLevels)
+	{
+		VkImageMemoryBarrier imageMemoryBarrier{
+			.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+			.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+			.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+			.image = image,
+			.subresourceRange{
+				.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+				.levelCount = 1,
+				.baseArrayLayer = 0,
+				.layerCount = 1,
+			},
+		};
+
+		int32_t levelWidth{ static_cast<int32_t>(width) };
+		int32_t levelHeight{ static_cast<int32_t>(height) };
+
+		for (uint32_t i = 1; i < mipLevels; ++i)
+		{
+			// Previous level has been written (copy or blit), make it the blit source
+			imageMemoryBarrier.subresourceRange.baseMipLevel = i - 1;
+			imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+			imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+				0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+
+			const int32_t nextWidth{ levelWidth > 1 ? levelWidth / 2 : 1 };
+			const int32_t nextHeight{ levelHeight > 1 ? levelHeight / 2 : 1 };
+
+			VkImageBlit imageBlit{
+				.srcSubresource{
+					.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+					.mipLevel = i - 1,
+					.baseArrayLayer = 0,
+					.layerCount = 1,
+				},
+				.srcOffsets{ { 0, 0, 0 }, { levelWidth, levelHeight, 1 } },
+				.dstSubresource{
+					.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+					.mipLevel = i,
+					.baseArrayLayer = 0,
+					.layerCount = 1,
+				},
+				.dstOffsets{ { 0, 0, 0 }, { nextWidth, nextHeight, 1 } },
+			};
+
+			vkCmdBlitImage(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+				image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &imageBlit, VK_FILTER_LINEAR);
+
+			// Source level is final
+			imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+			imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+			imageMemoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+				0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+
+			levelWidth = nextWidth;
+			levelHeight = nextHeight;
+		}
+
+		// Last level was only written to
+		imageMemoryBarrier.subresourceRange.baseMipLevel = mipLevels - 1;
+		imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		imageMemoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
 
-		end_and_submit_command_buffer(device, commandPool, queue, commandBuffer);
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+			0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
 	}
 }
\ No newline at end of file
@@ -0,0 +1,198 @@
+#include "VertexFormat.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace VkCourse {
+
+	namespace {
+		constexpr VkDeviceSize VERTEX_STREAM_ALIGNMENT{ 16 };
+
+		struct PackedPosition {
+			uint16_t position[4];	// w unused, keeps the attribute at a mandatory vertex format
+		};
+
+		struct PackedAttributes {
+			uint16_t texCoords[2];
+		};
+
+		struct FloatAttributes {
+			glm::vec2 texCoords;
+		};
+
+		uint32_t get_position_stride(VertexFormat format)
+		{
+			return format == VertexFormat::Packed ? sizeof(PackedPosition) : sizeof(glm::vec3);
+		}
+
+		uint32_t get_attribute_stride(VertexFormat format)
+		{
+			return format == VertexFormat::Packed ? sizeof(PackedAttributes) : sizeof(FloatAttributes);
+		}
+	}
+
+	std::vector<VkVertexInputBindingDescription> get_vertex_binding_descriptions(VertexFormat format, bool positionOnly)
+	{
+		std::vector<VkVertexInputBindingDescription> bindingDescriptions{
+			{
+				.binding = 0,
+				.stride = get_position_stride(format),
+				.inputRate = VK_VERTEX_INPUT_RATE_VERTEX,
+			},
+		};
+
+		if (!positionOnly)
+		{
+			bindingDescriptions.push_back({
+				.binding = 1,
+				.stride = get_attribute_stride(format),
+				.inputRate = VK_VERTEX_INPUT_RATE_VERTEX,
+			});
+		}
+
+		return bindingDescriptions;
+	}
+
+	std::vector<VkVertexInputAttributeDescription> get_vertex_attribute_descriptions(VertexFormat format, bool positionOnly)
+	{
+		const bool packed{ format == VertexFormat::Packed };
+
+		std::vector<VkVertexInputAttributeDescription> attributeDescriptions{
+			// Position, packed ones are read as 0-1 and dequantized by the model matrix
+			{
+				.location = 0,
+				.binding = 0,
+				.format = packed ? VK_FORMAT_R16G16B16A16_UNORM : VK_FORMAT_R32G32B32_SFLOAT,
+				.offset = 0,
+			},
+		};
+
+		if (!positionOnly)
+		{
+			// Texture coordinates
+			attributeDescriptions.push_back({
+				.location = 1,
+				.binding = 1,
+				.format = packed ? VK_FORMAT_R16G16_SFLOAT : VK_FORMAT_R32G32_SFLOAT,
+				.offset = packed ? offsetof(PackedAttributes, texCoords) : offsetof(FloatAttributes, texCoords),
+			});
+		}
+
+		return attributeDescriptions;
+	}
+
+	VertexStreams encode_vertices(const std::vector<Vertex>& vertices, VertexFormat format)
+	{
+		const VkDeviceSize positionsSize{ static_cast<VkDeviceSize>(get_position_stride(format)) * vertices.size() };
+		const VkDeviceSize attributeOffset{ (positionsSize + VERTEX_STREAM_ALIGNMENT - 1) & ~(VERTEX_STREAM_ALIGNMENT - 1) };
+
+		VertexStreams vertexStreams{
+			.data = std::vector<unsigned char>(attributeOffset + static_cast<VkDeviceSize>(get_attribute_stride(format)) * vertices.size()),
+			.attributeOffset = attributeOffset,
+			.dequantization = glm::mat4(1.f),
+		};
+
+		unsigned char* positions{ vertexStreams.data.data() };
+		unsigned char* attributes{ vertexStreams.data.data() + attributeOffset };
+
+		if (format == VertexFormat::Float)
+		{
+			for (size_t i = 0; i < vertices.size(); ++i)
+			{
+				const FloatAttributes floatAttributes{ vertices[i].texCoords };
+				memcpy(positions + i * sizeof(glm::vec3), &vertices[i].position, sizeof(glm::vec3));
+				memcpy(attributes + i * sizeof(FloatAttributes), &floatAttributes, sizeof(FloatAttributes));
+			}
+
+			return vertexStreams;
+		}
+
+		// Positions are stored relative to the bounding box of the mesh
+		glm::vec3 minPosition{ vertices.empty() ? glm::vec3(0.f) : vertices[0].position };
+		glm::vec3 maxPosition{ minPosition };
+		for (const auto& vertex : vertices)
+		{
+			minPosition = glm::min(minPosition, vertex.position);
+			maxPosition = glm::max(maxPosition, vertex.position);
+		}
+
+		const glm::vec3 extent{ maxPosition - minPosition };
+
+		for (size_t i = 0; i < vertices.size(); ++i)
+		{
+			PackedPosition packedPosition{};
+			for (int c = 0; c < 3; ++c)
+			{
+				const float normalized{ extent[c] > 0.f ? (vertices[i].position[c] - minPosition[c]) / extent[c] : 0.f };
+				packedPosition.position[c] = static_cast<uint16_t>(std::lround(std::clamp(normalized, 0.f, 1.f) * 65535.f));
+			}
+			packedPosition.position[3] = 65535;
+
+			PackedAttributes packedAttributes{};
+			packedAttributes.texCoords[0] = float_to_half(vertices[i].texCoords.x);
+			packedAttributes.texCoords[1] = float_to_half(vertices[i].texCoords.y);
+
+			memcpy(positions + i * sizeof(PackedPosition), &packedPosition, sizeof(PackedPosition));
+			memcpy(attributes + i * sizeof(PackedAttributes), &packedAttributes, sizeof(PackedAttributes));
+		}
+
+		vertexStreams.dequantization = glm::scale(glm::translate(glm::mat4(1.f), minPosition), extent);
+		return vertexStreams;
+	}
+
+	uint16_t float_to_half(float value)
+	{
+		uint32_t bits;
+		memcpy(&bits, &value, sizeof(bits));
+
+		const uint32_t sign{ (bits >> 16) & 0x8000 };
+		const uint32_t exponent{ (bits >> 23) & 0xff };
+		uint32_t mantissa{ bits & 0x7fffff };
+
+		// NaN and infinity
+		if (exponent == 0xff)
+		{
+			return static_cast<uint16_t>(sign | 0x7c00 | (mantissa != 0 ? 0x200 : 0));
+		}
+
+		const int halfExponent{ static_cast<int>(exponent) - 127 + 15 };
+
+		// Too large, infinity
+		if (halfExponent >= 31)
+		{
+			return static_cast<uint16_t>(sign | 0x7c00);
+		}
+
+		// Subnormal or zero
+		if (halfExponent <= 0)
+		{
+			if (halfExponent < -10)
+			{
+				return static_cast<uint16_t>(sign);
+			}
+
+			mantissa |= 0x800000;
+			const uint32_t shift{ static_cast<uint32_t>(14 - halfExponent) };
+			uint32_t halfMantissa{ mantissa >> shift };
+			const uint32_t remainder{ mantissa & ((1u << shift) - 1) };
+			const uint32_t halfway{ 1u << (shift - 1) };
+			if (remainder > halfway || (remainder == halfway && (halfMantissa & 1)))
+			{
+				++halfMantissa;
+			}
+			return static_cast<uint16_t>(sign | halfMantissa);
+		}
+
+		uint32_t half{ sign | (static_cast<uint32_t>(halfExponent) << 10) | (mantissa >> 13) };
+		const uint32_t remainder{ mantissa & 0x1fff };
+		if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1)))
+		{
+			++half;		// May carry into the exponent, which is still the correctly rounded value
+		}
+		return static_cast<uint16_t>(half);
+	}
+
+}
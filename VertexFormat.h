@@ -0,0 +1,38 @@
+#pragma once
+
+#include "Utilities.h"
+
+#include <vulkan/vulkan.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <cstdint>
+
+namespace VkCourse {
+
+	// Layout of the vertex buffers on the GPU. Meshes are imported as Vertex, then encoded into the selected
+	// format once (the mesh cache stores the encoded streams).
+	// Each vertex buffer holds two streams: the positions (binding 0), tightly packed so that depth only
+	// passes fetch as little as possible, followed by the other attributes (binding 1).
+	enum class VertexFormat {
+		Float,		// float3 position, float2 UV (12 + 8 bytes)
+		Packed,		// unorm16x4 position in the mesh AABB, half2 UV (8 + 4 bytes)
+	};
+
+	struct VertexStreams {
+		std::vector<unsigned char> data;
+		VkDeviceSize attributeOffset;	// Start of the attribute stream in data
+		glm::mat4 dequantization;		// Maps the stored positions back to the mesh space
+	};
+
+	// Binding and attribute descriptions, locations match shader.vert (or depth.vert with positionOnly)
+	std::vector<VkVertexInputBindingDescription> get_vertex_binding_descriptions(VertexFormat format, bool positionOnly);
+	std::vector<VkVertexInputAttributeDescription> get_vertex_attribute_descriptions(VertexFormat format, bool positionOnly);
+
+	// The dequantization is applied through the model matrix, so the vertex shader doesn't need any extra work
+	VertexStreams encode_vertices(const std::vector<Vertex>& vertices, VertexFormat format);
+
+	// IEEE 754 binary16, round to nearest even
+	uint16_t float_to_half(float value);
+
+}
@@ -1,6 +1,10 @@
 #include "VulkanRenderer.h"
+#include "Mipmaps.h"
 #include "Utilities.h"
 #include "Mesh.h"
+#include "MeshOptimizer.h"
+#include "MappedIOSystem.h"
+#include "ShaderCode.h"
 
 #include <vulkan/vulkan.h>
 
@@ -17,12 +21,57 @@
 #include <set>
 #include <algorithm>
 #include <array>
+#include <atomic>
+#include <future>
+#include <thread>
+#include <filesystem>
+#include <chrono>
+#include <bit>
 
 
 namespace VkCourse
 {
-	VulkanRenderer::VulkanRenderer(const Window& window)
-		: m_window(window)
+	namespace {
+		// Vertex and index bytes of the imported meshes, for the import profile
+		uint64_t get_mesh_data_size(const std::vector<MeshData>& meshes)
+		{
+			uint64_t size{};
+			for (const MeshData& mesh : meshes)
+			{
+				size += mesh.vertices.size() * sizeof(Vertex) + mesh.indices.size() * sizeof(uint32_t);
+			}
+			return size;
+		}
+
+		uint64_t get_encoded_mesh_size(const std::vector<EncodedMesh>& meshes)
+		{
+			uint64_t size{};
+			for (const EncodedMesh& mesh : meshes)
+			{
+				size += mesh.vertexData.size() + mesh.indexData.size();
+			}
+			return size;
+		}
+
+		double get_milliseconds_since(std::chrono::steady_clock::time_point start)
+		{
+			const std::chrono::duration<double, std::milli> time{ std::chrono::steady_clock::now() - start };
+			return time.count();
+		}
+	}
+
+	VulkanRenderer::VulkanRenderer(const Window& window, VertexFormat vertexFormat, VkSampleCountFlagBits msaaSamples)
+		: m_window(&window)
+		, m_vertexFormat(vertexFormat)
+		, m_requestedMsaaSamples(msaaSamples)
+	{
+	}
+
+	VulkanRenderer::VulkanRenderer(VkExtent2D extent, VertexFormat vertexFormat, VkSampleCountFlagBits msaaSamples)
+		: m_window(nullptr)
+		, m_headlessExtent(extent)
+		, m_vertexFormat(vertexFormat)
+		, m_requestedMsaaSamples(msaaSamples)
 	{
 	}
 
@@ -33,19 +82,43 @@ namespace VkCourse
 
 	int VulkanRenderer::init()
 	{
+		const auto initStart{ std::chrono::steady_clock::now() };
 		try
 		{
+			// Optional, assets that are not packed are read from their loose files
+			m_initStats.assetPackOpen = m_assetPack.open("Assets.pack");
+
 			create_instance();
-			create_surface();
+			if (!is_headless())
+			{
+				create_surface();
+			}
 			obtain_physical_device();
+			m_msaaSamples = choose_msaa_samples(m_requestedMsaaSamples);
 			create_logical_device();
-			create_swapchain();
+			m_pipelineCache.create(m_device.physicalDevice, m_device.logicalDevice);
+			m_pipelineRegistry.create(m_device.logicalDevice, m_pipelineCache.get());
+			if (is_headless())
+			{
+				create_headless_images();
+			}
+			else
+			{
+				create_swapchain();
+			}
 			create_color_buffer_image();
 			create_depth_buffer_image();
+			create_msaa_images();
 			create_render_pass();
 			create_descriptor_set_layout();
 			create_push_constant_range();
+
+			const auto pipelinesStart{ std::chrono::steady_clock::now() };
 			create_graphics_pipeline();
+			const std::chrono::duration<double, std::milli> pipelinesTime{ std::chrono::steady_clock::now() - pipelinesStart };
+			m_initStats.pipelinesMilliseconds = pipelinesTime.count();
+			m_initStats.pipelineCacheWarm = m_pipelineCache.is_warm();
+
 			create_framebuffers();
 			create_command_pool();
 			create_command_buffers();
@@ -56,62 +129,106 @@ namespace VkCourse
 			create_descriptor_sets();
 			create_input_descriptor_sets();
 			create_synchronization();
+			create_query_pool();
 
 			// Fill mvp
-			m_uboViewProjection.projection = glm::perspective(glm::radians(45.f),
-				static_cast<float>(m_swapchainExtent.width) / static_cast<float>(m_swapchainExtent.height), 0.1f, 100.f);
-
+			update_projection();
 			m_uboViewProjection.view = glm::lookAt(glm::vec3(10.f, 1.f, 20.f), glm::vec3(0.f), glm::vec3(0.f, 1.f, 0.f));
 
-			m_uboViewProjection.projection[1][1] *= -1.f; // Invert the Y axis to fit Vulkan
-
 			create_texture("White.png");
 		}
 		catch (const std::runtime_error& error)
 		{
-			std::cout << error.what() << std::endl;
+			std::cerr << error.what() << std::endl;
 			return EXIT_FAILURE;
 		}
 
+		const std::chrono::duration<double, std::milli> initTime{ std::chrono::steady_clock::now() - initStart };
+		m_initStats.totalMilliseconds = initTime.count();
+
 		return EXIT_SUCCESS;
 	}
 
 	void VulkanRenderer::draw()
 	{
+		m_frameStats = {};
+
 		// Wait before the previous render to the current frame has finished to start, and close it (unsignal fence)
+		auto stageStart{ std::chrono::steady_clock::now() };
 		vkWaitForFences(m_device.logicalDevice, 1, &m_fencesDraw[m_currentFrame], VK_TRUE, std::numeric_limits<uint64_t>::max());
-		vkResetFences(m_device.logicalDevice, 1, &m_fencesDraw[m_currentFrame]);
+		m_frameStats.waitMilliseconds = get_milliseconds_since(stageStart);
+
+		// Polls the texture streaming batch in progress, never waits for it
+		stageStart = std::chrono::steady_clock::now();
+		update_texture_streaming();
+		m_frameStats.updateMilliseconds = get_milliseconds_since(stageStart);
+
+		// The copy recorded the last time this frame was drawn has completed with it
+		if (m_readbackCallback)
+		{
+			m_frameReadback.deliver(m_currentFrame, m_readbackCallback);
+		}
 
-		// Get a new image to render to, get a semaphore to know when the image is available
 		uint32_t imageIndex;
-		vkAcquireNextImageKHR(m_device.logicalDevice, m_swapchain, std::numeric_limits<uint64_t>::max(), 
-			m_semaphoresImageAvailable[m_currentFrame], VK_NULL_HANDLE, &imageIndex);
+		stageStart = std::chrono::steady_clock::now();
+		if (is_headless())
+		{
+			// One offscreen image per frame in flight, free since its fence is signaled
+			imageIndex = m_currentFrame;
+		}
+		else if (!acquire_swapchain_image(&imageIndex))
+		{
+			return;
+		}
+		m_frameStats.waitMilliseconds += get_milliseconds_since(stageStart);
 
+		vkResetFences(m_device.logicalDevice, 1, &m_fencesDraw[m_currentFrame]);
+
+		stageStart = std::chrono::steady_clock::now();
+		update_pipeline_variants();
+		m_frameStats.updateMilliseconds += get_milliseconds_since(stageStart);
+
+		stageStart = std::chrono::steady_clock::now();
 		record_commands(imageIndex);
+		m_frameStats.recordMilliseconds = get_milliseconds_since(stageStart);
+
+		stageStart = std::chrono::steady_clock::now();
 		update_uniform_buffers(imageIndex);
+		m_frameStats.updateMilliseconds += get_milliseconds_since(stageStart);
+
+		stageStart = std::chrono::steady_clock::now();
 
 		// Submit a command buffer to queue, wait for semaphore and signal after
 		VkPipelineStageFlags pipelineWaitStages[]{	// Stages to wait at for the given semaphores
 			VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT
 		};
 
+		// Headless images are neither acquired nor presented, only the fence is needed
 		VkSubmitInfo submitInfo{
 			.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-			.waitSemaphoreCount = 1,
+			.waitSemaphoreCount = is_headless() ? 0u : 1u,
 			.pWaitSemaphores = &m_semaphoresImageAvailable[m_currentFrame],
 			.pWaitDstStageMask = pipelineWaitStages,
 			.commandBufferCount = 1,
 			.pCommandBuffers = &m_commandBuffers[imageIndex],
-			.signalSemaphoreCount = 1,		// This will be signaled when the command buffer is finished
+			.signalSemaphoreCount = is_headless() ? 0u : 1u,		// This will be signaled when the command buffer is finished
 			.pSignalSemaphores = &m_semaphoresRenderFinished[m_currentFrame],
 		};
 
 		// Submit commands to the queue, signal the fence so that the next access to the same frame can start rendering
-		VkResult result{ vkQueueSubmit(m_graphicsQueue, 1, &submitInfo, m_fencesDraw[m_currentFrame])};
+		VkResult result{ vkQueueSubmit(m_graphicsQueue, 1, &submitInfo, m_fencesDraw[m_currentFrame]) };
 		if (result != VK_SUCCESS)
 		{
 			throw std::runtime_error("Failed to subit command buffer to graphics queue!");
 		}
+		++m_frameNumber;
+
+		if (is_headless())
+		{
+			m_frameStats.submitMilliseconds = get_milliseconds_since(stageStart);
+			m_currentFrame = (m_currentFrame + 1) % MAX_FRAME_DRAWS;
+			return;
+		}
 
 		// Present rendered image to the screen
 		VkPresentInfoKHR presentInfo{
@@ -124,12 +241,45 @@ namespace VkCourse
 		};
 
 		result = vkQueuePresentKHR(m_presentationQueue, &presentInfo);
-		if (result != VK_SUCCESS)
+		m_frameStats.submitMilliseconds = get_milliseconds_since(stageStart);
+		m_currentFrame = (m_currentFrame + 1) % MAX_FRAME_DRAWS;
+		if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR)
+		{
+			recreate_swapchain();
+		}
+		else if (result != VK_SUCCESS)
 		{
 			throw std::runtime_error("Failed to present image!");
 		}
+	}
 
-		m_currentFrame = (m_currentFrame + 1) % MAX_FRAME_DRAWS;
+	bool VulkanRenderer::acquire_swapchain_image(uint32_t* imageIndex)
+	{
+		// Not every platform reports a resized window as out of date, so the size is compared too (with the size the
+		// swapchain was created for, its extent may have been clamped). Nothing is drawn while minimized
+		int width, height;
+		m_window->get_framebuffer_size(&width, &height);
+		if ((static_cast<uint32_t>(width) != m_swapchainFramebufferSize.width || static_cast<uint32_t>(height) != m_swapchainFramebufferSize.height)
+			&& !recreate_swapchain())
+		{
+			return false;
+		}
+
+		// Get a new image to render to, get a semaphore to know when the image is available
+		VkResult result{ vkAcquireNextImageKHR(m_device.logicalDevice, m_swapchain, std::numeric_limits<uint64_t>::max(), 
+			m_semaphoresImageAvailable[m_currentFrame], VK_NULL_HANDLE, imageIndex) };
+		if (result == VK_ERROR_OUT_OF_DATE_KHR)
+		{
+			// The semaphore wasn't signaled and the fence is still signaled, the frame can simply be skipped
+			recreate_swapchain();
+			return false;
+		}
+		if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR)		// Suboptimal still presents, it is recreated after
+		{
+			throw std::runtime_error("Failed to acquire a swapchain image!");
+		}
+
+		return true;
 	}
 
 	void VulkanRenderer::destroy()
@@ -138,6 +288,7 @@ namespace VkCourse
 		
 		// Wait for the device to be idle before destroying semaphores, command pools...
 		vkDeviceWaitIdle(m_device.logicalDevice);
+		finish_texture_streaming();
 
 		//_aligned_free(m_modelTransferSpace);
 		
@@ -160,51 +311,48 @@ namespace VkCourse
 			vkFreeMemory(m_device.logicalDevice, m_textureImageMemories[i], nullptr);
 		}
 
-		for (size_t i = 0; i < m_depthBufferImages.size(); ++i)
-		{
-			vkDestroyImageView(m_device.logicalDevice, m_depthBufferImageViews[i], nullptr);
-			vkDestroyImage(m_device.logicalDevice, m_depthBufferImages[i], nullptr);
-			vkFreeMemory(m_device.logicalDevice, m_depthBufferImageMemories[i], nullptr);
-		}
-
-		for (size_t i = 0; i < m_depthBufferImages.size(); ++i)
-		{
-			vkDestroyImageView(m_device.logicalDevice, m_colorBufferImageViews[i], nullptr);
-			vkDestroyImage(m_device.logicalDevice, m_colorBufferImages[i], nullptr);
-			vkFreeMemory(m_device.logicalDevice, m_colorBufferImageMemories[i], nullptr);
-		}
+		destroy_size_dependent_resources();
 
 		vkDestroyDescriptorPool(m_device.logicalDevice, m_descriptorPool, nullptr);
 		vkDestroyDescriptorSetLayout(m_device.logicalDevice, m_descriptorSetLayout, nullptr);
-		for (size_t i = 0; i < m_swapchainImages.size(); ++i)
+		for (size_t i = 0; i < m_vpUniformBuffers.size(); ++i)
 		{
 			vkDestroyBuffer(m_device.logicalDevice, m_vpUniformBuffers[i], nullptr);
 			vkFreeMemory(m_device.logicalDevice, m_vpUniformBufferMemories[i], nullptr);
 			//vkDestroyBuffer(m_device.logicalDevice, m_modelDynamicUniformBuffers[i], nullptr);
 			//vkFreeMemory(m_device.logicalDevice, m_modelDynamicUniformBufferMemories[i], nullptr);
 		}
+		vkDestroyQueryPool(m_device.logicalDevice, m_overdrawQueryPool, nullptr);
+		m_gpuProfiler.destroy();
 		for (size_t i = 0; i < MAX_FRAME_DRAWS; ++i) {
 			vkDestroySemaphore(m_device.logicalDevice, m_semaphoresRenderFinished[i], nullptr);
 			vkDestroySemaphore(m_device.logicalDevice, m_semaphoresImageAvailable[i], nullptr);
 			vkDestroyFence(m_device.logicalDevice, m_fencesDraw[i], nullptr);
 		}
+		vkDestroyFence(m_device.logicalDevice, m_textureUploadFence, nullptr);
 		vkDestroyCommandPool(m_device.logicalDevice, m_graphicsCommandPool, nullptr);
-		for (const auto& framebuffer : m_swapchainFramebuffers)
-		{
-			vkDestroyFramebuffer(m_device.logicalDevice, framebuffer, nullptr);
-		}
-		vkDestroyPipeline(m_device.logicalDevice, m_secondPipeline, nullptr);
+		m_frameReadback.destroy();
+		m_pipelineRegistry.destroy();
 		vkDestroyPipelineLayout(m_device.logicalDevice, m_secondPipelineLayout, nullptr);
-
-		vkDestroyPipeline(m_device.logicalDevice, m_graphicsPipeline, nullptr);
 		vkDestroyPipelineLayout(m_device.logicalDevice, m_pipelineLayout, nullptr);
 		vkDestroyRenderPass(m_device.logicalDevice, m_renderPass, nullptr);
-		for (const auto& image : m_swapchainImages)
+
+		// Failing to write the cache only means the next start compiles the pipelines again
+		m_pipelineCache.save();
+		m_pipelineCache.destroy();
+		if (is_headless())
 		{
-			vkDestroyImageView(m_device.logicalDevice, image.imageView, nullptr);
+			for (size_t i = 0; i < m_swapchainImages.size(); ++i)
+			{
+				vkDestroyImage(m_device.logicalDevice, m_swapchainImages[i].image, nullptr);
+				vkFreeMemory(m_device.logicalDevice, m_headlessImageMemories[i], nullptr);
+			}
+		}
+		else
+		{
+			vkDestroySwapchainKHR(m_device.logicalDevice, m_swapchain, nullptr);
+			vkDestroySurfaceKHR(m_instance, m_surface, nullptr);
 		}
-		vkDestroySwapchainKHR(m_device.logicalDevice, m_swapchain, nullptr);
-		vkDestroySurfaceKHR(m_instance, m_surface, nullptr);
 		vkDestroyDevice(m_device.logicalDevice, nullptr);
 		vkDestroyInstance(m_instance, nullptr);
 	}
@@ -216,6 +364,133 @@ namespace VkCourse
 		m_meshModels[modelId].set_model(modelMatrix);
 	}
 
+	void VulkanRenderer::update_view_matrix(glm::mat4 viewMatrix)
+	{
+		m_uboViewProjection.view = viewMatrix;
+	}
+
+	const InitStats& VulkanRenderer::get_init_stats() const
+	{
+		return m_initStats;
+	}
+
+	const FrameStats& VulkanRenderer::get_frame_stats() const
+	{
+		return m_frameStats;
+	}
+
+	const GpuProfiler& VulkanRenderer::get_gpu_profiler() const
+	{
+		return m_gpuProfiler;
+	}
+
+	uint64_t VulkanRenderer::get_device_memory_usage() const
+	{
+		if (!m_memoryBudgetSupported)
+		{
+			return 0;
+		}
+
+		VkPhysicalDeviceMemoryBudgetPropertiesEXT memoryBudgetProperties{
+			.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT,
+		};
+
+		VkPhysicalDeviceMemoryProperties2 memoryProperties{
+			.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2,
+			.pNext = &memoryBudgetProperties,
+		};
+		vkGetPhysicalDeviceMemoryProperties2(m_device.physicalDevice, &memoryProperties);
+
+		uint64_t usage{};
+		for (uint32_t i = 0; i < memoryProperties.memoryProperties.memoryHeapCount; ++i)
+		{
+			if (memoryProperties.memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)
+			{
+				usage += memoryBudgetProperties.heapUsage[i];
+			}
+		}
+		return usage;
+	}
+
+	std::string VulkanRenderer::get_device_name() const
+	{
+		VkPhysicalDeviceProperties properties;
+		vkGetPhysicalDeviceProperties(m_device.physicalDevice, &properties);
+		return properties.deviceName;
+	}
+
+	bool VulkanRenderer::is_headless() const
+	{
+		return m_window == nullptr;
+	}
+
+	void VulkanRenderer::set_readback_callback(ReadbackCallback callback)
+	{
+		if (callback && !m_swapchainReadable)
+		{
+			throw std::runtime_error("Swapchain images can't be read back on this surface!");
+		}
+
+		// Staging buffers of frames in flight can't be destroyed
+		vkDeviceWaitIdle(m_device.logicalDevice);
+		m_frameReadback.destroy();
+
+		m_readbackCallback = std::move(callback);
+		if (m_readbackCallback)
+		{
+			m_frameReadback.create(m_device.physicalDevice, m_device.logicalDevice, m_swapchainExtent, m_swapchainImageFormat,
+				MAX_FRAME_DRAWS);
+		}
+	}
+
+	bool VulkanRenderer::is_readback_active() const
+	{
+		return static_cast<bool>(m_readbackCallback);
+	}
+
+	const ImportProfile& VulkanRenderer::get_import_profile(size_t modelId) const
+	{
+		if (modelId >= m_meshModelImportProfiles.size())
+		{
+			throw std::runtime_error("Attempted to access invalid model id!");
+		}
+		return m_meshModelImportProfiles[modelId];
+	}
+
+	void VulkanRenderer::set_mesh_cache_enabled(bool enabled)
+	{
+		m_meshCacheEnabled = enabled;
+	}
+
+	void VulkanRenderer::set_texture_streaming_options(const TextureStreamingOptions& options)
+	{
+		m_textureStreamer.set_options(options);
+	}
+
+	void VulkanRenderer::set_material_constants(const MaterialConstants& constants)
+	{
+		m_materialConstants = constants;
+		m_pendingGraphicsPipelineId = m_pipelineRegistry.request(get_graphics_pipeline_description(false));
+		m_pendingGraphicsEqualPipelineId = m_pipelineRegistry.request(get_graphics_pipeline_description(true));
+	}
+
+	void VulkanRenderer::set_composition_constants(const CompositionConstants& constants)
+	{
+		m_compositionConstants = constants;
+		m_pendingSecondPipelineId = m_pipelineRegistry.request(get_second_pipeline_description());
+	}
+
+	void VulkanRenderer::set_depth_prepass_mode(DepthPrepassMode mode)
+	{
+		m_depthPrepassMode = mode;
+		m_framesSinceOverdrawMeasurement = OVERDRAW_MEASUREMENT_INTERVAL;		// Auto measures on the next frame
+	}
+
+	float VulkanRenderer::get_measured_overdraw() const
+	{
+		return m_measuredOverdraw;
+	}
+
 	void VulkanRenderer::create_instance()
 	{
 		// Mostly doesn't affect the application, can provide useful information to the driver/developer
@@ -231,11 +506,14 @@ namespace VkCourse
 		// We can store here all the extensions we need for the instance
 		std::vector<const char*> instanceRequiredExtensions{};
 
-		// Query for required extensions from the window, should be a list of names
-		const std::vector<const char*> windowRequiredExtensions{ m_window.get_required_extension_names() };
-		instanceRequiredExtensions.insert(instanceRequiredExtensions.end(),
-			windowRequiredExtensions.begin(),
-			windowRequiredExtensions.end());
+		// Query for required extensions from the window, should be a list of names (none when headless)
+		if (!is_headless())
+		{
+			const std::vector<const char*> windowRequiredExtensions{ m_window->get_required_extension_names() };
+			instanceRequiredExtensions.insert(instanceRequiredExtensions.end(),
+				windowRequiredExtensions.begin(),
+				windowRequiredExtensions.end());
+		}
 
 		if (!check_instance_extension_support(instanceRequiredExtensions))
 		{
@@ -297,18 +575,38 @@ namespace VkCourse
 			deviceQueueCreateInfos.push_back(deviceQueueCreateInfo);
 		}
 
+		// BC compressed textures are optional, cooked textures fall back to their source images without them
+		VkPhysicalDeviceFeatures supportedFeatures;
+		vkGetPhysicalDeviceFeatures(m_device.physicalDevice, &supportedFeatures);
+		m_textureCompressionBC = supportedFeatures.textureCompressionBC == VK_TRUE;
+		m_occlusionQueryPrecise = supportedFeatures.occlusionQueryPrecise == VK_TRUE;
+
 		// To set required features (for future use)
 		VkPhysicalDeviceFeatures requiredFeatures{
 			.samplerAnisotropy = VK_TRUE,
+			.textureCompressionBC = supportedFeatures.textureCompressionBC,
+			.occlusionQueryPrecise = supportedFeatures.occlusionQueryPrecise,
 		};
 
+		// Nothing is presented when headless. Device memory usage is reported where the driver supports it
+		std::vector<const char*> deviceExtensionNames{};
+		if (!is_headless())
+		{
+			deviceExtensionNames = requestedDeviceExtensionNames;
+		}
+		m_memoryBudgetSupported = check_device_extension_support(m_device.physicalDevice, { VK_EXT_MEMORY_BUDGET_EXTENSION_NAME });
+		if (m_memoryBudgetSupported)
+		{
+			deviceExtensionNames.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+		}
+
 		// Logical device (often called just "device" as opposed to "physical device")
 		VkDeviceCreateInfo deviceCreateInfo{
 			.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
 			.queueCreateInfoCount = static_cast<uint32_t>(deviceQueueCreateInfos.size()),
 			.pQueueCreateInfos = deviceQueueCreateInfos.data(),
-			.enabledExtensionCount = static_cast<uint32_t>(requestedDeviceExtensionNames.size()),
-			.ppEnabledExtensionNames = requestedDeviceExtensionNames.data(),
+			.enabledExtensionCount = static_cast<uint32_t>(deviceExtensionNames.size()),
+			.ppEnabledExtensionNames = deviceExtensionNames.data(),
 			.pEnabledFeatures = &requiredFeatures
 		};
 
@@ -328,7 +626,7 @@ namespace VkCourse
 	void VulkanRenderer::create_surface()
 	{
 		// Create a surface automatically with GLFW, runs the create surface function and returns the result
-		VkResult result{ glfwCreateWindowSurface(m_instance, m_window.get_window_handle(), nullptr, &m_surface) };
+		VkResult result{ glfwCreateWindowSurface(m_instance, m_window->get_window_handle(), nullptr, &m_surface) };
 		if (result != VK_SUCCESS)
 		{
 			throw std::runtime_error("Failed to create a surface!");
@@ -336,7 +634,7 @@ namespace VkCourse
 
 	}
 
-	void VulkanRenderer::create_swapchain()
+	void VulkanRenderer::create_swapchain(VkSwapchainKHR oldSwapchain)
 	{
 		// Get the swap chain details of the selected physical device
 		SwapchainDetails swapchainDetails{ get_swap_chain_details(m_device.physicalDevice) };
@@ -362,13 +660,14 @@ namespace VkCourse
 			.imageColorSpace = selectedSurfaceFormat.colorSpace,
 			.imageExtent = selectedExtent,
 			.imageArrayLayers = 1,
-			.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
+			.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT		// Copied from too for the readback, where supported
+				| (swapchainDetails.surfaceCapabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_SRC_BIT),
 			.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE,
 			.preTransform = swapchainDetails.surfaceCapabilities.currentTransform,
 			.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR,
 			.presentMode = selectedPresentationMode,
 			.clipped = VK_TRUE,
-			.oldSwapchain = VK_NULL_HANDLE	// If this swapchain replaces another one, this may aid in the resource reuse
+			.oldSwapchain = oldSwapchain	// If this swapchain replaces another one, this may aid in the resource reuse
 		};
 
 		// We need to check if the swapchain can work exclusively with one queue queue family or not
@@ -393,6 +692,10 @@ namespace VkCourse
 		// We save these values now that we know they are compatible ans we will use them in the future
 		m_swapchainImageFormat = selectedSurfaceFormat.format;
 		m_swapchainExtent = selectedExtent;
+		int framebufferWidth, framebufferHeight;
+		m_window->get_framebuffer_size(&framebufferWidth, &framebufferHeight);
+		m_swapchainFramebufferSize = { static_cast<uint32_t>(framebufferWidth), static_cast<uint32_t>(framebufferHeight) };
+		m_swapchainReadable = (swapchainCreateInfo.imageUsage & VK_IMAGE_USAGE_TRANSFER_SRC_BIT) != 0;
 
 		// Now we can fill the list of images that we can use from the swapchain
 		uint32_t createdSwapchainImageCount{};
@@ -400,12 +703,13 @@ namespace VkCourse
 		std::vector<VkImage> createdSwapchainImages(createdSwapchainImageCount);
 		vkGetSwapchainImagesKHR(m_device.logicalDevice, m_swapchain, &createdSwapchainImageCount, createdSwapchainImages.data());
 
+		m_swapchainImages.clear();
 		for (const auto& createdImage : createdSwapchainImages)
 		{
 			// Create corresponding image view to interface with the obtained swapchain image
 			SwapchainImage swapChainImage{
 				.image = createdImage,
-				.imageView = create_image_view(createdImage, m_swapchainImageFormat, VK_IMAGE_ASPECT_COLOR_BIT)
+				.imageView = create_image_view(createdImage, m_swapchainImageFormat, VK_IMAGE_ASPECT_COLOR_BIT, 1)
 			};
 
 			m_swapchainImages.push_back(swapChainImage);
@@ -413,18 +717,107 @@ namespace VkCourse
 
 	}
 
+	bool VulkanRenderer::recreate_swapchain()
+	{
+		int width, height;
+		m_window->get_framebuffer_size(&width, &height);
+		if (width == 0 || height == 0)
+		{
+			return false;		// Minimized, kept until the window has a size again
+		}
+
+		// Frames in flight still use the attachments
+		vkDeviceWaitIdle(m_device.logicalDevice);
+
+		// Frames read back at the old size are delivered before their buffers are resized
+		if (m_readbackCallback)
+		{
+			for (uint32_t i = 0; i < MAX_FRAME_DRAWS; ++i)
+			{
+				m_frameReadback.deliver((m_currentFrame + i) % MAX_FRAME_DRAWS, m_readbackCallback);
+			}
+			m_frameReadback.destroy();
+		}
+
+		// The render pass, the pipelines (dynamic viewport and scissor) and, unless the image count changes,
+		// everything per swapchain image that doesn't depend on its size are kept
+		const size_t swapchainImageCount{ m_swapchainImages.size() };
+		destroy_size_dependent_resources();
+
+		// Images acquired from the old swapchain can still be presented until it is destroyed
+		const VkSwapchainKHR oldSwapchain{ m_swapchain };
+		create_swapchain(oldSwapchain);
+		vkDestroySwapchainKHR(m_device.logicalDevice, oldSwapchain, nullptr);
+
+		create_color_buffer_image();
+		create_depth_buffer_image();
+		create_msaa_images();
+		create_framebuffers();
+		if (m_swapchainImages.size() != swapchainImageCount)
+		{
+			recreate_per_image_resources();
+		}
+		else
+		{
+			update_input_descriptor_sets();
+		}
+		update_projection();
+
+		// The new swapchain may not support being copied from (create_swapchain queried it again), the readback stops then
+		if (m_readbackCallback && !m_swapchainReadable)
+		{
+			m_readbackCallback = {};
+		}
+		if (m_readbackCallback)
+		{
+			m_frameReadback.create(m_device.physicalDevice, m_device.logicalDevice, m_swapchainExtent, m_swapchainImageFormat,
+				MAX_FRAME_DRAWS);
+		}
+
+		return true;
+	}
+
+	void VulkanRenderer::create_headless_images()
+	{
+		// Stand in for the swapchain images, the render pass leaves them ready to be copied
+		m_swapchainImageFormat = choose_supported_format(
+			{ VK_FORMAT_R8G8B8A8_UNORM, VK_FORMAT_B8G8R8A8_UNORM },
+			VK_IMAGE_TILING_OPTIMAL,
+			VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT | VK_FORMAT_FEATURE_TRANSFER_SRC_BIT
+		);
+		m_swapchainExtent = m_headlessExtent;
+		m_swapchainReadable = true;
+
+		m_headlessImageMemories.resize(MAX_FRAME_DRAWS);
+		for (size_t i = 0; i < MAX_FRAME_DRAWS; ++i)
+		{
+			const VkImage image{ create_image(m_swapchainExtent.width, m_swapchainExtent.height, 1, m_swapchainImageFormat,
+				VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &m_headlessImageMemories[i]) };
+
+			m_swapchainImages.push_back({
+				.image = image,
+				.imageView = create_image_view(image, m_swapchainImageFormat, VK_IMAGE_ASPECT_COLOR_BIT, 1)
+			});
+		}
+	}
+
 	void VulkanRenderer::create_render_pass()
 	{
+		// Render pass 2 structures, for the depth resolve of multisampled rendering
+		const bool multisampled{ m_msaaSamples != VK_SAMPLE_COUNT_1_BIT };
+
 		// Attachments
 		// SUBPASS 1 ATTACHMENTS + REFERENCES (INPUT ATTACHMENTS)
-		
-		std::array<VkSubpassDescription, 2> subpassDescriptions{};
 
-		// Color attachment (input)
-		VkAttachmentDescription colorInputAttachmentDescription{
+		std::array<VkSubpassDescription2, 2> subpassDescriptions{};
+
+		// Color attachment (input), written by the resolve when multisampled
+		VkAttachmentDescription2 colorInputAttachmentDescription{
+			.sType = VK_STRUCTURE_TYPE_ATTACHMENT_DESCRIPTION_2,
 			.format = m_colorBufferFormat,
 			.samples = VK_SAMPLE_COUNT_1_BIT,
-			.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+			.loadOp = multisampled ? VK_ATTACHMENT_LOAD_OP_DONT_CARE : VK_ATTACHMENT_LOAD_OP_CLEAR,
 			.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,		// Don't care because this refers to the end of the renderpass
 			.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
 			.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
@@ -432,11 +825,12 @@ namespace VkCourse
 			.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
 		};
 
-		// Depth attachment (input)
-		VkAttachmentDescription depthInputAttachmentDescription{
+		// Depth attachment (input), written by the resolve when multisampled
+		VkAttachmentDescription2 depthInputAttachmentDescription{
+			.sType = VK_STRUCTURE_TYPE_ATTACHMENT_DESCRIPTION_2,
 			.format = m_depthBufferFormat,
 			.samples = VK_SAMPLE_COUNT_1_BIT,
-			.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+			.loadOp = multisampled ? VK_ATTACHMENT_LOAD_OP_DONT_CARE : VK_ATTACHMENT_LOAD_OP_CLEAR,
 			.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
 			.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
 			.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
@@ -444,27 +838,72 @@ namespace VkCourse
 			.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
 		};
 
-		VkAttachmentReference colorInputAttachmentReference{
+		VkAttachmentReference2 colorInputAttachmentReference{
+			.sType = VK_STRUCTURE_TYPE_ATTACHMENT_REFERENCE_2,
 			.attachment = 1,
 			.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+			.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
 		};
 
-		VkAttachmentReference depthInputAttachmentReference{
+		VkAttachmentReference2 depthInputAttachmentReference{
+			.sType = VK_STRUCTURE_TYPE_ATTACHMENT_REFERENCE_2,
 			.attachment = 2,
 			.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+			.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT,
 		};
 
-		subpassDescriptions[0] = {
-			.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
-			.colorAttachmentCount = 1,
-			.pColorAttachments = &colorInputAttachmentReference,
-			.pDepthStencilAttachment = &depthInputAttachmentReference,
+		// Multisampled attachments, only live during the first subpass (transient, they can stay in tile memory)
+		VkAttachmentDescription2 msaaColorAttachmentDescription{ colorInputAttachmentDescription };
+		msaaColorAttachmentDescription.samples = m_msaaSamples;
+		msaaColorAttachmentDescription.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+
+		VkAttachmentDescription2 msaaDepthAttachmentDescription{ depthInputAttachmentDescription };
+		msaaDepthAttachmentDescription.samples = m_msaaSamples;
+		msaaDepthAttachmentDescription.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+
+		VkAttachmentReference2 msaaColorAttachmentReference{ colorInputAttachmentReference };
+		msaaColorAttachmentReference.attachment = 3;
+
+		VkAttachmentReference2 msaaDepthAttachmentReference{ depthInputAttachmentReference };
+		msaaDepthAttachmentReference.attachment = 4;
+
+		// The depth buffer read by the composition is sample 0 of the multisampled one (supported by every device)
+		VkSubpassDescriptionDepthStencilResolve depthStencilResolve{
+			.sType = VK_STRUCTURE_TYPE_SUBPASS_DESCRIPTION_DEPTH_STENCIL_RESOLVE,
+			.depthResolveMode = VK_RESOLVE_MODE_SAMPLE_ZERO_BIT,
+			.stencilResolveMode = VK_RESOLVE_MODE_NONE,
+			.pDepthStencilResolveAttachment = &depthInputAttachmentReference,
 		};
 
+		if (multisampled)
+		{
+			// Rendered multisampled, resolved into the input attachments at the end of the subpass
+			subpassDescriptions[0] = {
+				.sType = VK_STRUCTURE_TYPE_SUBPASS_DESCRIPTION_2,
+				.pNext = &depthStencilResolve,
+				.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
+				.colorAttachmentCount = 1,
+				.pColorAttachments = &msaaColorAttachmentReference,
+				.pResolveAttachments = &colorInputAttachmentReference,
+				.pDepthStencilAttachment = &msaaDepthAttachmentReference,
+			};
+		}
+		else
+		{
+			subpassDescriptions[0] = {
+				.sType = VK_STRUCTURE_TYPE_SUBPASS_DESCRIPTION_2,
+				.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
+				.colorAttachmentCount = 1,
+				.pColorAttachments = &colorInputAttachmentReference,
+				.pDepthStencilAttachment = &depthInputAttachmentReference,
+			};
+		}
+
 		// SUBPASS 2 ATTACHMENTS + REFERENCES
 
 		// Swapchain color attachment of render pass
-		VkAttachmentDescription swapchainColorAttachmentDescription{
+		VkAttachmentDescription2 swapchainColorAttachmentDescription{
+			.sType = VK_STRUCTURE_TYPE_ATTACHMENT_DESCRIPTION_2,
 			.format = m_swapchainImageFormat,
 			.samples = VK_SAMPLE_COUNT_1_BIT,					// Number of samples to write for multisampling
 			.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,				// What to do before rendering
@@ -472,16 +911,19 @@ namespace VkCourse
 			.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
 			.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
 			.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-			.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,		// Format to present to surface
+			.finalLayout = is_headless() ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL		// Ready to be read back
+				: VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,		// Format to present to surface
 		};
 
 		// Attachment reference uses an index to refer to the attachment passed to the renderPassCreateInfo
-		VkAttachmentReference swapchainColorAttachmentReference{
+		VkAttachmentReference2 swapchainColorAttachmentReference{
+			.sType = VK_STRUCTURE_TYPE_ATTACHMENT_REFERENCE_2,
 			.attachment = 0,
 			.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+			.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
 		};
 
-		std::array<VkAttachmentReference, 2> inputAttachmentReferences{
+		std::array<VkAttachmentReference2, 2> inputAttachmentReferences{
 			colorInputAttachmentReference,
 			depthInputAttachmentReference,
 		};
@@ -490,6 +932,7 @@ namespace VkCourse
 		inputAttachmentReferences[1].layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 
 		subpassDescriptions[1] = {
+			.sType = VK_STRUCTURE_TYPE_SUBPASS_DESCRIPTION_2,
 			.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
 			.inputAttachmentCount = static_cast<uint32_t>(inputAttachmentReferences.size()),
 			.pInputAttachments = inputAttachmentReferences.data(),
@@ -500,9 +943,10 @@ namespace VkCourse
 		// SUBPASS DEPENDENCIES
 
 		// Need to determine when layout transitions occur using subpass dependencies
-		std::array<VkSubpassDependency, 3> subpassDependencies{};
+		std::array<VkSubpassDependency2, 3> subpassDependencies{};
 		
 		// Transition must happen after...
+		subpassDependencies[0].sType = VK_STRUCTURE_TYPE_SUBPASS_DEPENDENCY_2;
 		subpassDependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
 		subpassDependencies[0].srcStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;		// This stage has to happen before the transition
 		subpassDependencies[0].srcAccessMask = VK_ACCESS_MEMORY_READ_BIT;				// It has to be read from, before the conversion
@@ -512,35 +956,44 @@ namespace VkCourse
 		subpassDependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
 		subpassDependencies[0].dependencyFlags = 0;
 
-		// Subpass 1 layout (color/depth) to subpass 2 layout (shader read)
+		// Subpass 1 layout (color/depth) to subpass 2 layout (shader read). Resolves are color attachment writes,
+		// and each pixel only reads its own inputs, so tilers can keep everything in tile memory
+		subpassDependencies[1].sType = VK_STRUCTURE_TYPE_SUBPASS_DEPENDENCY_2;
 		subpassDependencies[1].srcSubpass = 0;
-		subpassDependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-		subpassDependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		subpassDependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+		subpassDependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
 
 		subpassDependencies[1].dstSubpass = 1;
 		subpassDependencies[1].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-		subpassDependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-		subpassDependencies[1].dependencyFlags = 0;
+		subpassDependencies[1].dstAccessMask = VK_ACCESS_INPUT_ATTACHMENT_READ_BIT;
+		subpassDependencies[1].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
 
 		// Transition must happen after...
+		subpassDependencies[2].sType = VK_STRUCTURE_TYPE_SUBPASS_DEPENDENCY_2;
 		subpassDependencies[2].srcSubpass = 1;
 		subpassDependencies[2].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
 		subpassDependencies[2].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
 		// Transition must happen before...
 		subpassDependencies[2].dstSubpass = VK_SUBPASS_EXTERNAL;
-		subpassDependencies[2].dstStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
-		subpassDependencies[2].dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+		subpassDependencies[2].dstStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT;		// Readback copy
+		subpassDependencies[2].dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT;
 		subpassDependencies[2].dependencyFlags = 0;
 
-
-		std::array<VkAttachmentDescription, 3> renderPassAttachmentDescriptions{
+		// Same indices as the framebuffer attachments, the multisampled ones last
+		std::vector<VkAttachmentDescription2> renderPassAttachmentDescriptions{
 			swapchainColorAttachmentDescription,
 			colorInputAttachmentDescription,
 			depthInputAttachmentDescription,
 		};
 
-		VkRenderPassCreateInfo renderPassCreateInfo{
-			.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
+		if (multisampled)
+		{
+			renderPassAttachmentDescriptions.push_back(msaaColorAttachmentDescription);
+			renderPassAttachmentDescriptions.push_back(msaaDepthAttachmentDescription);
+		}
+
+		VkRenderPassCreateInfo2 renderPassCreateInfo{
+			.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO_2,
 			.attachmentCount = static_cast<uint32_t>(renderPassAttachmentDescriptions.size()),
 			.pAttachments = renderPassAttachmentDescriptions.data(),
 			.subpassCount = static_cast<uint32_t>(subpassDescriptions.size()),
@@ -549,7 +1002,7 @@ namespace VkCourse
 			.pDependencies = subpassDependencies.data(),
 		};
 
-		VkResult result{ vkCreateRenderPass(m_device.logicalDevice, &renderPassCreateInfo, nullptr, &m_renderPass) };
+		VkResult result{ vkCreateRenderPass2(m_device.logicalDevice, &renderPassCreateInfo, nullptr, &m_renderPass) };
 		if (result != VK_SUCCESS)
 		{
 			throw std::runtime_error("Failed to create a render pass!");
@@ -659,156 +1112,6 @@ namespace VkCourse
 
 	void VulkanRenderer::create_graphics_pipeline()
 	{
-		// Read already compiled SPIR-V shaders
-		std::vector<char> vertexShaderCode{ read_file("Shaders/shader_vert.spv") };
-		std::vector<char> fragmentShaderCode{ read_file("Shaders/shader_frag.spv") };
-
-		// Build shader modules to link to graphics pipeline
-		VkShaderModule vertexShaderModule{ create_shader_module(vertexShaderCode) };
-		VkShaderModule fragmentShaderModule{ create_shader_module(fragmentShaderCode) };
-
-		// Configure stages of the pipeline with create infos
-		VkPipelineShaderStageCreateInfo vertexShaderStageCreateInfo{
-			.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
-			.stage = VK_SHADER_STAGE_VERTEX_BIT,
-			.module = vertexShaderModule,
-			.pName = "main"
-		};
-
-		VkPipelineShaderStageCreateInfo fragmentShaderStageCreateInfo{
-			.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
-			.stage = VK_SHADER_STAGE_FRAGMENT_BIT,
-			.module = fragmentShaderModule,
-			.pName = "main"
-		};
-
-		VkPipelineShaderStageCreateInfo shaderStages[]{ 
-			vertexShaderStageCreateInfo, 
-			fragmentShaderStageCreateInfo 
-		};
-
-		// How the data for a single vertex (position, color, etc.) is as a whole
-		VkVertexInputBindingDescription vertexInputBindingDescription{
-			.binding = 0,								// Can bind multiple streams of data, this defines which one
-			.stride = sizeof(Vertex),
-			.inputRate = VK_VERTEX_INPUT_RATE_VERTEX,	// How to move between data after each vertex (in this case, next vertex)
-		};
-
-		// How the data for an attribute is defined within a vertex
-		std::array<VkVertexInputAttributeDescription, 3> vertexInputAttributeDescriptions{};
-		// Position
-		vertexInputAttributeDescriptions[0] = {
-			.location = 0,							// Should match in the vertex shader
-			.binding = 0,							// Should be same as above (unless multiple streams of data)
-			.format = VK_FORMAT_R32G32B32_SFLOAT,	// Format the data will take + size
-			.offset = offsetof(Vertex, position),
-		};
-		// Color
-		vertexInputAttributeDescriptions[1] = {
-			.location = 1,
-			.binding = 0,
-			.format = VK_FORMAT_R32G32B32_SFLOAT,
-			.offset = offsetof(Vertex, color),
-		};
-		vertexInputAttributeDescriptions[2] = {
-			.location = 2,
-			.binding = 0,
-			.format = VK_FORMAT_R32G32_SFLOAT,
-			.offset = offsetof(Vertex, texCoords),
-		};
-
-		// -- Vertex input --
-		VkPipelineVertexInputStateCreateInfo vertexInputStateCreateInfo{
-			.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
-			.vertexBindingDescriptionCount = 1,
-			.pVertexBindingDescriptions = &vertexInputBindingDescription,				// e.g. data spacing, stride...
-			.vertexAttributeDescriptionCount = static_cast<uint32_t>(vertexInputAttributeDescriptions.size()),
-			.pVertexAttributeDescriptions = vertexInputAttributeDescriptions.data(),	// data format, where to bind to/from
-		};
-
-		// -- Input Assembly --
-		VkPipelineInputAssemblyStateCreateInfo inputAssemblyStateCreateInfo{
-			.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
-			.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
-			.primitiveRestartEnable = VK_FALSE		// Used for strip topology to start new primitives
-		};
-
-		// -- Viewport and scissor --
-		VkViewport viewport{
-			.x = 0.f,
-			.y = 0.f,
-			.width = static_cast<float>(m_swapchainExtent.width),
-			.height = static_cast<float>(m_swapchainExtent.height),
-			.minDepth = 0.f,
-			.maxDepth = 1.f
-		};
-
-		VkRect2D scissor{
-			.offset = { 0, 0 },
-			.extent = m_swapchainExtent,
-		};
-
-		VkPipelineViewportStateCreateInfo viewportStateCreateInfo{
-			.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
-			.viewportCount = 1,
-			.pViewports = &viewport,
-			.scissorCount = 1,
-			.pScissors = &scissor,
-		};
-
-		// -- Dynamic state -- (don't need to resize now)
-		//std::vector<VkDynamicState> dynamicStateEnables{};
-		//dynamicStateEnables.push_back(VK_DYNAMIC_STATE_VIEWPORT);	// Dynamic viewport (can resize in command buffer with vkCmdSetViewport)
-		//dynamicStateEnables.push_back(VK_DYNAMIC_STATE_SCISSOR);	// Dynamic scissor	(can resize in command buffer with vkCmdSetScissor)
-
-		//VkPipelineDynamicStateCreateInfo dynamicStateCreateInfo{
-		//	.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
-		//	.dynamicStateCount = static_cast<uint32_t>(dynamicStateEnables.size()),
-		//	.pDynamicStates = dynamicStateEnables.data(),
-		//};
-
-		// -- Rasterizer --
-		VkPipelineRasterizationStateCreateInfo rasterizationStateCreateInfo{
-			.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
-			.depthClampEnable = VK_FALSE,			// Change if fragments beyond near/far planes are clipped or clamped to plane
-			.rasterizerDiscardEnable = VK_FALSE,	// Discard primitives before fragment shader
-			.polygonMode = VK_POLYGON_MODE_FILL,
-			.cullMode = VK_CULL_MODE_BACK_BIT,
-			.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE,	// Due to Vulkan inverted coordinate system
-			.depthBiasEnable = VK_FALSE,
-			.lineWidth = 1.f,
-		};
-
-		// -- Multisampling --
-		VkPipelineMultisampleStateCreateInfo multisampleStateCreateInfo{
-			.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
-			.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT,
-			.sampleShadingEnable = VK_FALSE,
-		};
-
-		// -- Blending --
-		// ---- Blending eq: (srcColorBlendFactor * new color) colorBlendOp (dstColorBlendFactor * old color)
-		VkPipelineColorBlendAttachmentState colorBlendAttachmentState{
-			.blendEnable = VK_TRUE,
-			.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA,
-			.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA,
-			.colorBlendOp = VK_BLEND_OP_ADD,
-			.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE,
-			.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO,
-			.alphaBlendOp = VK_BLEND_OP_ADD,
-			.colorWriteMask = VK_COLOR_COMPONENT_R_BIT
-							| VK_COLOR_COMPONENT_G_BIT
-							| VK_COLOR_COMPONENT_B_BIT
-							| VK_COLOR_COMPONENT_A_BIT,
-		};
-
-		VkPipelineColorBlendStateCreateInfo colorBlendStateCreateInfo{
-			.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
-			.logicOpEnable = VK_FALSE,		// Alternative to calculations
-			.attachmentCount = 1,
-			.pAttachments = &colorBlendAttachmentState,
-		};
-
 		// -- Layout --
 		std::array<VkDescriptorSetLayout, 2> descriptorSetLayouts{ m_descriptorSetLayout, m_samplerSetLayout };
 
@@ -826,95 +1129,106 @@ namespace VkCourse
 			throw std::runtime_error("Failed to create pipeline layout!");
 		}
 
-		VkPipelineDepthStencilStateCreateInfo depthStencilStateCreateInfo{
-			.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO,
-			.depthTestEnable = VK_TRUE,
-			.depthWriteEnable = VK_TRUE,
-			.depthCompareOp = VK_COMPARE_OP_LESS,
-			.depthBoundsTestEnable = VK_FALSE,			// Check depth value is between bounds
-			.stencilTestEnable = VK_FALSE,
-		};
-		
-		// Final graphics pipeline
-		VkGraphicsPipelineCreateInfo graphicsPipelineCreateInfo{
-			.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
-			.stageCount = 2,
-			.pStages = shaderStages,
-			.pVertexInputState = &vertexInputStateCreateInfo,
-			.pInputAssemblyState = &inputAssemblyStateCreateInfo,
-			.pViewportState = &viewportStateCreateInfo,
-			.pRasterizationState = &rasterizationStateCreateInfo,
-			.pMultisampleState = &multisampleStateCreateInfo,
-			.pDepthStencilState = &depthStencilStateCreateInfo,
-			.pColorBlendState = &colorBlendStateCreateInfo,
-			.pDynamicState = nullptr,
-			.layout = m_pipelineLayout,
-			.renderPass = m_renderPass,
-			.subpass = 0,
-			.basePipelineHandle = VK_NULL_HANDLE,	// Used to create pipelines based on other pipelines
-			.basePipelineIndex = -1,
+		VkPipelineLayoutCreateInfo secondPipelineLayoutCreateInfo{
+			.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+			.setLayoutCount = 1,
+			.pSetLayouts = &m_inputAttachmentSetLayout,
+			.pushConstantRangeCount = 0,
+			.pPushConstantRanges = nullptr,
 		};
 
-		result = vkCreateGraphicsPipelines(m_device.logicalDevice, VK_NULL_HANDLE, 1, &graphicsPipelineCreateInfo, nullptr, &m_graphicsPipeline);
+		result = vkCreatePipelineLayout(m_device.logicalDevice, &secondPipelineLayoutCreateInfo, nullptr, &m_secondPipelineLayout);
 		if (result != VK_SUCCESS)
 		{
-			throw std::runtime_error("Failed to create a pipeline!");
+			throw std::runtime_error("Failed to create second pipeline layout!");
 		}
 
-		// Destroy shader modules (no longer needed after pipeline has been created)
-		vkDestroyShaderModule(m_device.logicalDevice, fragmentShaderModule, nullptr);
-		vkDestroyShaderModule(m_device.logicalDevice, vertexShaderModule, nullptr);
-
-		// Create second pass pipeline
-		auto secondVertexShaderCode{ read_file("Shaders/second_vert.spv") };
-		auto secondFragmentShaderCode{ read_file("Shaders/second_frag.spv") };
-
-		VkShaderModule secondVertexShaderModule{ create_shader_module(secondVertexShaderCode) };
-		VkShaderModule secondFragmentShaderModule{ create_shader_module(secondFragmentShaderCode) };
-
-		vertexShaderStageCreateInfo.module = secondVertexShaderModule;
-		fragmentShaderStageCreateInfo.module = secondFragmentShaderModule;
+		const GraphicsPipelineDescription graphicsPipelineDescription{ get_graphics_pipeline_description(false) };
+
+		// Depth only variant (depth prepasses, shadow maps), it only fetches the position stream.
+		// No fragment shader, so the color attachment must not be written
+		GraphicsPipelineDescription depthPipelineDescription{ graphicsPipelineDescription };
+		depthPipelineDescription.vertexShader = ShaderCode::DEPTH_VERT;
+		depthPipelineDescription.fragmentShader = {};
+		depthPipelineDescription.specializationConstants.clear();
+		depthPipelineDescription.vertexBindings = get_vertex_binding_descriptions(m_vertexFormat, true);
+		depthPipelineDescription.vertexAttributes = get_vertex_attribute_descriptions(m_vertexFormat, true);
+		depthPipelineDescription.alphaBlend = false;
+		depthPipelineDescription.colorWriteMask = 0;
+
+		// Every pipeline compiles at the same time, then we wait for all of them
+		const size_t graphicsPipelineId{ m_pipelineRegistry.request(graphicsPipelineDescription) };
+		const size_t graphicsEqualPipelineId{ m_pipelineRegistry.request(get_graphics_pipeline_description(true)) };
+		const size_t depthPipelineId{ m_pipelineRegistry.request(depthPipelineDescription) };
+		const size_t secondPipelineId{ m_pipelineRegistry.request(get_second_pipeline_description()) };
+
+		m_graphicsPipeline = m_pipelineRegistry.get(graphicsPipelineId);
+		m_graphicsEqualPipeline = m_pipelineRegistry.get(graphicsEqualPipelineId);
+		m_depthPipeline = m_pipelineRegistry.get(depthPipelineId);
+		m_secondPipeline = m_pipelineRegistry.get(secondPipelineId);
+	}
 
-		VkPipelineShaderStageCreateInfo secondShaderStageCreateInfos[] = {
-			vertexShaderStageCreateInfo,
-			fragmentShaderStageCreateInfo,
+	GraphicsPipelineDescription VulkanRenderer::get_graphics_pipeline_description(bool afterDepthPrepass) const
+	{
+		// First subpass, one binding per vertex stream (positions, then the other attributes).
+		// After a depth prepass the depth buffer already holds the closest fragments, only those pass an EQUAL test
+		// (same position math in both vertex shaders, see invariant gl_Position)
+		return {
+			.vertexShader = ShaderCode::SHADER_VERT,
+			.fragmentShader = ShaderCode::SHADER_FRAG,
+			.specializationConstants = {
+				m_materialConstants.textured ? VK_TRUE : VK_FALSE,
+			},
+			.vertexBindings = get_vertex_binding_descriptions(m_vertexFormat, false),
+			.vertexAttributes = get_vertex_attribute_descriptions(m_vertexFormat, false),
+			.samples = m_msaaSamples,
+			.depthWrite = !afterDepthPrepass,
+			.depthCompareOp = afterDepthPrepass ? VK_COMPARE_OP_EQUAL : VK_COMPARE_OP_LESS,
+			.layout = m_pipelineLayout,
+			.renderPass = m_renderPass,
+			.subpass = 0,
 		};
+	}
 
-		// No vertex data second pass
-		vertexInputStateCreateInfo.vertexBindingDescriptionCount = 0;
-		vertexInputStateCreateInfo.pVertexBindingDescriptions = nullptr;
-		vertexInputStateCreateInfo.vertexAttributeDescriptionCount = 0;
-		vertexInputStateCreateInfo.pVertexAttributeDescriptions = nullptr;
-
-		// Don't want to write to depth buffer
-		depthStencilStateCreateInfo.depthWriteEnable = VK_FALSE;
-
-		VkPipelineLayoutCreateInfo secondPipelineLayoutCreateInfo{
-			.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
-			.setLayoutCount = 1,
-			.pSetLayouts = &m_inputAttachmentSetLayout,
-			.pushConstantRangeCount = 0,
-			.pPushConstantRanges = nullptr,
+	GraphicsPipelineDescription VulkanRenderer::get_second_pipeline_description() const
+	{
+		// Second pass, no vertex data and don't want to write to depth buffer
+		return {
+			.vertexShader = ShaderCode::SECOND_VERT,
+			.fragmentShader = ShaderCode::SECOND_FRAG,
+			.specializationConstants = {
+				m_compositionConstants.showDepth ? VK_TRUE : VK_FALSE,
+				std::bit_cast<uint32_t>(m_compositionConstants.split),
+				std::bit_cast<uint32_t>(m_compositionConstants.depthLowerBound),
+				std::bit_cast<uint32_t>(m_compositionConstants.depthUpperBound),
+			},
+			.depthWrite = false,
+			.layout = m_secondPipelineLayout,
+			.renderPass = m_renderPass,
+			.subpass = 1,
 		};
+	}
 
-		result = vkCreatePipelineLayout(m_device.logicalDevice, &secondPipelineLayoutCreateInfo, nullptr, &m_secondPipelineLayout);
-		if (result != VK_SUCCESS)
+	void VulkanRenderer::update_pipeline_variants()
+	{
+		// Variants are swapped in once compiled, frames in flight keep using the previous ones (owned by the registry)
+		if (m_pendingGraphicsPipelineId != SIZE_MAX && m_pipelineRegistry.is_ready(m_pendingGraphicsPipelineId))
 		{
-			throw std::runtime_error("Failed to create second pipeline layout!");
+			m_graphicsPipeline = m_pipelineRegistry.get(m_pendingGraphicsPipelineId);
+			m_pendingGraphicsPipelineId = SIZE_MAX;
 		}
 
-		graphicsPipelineCreateInfo.pStages = secondShaderStageCreateInfos;
-		graphicsPipelineCreateInfo.layout = m_secondPipelineLayout;
-		graphicsPipelineCreateInfo.subpass = 1;
-
-		result = vkCreateGraphicsPipelines(m_device.logicalDevice, VK_NULL_HANDLE, 1, &graphicsPipelineCreateInfo, nullptr, &m_secondPipeline);
-		if (result != VK_SUCCESS)
+		if (m_pendingGraphicsEqualPipelineId != SIZE_MAX && m_pipelineRegistry.is_ready(m_pendingGraphicsEqualPipelineId))
 		{
-			throw std::runtime_error("Failed to create second graphics pipeline!");
+			m_graphicsEqualPipeline = m_pipelineRegistry.get(m_pendingGraphicsEqualPipelineId);
+			m_pendingGraphicsEqualPipelineId = SIZE_MAX;
 		}
 
-		vkDestroyShaderModule(m_device.logicalDevice, secondVertexShaderModule, nullptr);
-		vkDestroyShaderModule(m_device.logicalDevice, secondFragmentShaderModule, nullptr);
+		if (m_pendingSecondPipelineId != SIZE_MAX && m_pipelineRegistry.is_ready(m_pendingSecondPipelineId))
+		{
+			m_secondPipeline = m_pipelineRegistry.get(m_pendingSecondPipelineId);
+			m_pendingSecondPipelineId = SIZE_MAX;
+		}
 	}
 
 	void VulkanRenderer::create_color_buffer_image()
@@ -931,11 +1245,11 @@ namespace VkCourse
 
 		for (size_t i = 0; i < m_swapchainImages.size(); ++i)
 		{
-			m_colorBufferImages[i] = create_image(m_swapchainExtent.width, m_swapchainExtent.height,
+			m_colorBufferImages[i] = create_image(m_swapchainExtent.width, m_swapchainExtent.height, 1,
 				m_colorBufferFormat, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT,
 				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &m_colorBufferImageMemories[i]);
 
-			m_colorBufferImageViews[i] = create_image_view(m_colorBufferImages[i], m_colorBufferFormat, VK_IMAGE_ASPECT_COLOR_BIT);
+			m_colorBufferImageViews[i] = create_image_view(m_colorBufferImages[i], m_colorBufferFormat, VK_IMAGE_ASPECT_COLOR_BIT, 1);
 		}
 	}
 
@@ -954,11 +1268,40 @@ namespace VkCourse
 
 		for (size_t i = 0; i < m_swapchainImages.size(); ++i)
 		{
-			m_depthBufferImages[i] = create_image(m_swapchainExtent.width, m_swapchainExtent.height,
+			m_depthBufferImages[i] = create_image(m_swapchainExtent.width, m_swapchainExtent.height, 1,
 				m_depthBufferFormat, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT,
 				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &m_depthBufferImageMemories[i]);
 
-			m_depthBufferImageViews[i] = create_image_view(m_depthBufferImages[i], m_depthBufferFormat, VK_IMAGE_ASPECT_DEPTH_BIT);
+			m_depthBufferImageViews[i] = create_image_view(m_depthBufferImages[i], m_depthBufferFormat, VK_IMAGE_ASPECT_DEPTH_BIT, 1);
+		}
+	}
+
+	void VulkanRenderer::create_msaa_images()
+	{
+		if (m_msaaSamples == VK_SAMPLE_COUNT_1_BIT)
+		{
+			return;
+		}
+
+		m_msaaColorImages.resize(m_swapchainImages.size());
+		m_msaaColorImageMemories.resize(m_swapchainImages.size());
+		m_msaaColorImageViews.resize(m_swapchainImages.size());
+		m_msaaDepthImages.resize(m_swapchainImages.size());
+		m_msaaDepthImageMemories.resize(m_swapchainImages.size());
+		m_msaaDepthImageViews.resize(m_swapchainImages.size());
+
+		// Only written and resolved within the render pass, so never stored (lazily allocated memory where there is some)
+		for (size_t i = 0; i < m_swapchainImages.size(); ++i)
+		{
+			m_msaaColorImages[i] = create_image(m_swapchainExtent.width, m_swapchainExtent.height, 1,
+				m_colorBufferFormat, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &m_msaaColorImageMemories[i], m_msaaSamples);
+			m_msaaColorImageViews[i] = create_image_view(m_msaaColorImages[i], m_colorBufferFormat, VK_IMAGE_ASPECT_COLOR_BIT, 1);
+
+			m_msaaDepthImages[i] = create_image(m_swapchainExtent.width, m_swapchainExtent.height, 1,
+				m_depthBufferFormat, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &m_msaaDepthImageMemories[i], m_msaaSamples);
+			m_msaaDepthImageViews[i] = create_image_view(m_msaaDepthImages[i], m_depthBufferFormat, VK_IMAGE_ASPECT_DEPTH_BIT, 1);
 		}
 	}
 
@@ -968,12 +1311,18 @@ namespace VkCourse
 		m_swapchainFramebuffers.resize(m_swapchainImages.size());
 		for (size_t i = 0; i < m_swapchainFramebuffers.size(); ++i)
 		{
-			std::array<VkImageView, 3> attachments{
+			std::vector<VkImageView> attachments{
 				m_swapchainImages[i].imageView,
 				m_colorBufferImageViews[i],
 				m_depthBufferImageViews[i]
 			};
 
+			if (m_msaaSamples != VK_SAMPLE_COUNT_1_BIT)
+			{
+				attachments.push_back(m_msaaColorImageViews[i]);
+				attachments.push_back(m_msaaDepthImageViews[i]);
+			}
+
 			VkFramebufferCreateInfo framebufferCreateInfo{
 				.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
 				.renderPass = m_renderPass,										// Render pass the framebuffer will be used with
@@ -1058,6 +1407,38 @@ namespace VkCourse
 				throw std::runtime_error("Failed to create a fence!");
 			}
 		}
+
+		fenceCreateInfo.flags = 0;
+		if (vkCreateFence(m_device.logicalDevice, &fenceCreateInfo, nullptr, &m_textureUploadFence) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create a fence!");
+		}
+	}
+
+	void VulkanRenderer::create_query_pool()
+	{
+		create_overdraw_query_pool();
+
+		// Timestamps, one pool per frame in flight, read once the frame's fence has been waited for
+		m_gpuProfiler.create(m_device.physicalDevice, m_device.logicalDevice, m_queueFamilyIndices.graphicsFamily, MAX_FRAME_DRAWS);
+	}
+
+	void VulkanRenderer::create_overdraw_query_pool()
+	{
+		// Two per swapchain image
+		VkQueryPoolCreateInfo queryPoolCreateInfo{
+			.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+			.queryType = VK_QUERY_TYPE_OCCLUSION,
+			.queryCount = static_cast<uint32_t>(2 * m_swapchainImages.size()),
+		};
+
+		VkResult result{ vkCreateQueryPool(m_device.logicalDevice, &queryPoolCreateInfo, nullptr, &m_overdrawQueryPool) };
+		if (result != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create the overdraw query pool!");
+		}
+
+		m_overdrawQueriesRecorded.assign(m_swapchainImages.size(), false);
 	}
 
 	void VulkanRenderer::create_texture_sampler()
@@ -1074,7 +1455,7 @@ namespace VkCourse
 			.anisotropyEnable = VK_TRUE,
 			.maxAnisotropy = 16.f,
 			.minLod = 0.f,
-			.maxLod = 0.f,
+			.maxLod = VK_LOD_CLAMP_NONE,						// Use every mip level the image has
 			.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK,
 			.unnormalizedCoordinates = VK_FALSE,				// Normalized coordinates (true) between 0-1 and not 0-size of image
 		};
@@ -1112,6 +1493,34 @@ namespace VkCourse
 
 	void VulkanRenderer::create_descriptor_pool()
 	{
+		create_per_image_descriptor_pools();
+
+		// SAMPLER DESCRIPTOR POOL
+		// Texture streaming replaces a set while the old one is still used by frames in flight, so there is room for
+		// one replacement per texture
+		VkDescriptorPoolSize samplerPoolSize{
+			.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+			.descriptorCount = 2 * MAX_OBJECTS,		// Assuming one texture per object
+		};
+
+		VkDescriptorPoolCreateInfo samplerPoolCreateInfo{
+			.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+			.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT,
+			.maxSets = 2 * MAX_OBJECTS,
+			.poolSizeCount = 1,
+			.pPoolSizes = &samplerPoolSize,
+		};
+
+		VkResult result{ vkCreateDescriptorPool(m_device.logicalDevice, &samplerPoolCreateInfo, nullptr, &m_samplerDescriptorPool) };
+		if (result != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create a sampler descriptor pool!");
+		}
+	}
+
+	void VulkanRenderer::create_per_image_descriptor_pools()
+	{
+		// Sized by the swapchain image count (and the attachments, one per image)
 		// UNIFORM DESCRIPTOR POOL
 		// Type of descriptors + how many descriptors
 		VkDescriptorPoolSize vpDescriptorPoolSize{
@@ -1142,25 +1551,6 @@ namespace VkCourse
 			throw std::runtime_error("Failed to create a descriptor pool!");
 		}
 
-		// SAMPLER DESCRIPTOR POOL
-		VkDescriptorPoolSize samplerPoolSize{
-			.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-			.descriptorCount = MAX_OBJECTS,		// Assuming one texture per object
-		};
-
-		VkDescriptorPoolCreateInfo samplerPoolCreateInfo{
-			.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
-			.maxSets = MAX_OBJECTS,
-			.poolSizeCount = 1,
-			.pPoolSizes = &samplerPoolSize,
-		};
-
-		result = vkCreateDescriptorPool(m_device.logicalDevice, &samplerPoolCreateInfo, nullptr, &m_samplerDescriptorPool);
-		if (result != VK_SUCCESS)
-		{
-			throw std::runtime_error("Failed to create a sampler descriptor pool!");
-		}
-
 		// INPUT ATTACHMENTS DESCRIPTOR POOL
 		VkDescriptorPoolSize colorInputPoolSize{
 			.type = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT,
@@ -1281,7 +1671,13 @@ namespace VkCourse
 			throw std::runtime_error("Failed to allocate input attachment descriptor sets!");
 		}
 
-		for(size_t i = 0; i < inputSetLayouts.size(); ++i)
+		update_input_descriptor_sets();
+	}
+
+	void VulkanRenderer::update_input_descriptor_sets()
+	{
+		// Point at the current color and depth buffers, again after each swapchain recreation
+		for (size_t i = 0; i < m_inputAttachmentDescriptorSets.size(); ++i)
 		{
 			// Color attachment description
 			VkDescriptorImageInfo inputColorAttachmentDescriptor{
@@ -1327,6 +1723,14 @@ namespace VkCourse
 		}
 	}
 
+	void VulkanRenderer::update_projection()
+	{
+		m_uboViewProjection.projection = glm::perspective(glm::radians(45.f),
+			static_cast<float>(m_swapchainExtent.width) / static_cast<float>(m_swapchainExtent.height), 0.1f, 100.f);
+
+		m_uboViewProjection.projection[1][1] *= -1.f; // Invert the Y axis to fit Vulkan
+	}
+
 	void VulkanRenderer::update_uniform_buffers(uint32_t imageIndex)
 	{
 		// Copy ViewProjection data
@@ -1350,6 +1754,221 @@ namespace VkCourse
 		vkUnmapMemory(m_device.logicalDevice, m_modelDynamicUniformBufferMemories[imageIndex]);*/
 	}
 
+	void VulkanRenderer::update_texture_streaming()
+	{
+		// Texture resolution each mesh needs, from the size of its bounding sphere on screen (one texel per pixel)
+		const glm::vec3 cameraPosition{ glm::inverse(m_uboViewProjection.view)[3] };
+		const float tanHalfFov{ 1.f / std::abs(m_uboViewProjection.projection[1][1]) };
+
+		for (MeshModel& meshModel : m_meshModels)
+		{
+			for (size_t i = 0; i < meshModel.get_mesh_count(); ++i)
+			{
+				Mesh& mesh{ meshModel.get_mesh(i) };
+				const glm::mat4& modelMatrix{ meshModel.get_model_matrix() };
+				const glm::vec4& boundingSphere{ mesh.get_bounding_sphere() };
+
+				const glm::vec3 center{ modelMatrix * glm::vec4(glm::vec3(boundingSphere), 1.f) };
+				const float scale{ std::max({ glm::length(glm::vec3(modelMatrix[0])), glm::length(glm::vec3(modelMatrix[1])), 
+					glm::length(glm::vec3(modelMatrix[2])) }) };
+				const float radius{ boundingSphere.w * scale };
+				const float distance{ glm::length(center - cameraPosition) };
+
+				const float projectedSize{ distance > radius 
+					? radius / (distance * tanHalfFov) * static_cast<float>(m_swapchainExtent.height)
+					: std::numeric_limits<float>::max() };
+				m_textureStreamer.request_size(mesh.get_texture_id(), projectedSize);
+			}
+		}
+
+		// Replaced images are destroyed once no frame in flight can use them anymore
+		release_retired_textures(false);
+
+		// One batch at a time, the sizes requested until it is applied add up for the next one
+		if (m_textureStreamingBatch && !advance_texture_streaming_batch(false))
+		{
+			return;
+		}
+
+		std::vector<TextureResidencyChange> changes{ m_textureStreamer.update() };
+		if (!changes.empty())
+		{
+			start_texture_streaming_batch(std::move(changes));
+		}
+	}
+
+	void VulkanRenderer::start_texture_streaming_batch(std::vector<TextureResidencyChange>&& changes)
+	{
+		// A texture can be both upgraded and evicted in one update, only its last level counts
+		std::vector<TextureResidencyChange> lastChanges{};
+		for (auto change{ changes.rbegin() }; change != changes.rend(); ++change)
+		{
+			if (std::none_of(lastChanges.begin(), lastChanges.end(),
+				[&change](const TextureResidencyChange& lastChange) { return lastChange.textureId == change->textureId; }))
+			{
+				lastChanges.push_back(*change);
+			}
+		}
+
+		// Reload each changed texture with its new first level, into a new image
+		TextureStreamingBatch& batch{ m_textureStreamingBatch.emplace() };
+		batch.changes = std::move(lastChanges);
+		for (const TextureResidencyChange& change : batch.changes)
+		{
+			TextureFileInfo textureFileInfo{ m_textureFileInfos[m_samplerDescriptorImageLocations[change.textureId]] };
+			textureFileInfo.firstLevel = change.firstLevel;
+			batch.textureFileInfos.push_back(std::move(textureFileInfo));
+		}
+
+		const VkDeviceSize stagingSize{ create_texture_staging_buffer(&batch.textureFileInfos, &batch.stagingBuffer, &batch.stagingBufferMemory) };
+
+		void* data;
+		vkMapMemory(m_device.logicalDevice, batch.stagingBufferMemory, 0, stagingSize, 0, &data);
+
+		// The batch stays in place until it is applied, so the worker can read its file infos
+		batch.loading = std::async(std::launch::async, [this, &batch, data]() { load_texture_files(batch.textureFileInfos, data); });
+	}
+
+	bool VulkanRenderer::advance_texture_streaming_batch(bool wait)
+	{
+		TextureStreamingBatch& batch{ *m_textureStreamingBatch };
+
+		if (batch.commandBuffer == VK_NULL_HANDLE)
+		{
+			if (!wait && batch.loading.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+			{
+				return false;
+			}
+
+			try
+			{
+				batch.loading.get();	// Rethrows any loading error
+			}
+			catch (...)
+			{
+				vkUnmapMemory(m_device.logicalDevice, batch.stagingBufferMemory);
+				vkDestroyBuffer(m_device.logicalDevice, batch.stagingBuffer, nullptr);
+				vkFreeMemory(m_device.logicalDevice, batch.stagingBufferMemory, nullptr);
+				m_textureStreamingBatch.reset();
+				throw;
+			}
+
+			vkUnmapMemory(m_device.logicalDevice, batch.stagingBufferMemory);
+
+			batch.commandBuffer = begin_command_buffer(m_device.logicalDevice, m_graphicsCommandPool);
+			batch.textureImages = record_texture_uploads(batch.commandBuffer, batch.textureFileInfos, batch.stagingBuffer);
+			vkEndCommandBuffer(batch.commandBuffer);
+
+			// Ordered before the frames submitted after it, they only sample the new images once the fence is signaled
+			VkSubmitInfo submitInfo{
+				.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+				.commandBufferCount = 1,
+				.pCommandBuffers = &batch.commandBuffer,
+			};
+
+			vkResetFences(m_device.logicalDevice, 1, &m_textureUploadFence);
+			if (vkQueueSubmit(m_graphicsQueue, 1, &submitInfo, m_textureUploadFence) != VK_SUCCESS)
+			{
+				throw std::runtime_error("Failed to submit the texture upload!");
+			}
+		}
+
+		if (wait)
+		{
+			vkWaitForFences(m_device.logicalDevice, 1, &m_textureUploadFence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+		}
+		else if (vkGetFenceStatus(m_device.logicalDevice, m_textureUploadFence) != VK_SUCCESS)
+		{
+			return false;
+		}
+
+		// The sets of the previous batch must be freed first, the pool only has room for one replacement per texture
+		if (!m_retiredTextures.empty())
+		{
+			return false;
+		}
+
+		vkFreeCommandBuffers(m_device.logicalDevice, m_graphicsCommandPool, 1, &batch.commandBuffer);
+		vkDestroyBuffer(m_device.logicalDevice, batch.stagingBuffer, nullptr);
+		vkFreeMemory(m_device.logicalDevice, batch.stagingBufferMemory, nullptr);
+
+		apply_texture_streaming_batch(batch);
+		m_textureStreamingBatch.reset();
+		return true;
+	}
+
+	void VulkanRenderer::apply_texture_streaming_batch(TextureStreamingBatch& batch)
+	{
+		// Frames in flight still use the old images through the old sets, so each texture gets a new set
+		// (the texture id used by the meshes doesn't change) and the old ones are retired
+		for (size_t i = 0; i < batch.changes.size(); ++i)
+		{
+			const size_t textureId{ batch.changes[i].textureId };
+			const size_t location{ m_samplerDescriptorImageLocations[textureId] };
+
+			m_retiredTextures.push_back({
+				.image = m_textureImages[location],
+				.memory = m_textureImageMemories[location],
+				.imageView = m_textureImageViews[location],
+				.descriptorSet = m_samplerDescriptorSets[textureId],
+				.frameNumber = m_frameNumber,
+			});
+
+			const TextureFileInfo& textureFileInfo{ batch.textureFileInfos[i] };
+			const uint32_t mipLevels{ static_cast<uint32_t>(textureFileInfo.info.levels.size()) - textureFileInfo.firstLevel };
+			m_textureImages[location] = batch.textureImages[i].image;
+			m_textureImageMemories[location] = batch.textureImages[i].memory;
+			m_textureImageMipLevels[location] = mipLevels;
+			m_textureImageViews[location] = create_image_view(batch.textureImages[i].image, m_textureImageFormats[location],
+				VK_IMAGE_ASPECT_COLOR_BIT, mipLevels);
+			m_textureFileInfos[location].firstLevel = textureFileInfo.firstLevel;
+
+			VkDescriptorSetAllocateInfo descriptorSetAllocateInfo{
+				.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+				.descriptorPool = m_samplerDescriptorPool,
+				.descriptorSetCount = 1,
+				.pSetLayouts = &m_samplerSetLayout,
+			};
+
+			VkResult result{ vkAllocateDescriptorSets(m_device.logicalDevice, &descriptorSetAllocateInfo, &m_samplerDescriptorSets[textureId]) };
+			if (result != VK_SUCCESS)
+			{
+				throw std::runtime_error("Failed to allocate texture descriptor sets!");
+			}
+			update_texture_descriptor(textureId);
+		}
+	}
+
+	void VulkanRenderer::release_retired_textures(bool deviceIdle)
+	{
+		// Frame fences are waited in submission order, MAX_FRAME_DRAWS frames after being replaced every frame that
+		// could use a retired texture has completed
+		std::erase_if(m_retiredTextures, [this, deviceIdle](const RetiredTexture& retiredTexture) {
+			if (!deviceIdle && m_frameNumber < retiredTexture.frameNumber + MAX_FRAME_DRAWS)
+			{
+				return false;
+			}
+
+			vkDestroyImageView(m_device.logicalDevice, retiredTexture.imageView, nullptr);
+			vkDestroyImage(m_device.logicalDevice, retiredTexture.image, nullptr);
+			vkFreeMemory(m_device.logicalDevice, retiredTexture.memory, nullptr);
+			vkFreeDescriptorSets(m_device.logicalDevice, m_samplerDescriptorPool, 1, &retiredTexture.descriptorSet);
+			return true;
+		});
+	}
+
+	void VulkanRenderer::finish_texture_streaming()
+	{
+		release_retired_textures(true);
+		if (m_textureStreamingBatch)
+		{
+			advance_texture_streaming_batch(true);
+		}
+
+		// The batch only retired textures frames have not used since
+		release_retired_textures(true);
+	}
+
 	void VulkanRenderer::record_commands(uint32_t imageIndex)
 	{
 		// Information about how to begin each command buffer
@@ -1357,10 +1976,12 @@ namespace VkCourse
 			.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
 		};
 
-		std::array<VkClearValue, 3> clearValues{};
+		std::array<VkClearValue, 5> clearValues{};
 		clearValues[0].color = { 0.f,  0.f,   0.f,  1.f };
 		clearValues[1].color = { 0.6f, 0.65f, 0.4f, 1.f };	// 1st attachment (color)
 		clearValues[2].depthStencil.depth = 1.f;			// 2nd attachment (depth)
+		clearValues[3] = clearValues[1];					// Multisampled color and depth, resolved into the above
+		clearValues[4] = clearValues[2];
 
 		// Information about how to begin a render pass (only for grapics applications)
 		VkRenderPassBeginInfo renderPassBeginInfo{
@@ -1370,7 +1991,7 @@ namespace VkCourse
 				.offset = { 0, 0 },
 				.extent = m_swapchainExtent,
 			},
-			.clearValueCount = static_cast<uint32_t>(clearValues.size()),
+			.clearValueCount = m_msaaSamples != VK_SAMPLE_COUNT_1_BIT ? 5u : 3u,
 			.pClearValues = clearValues.data(),
 		};
 
@@ -1380,53 +2001,95 @@ namespace VkCourse
 			throw std::runtime_error("Failed to start recording a command buffer!");
 		}
 
+		// The fence of the current frame has been waited for, the profiler reads its previous timestamps without stalling
+		if (m_gpuProfiler.begin_frame(m_commandBuffers[imageIndex], static_cast<uint32_t>(m_currentFrame)))
+		{
+			m_frameStats.gpuMilliseconds = m_gpuProfiler.get_last_milliseconds("frame");
+		}
+
+		// Queries are reset outside of the render pass
+		const bool depthPrepass{ use_depth_prepass(imageIndex) };
+		const bool measureOverdraw{ depthPrepass && m_occlusionQueryPrecise };
+		if (measureOverdraw)
+		{
+			vkCmdResetQueryPool(m_commandBuffers[imageIndex], m_overdrawQueryPool, 2 * imageIndex, 2);
+		}
+		m_overdrawQueriesRecorded[imageIndex] = measureOverdraw;
+
 		{ // Indented block to symbolize render pass
 			renderPassBeginInfo.framebuffer = m_swapchainFramebuffers[imageIndex];
 			vkCmdBeginRenderPass(m_commandBuffers[imageIndex], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE); // INLINE: All commands are primary
 			{
-				vkCmdBindPipeline(m_commandBuffers[imageIndex], VK_PIPELINE_BIND_POINT_GRAPHICS, m_graphicsPipeline);
+				// Dynamic in every pipeline, kept across the pipeline binds and subpasses below
+				VkViewport viewport{
+					.x = 0.f,
+					.y = 0.f,
+					.width = static_cast<float>(m_swapchainExtent.width),
+					.height = static_cast<float>(m_swapchainExtent.height),
+					.minDepth = 0.f,
+					.maxDepth = 1.f
+				};
+				vkCmdSetViewport(m_commandBuffers[imageIndex], 0, 1, &viewport);
+				vkCmdSetScissor(m_commandBuffers[imageIndex], 0, 1, &renderPassBeginInfo.renderArea);
 
-				for (size_t j = 0; j < m_meshModels.size(); ++j)
 				{
-					MeshModel& thisModel{ m_meshModels[j] };
-
-					vkCmdPushConstants(m_commandBuffers[imageIndex], m_pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT,
-						0, sizeof(Model), &thisModel.get_model_matrix());
-
-					for (size_t k = 0; k < thisModel.get_mesh_count(); ++k)
+					GPU_SCOPE(m_gpuProfiler, "subpass0");
+					if (depthPrepass)
 					{
-						VkBuffer vertexBuffers[]{ thisModel.get_mesh(k).get_vertex_buffer() };	// Buffers to bind
-						VkDeviceSize offsets[]{ 0 };
-						vkCmdBindVertexBuffers(m_commandBuffers[imageIndex], 0, 1, vertexBuffers, offsets);
-						vkCmdBindIndexBuffer(m_commandBuffers[imageIndex], thisModel.get_mesh(k).get_index_buffer(), 0, VK_INDEX_TYPE_UINT32);
-
-						// Offset for the j-th dynamic uniform buffer
-						//uint32_t dynamicUniformOffset{ static_cast<uint32_t>(m_modelUniformAlignment * j) };
-
-						std::array<VkDescriptorSet, 2> descriptorSetGroup{
-							m_descriptorSets[imageIndex],
-							m_samplerDescriptorSets[thisModel.get_mesh(k).get_texture_id()],
-						};
-
-						vkCmdBindDescriptorSets(m_commandBuffers[imageIndex], VK_PIPELINE_BIND_POINT_GRAPHICS,
-							m_pipelineLayout, 0, static_cast<uint32_t>(descriptorSetGroup.size()), descriptorSetGroup.data(), 0, nullptr);
-
-						vkCmdDrawIndexed(m_commandBuffers[imageIndex], thisModel.get_mesh(k).get_index_count(), 1, 0, 0, 0);
+						// Depth only, fills the depth buffer with the closest fragments
+						if (measureOverdraw)
+						{
+							vkCmdBeginQuery(m_commandBuffers[imageIndex], m_overdrawQueryPool, 2 * imageIndex, VK_QUERY_CONTROL_PRECISE_BIT);
+						}
+						{
+							GPU_SCOPE(m_gpuProfiler, "depthPrepass");
+							vkCmdBindPipeline(m_commandBuffers[imageIndex], VK_PIPELINE_BIND_POINT_GRAPHICS, m_depthPipeline);
+							record_mesh_draws(m_commandBuffers[imageIndex], imageIndex, true);
+						}
+						if (measureOverdraw)
+						{
+							vkCmdEndQuery(m_commandBuffers[imageIndex], m_overdrawQueryPool, 2 * imageIndex);
+							vkCmdBeginQuery(m_commandBuffers[imageIndex], m_overdrawQueryPool, 2 * imageIndex + 1, VK_QUERY_CONTROL_PRECISE_BIT);
+						}
+
+						// Only the visible fragments are shaded
+						vkCmdBindPipeline(m_commandBuffers[imageIndex], VK_PIPELINE_BIND_POINT_GRAPHICS, m_graphicsEqualPipeline);
+						record_mesh_draws(m_commandBuffers[imageIndex], imageIndex, false);
+						if (measureOverdraw)
+						{
+							vkCmdEndQuery(m_commandBuffers[imageIndex], m_overdrawQueryPool, 2 * imageIndex + 1);
+						}
+					}
+					else
+					{
+						vkCmdBindPipeline(m_commandBuffers[imageIndex], VK_PIPELINE_BIND_POINT_GRAPHICS, m_graphicsPipeline);
+						record_mesh_draws(m_commandBuffers[imageIndex], imageIndex, false);
 					}
 				}
 
 				// Start second subpass
 				vkCmdNextSubpass(m_commandBuffers[imageIndex], VK_SUBPASS_CONTENTS_INLINE);
+				GPU_SCOPE(m_gpuProfiler, "subpass1");
 
 				vkCmdBindPipeline(m_commandBuffers[imageIndex], VK_PIPELINE_BIND_POINT_GRAPHICS, m_secondPipeline);
 				vkCmdBindDescriptorSets(m_commandBuffers[imageIndex], VK_PIPELINE_BIND_POINT_GRAPHICS, m_secondPipelineLayout,
 					0, 1, &m_inputAttachmentDescriptorSets[imageIndex], 0, nullptr);
 
 				vkCmdDraw(m_commandBuffers[imageIndex], 3, 1, 0, 0);
+				++m_frameStats.drawCount;
+				++m_frameStats.triangleCount;
 			}
 			vkCmdEndRenderPass(m_commandBuffers[imageIndex]);
 		}
 
+		if (m_readbackCallback)
+		{
+			GPU_SCOPE(m_gpuProfiler, "readback");
+			record_readback(m_commandBuffers[imageIndex], imageIndex);
+		}
+
+		m_gpuProfiler.end_frame();
+
 		result = vkEndCommandBuffer(m_commandBuffers[imageIndex]);
 		if (result != VK_SUCCESS)
 		{
@@ -1434,6 +2097,125 @@ namespace VkCourse
 		}
 	}
 
+	void VulkanRenderer::record_readback(VkCommandBuffer commandBuffer, uint32_t imageIndex)
+	{
+		// Headless images are left in TRANSFER_SRC_OPTIMAL by the render pass, swapchain images go there and back
+		// (the render pass dependency already covers the color writes)
+		VkImageMemoryBarrier imageMemoryBarrier{
+			.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+			.srcAccessMask = 0,
+			.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
+			.oldLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+			.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+			.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+			.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+			.image = m_swapchainImages[imageIndex].image,
+			.subresourceRange = {
+				.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+				.baseMipLevel = 0,
+				.levelCount = 1,
+				.baseArrayLayer = 0,
+				.layerCount = 1,
+			},
+		};
+
+		if (!is_headless())
+		{
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+				0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+		}
+
+		m_frameReadback.record_copy(commandBuffer, m_currentFrame, m_swapchainImages[imageIndex].image, m_frameNumber);
+
+		if (!is_headless())
+		{
+			imageMemoryBarrier.dstAccessMask = 0;
+			imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+			imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+				0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+		}
+	}
+
+	void VulkanRenderer::record_mesh_draws(VkCommandBuffer commandBuffer, uint32_t imageIndex, bool depthOnly)
+	{
+		for (size_t j = 0; j < m_meshModels.size(); ++j)
+		{
+			MeshModel& thisModel{ m_meshModels[j] };
+
+			for (size_t k = 0; k < thisModel.get_mesh_count(); ++k)
+			{
+				// Quantized positions are expanded back to the mesh bounds by the model matrix
+				const Model meshModel{ thisModel.get_model_matrix() * thisModel.get_mesh(k).get_dequantization_matrix() };
+				vkCmdPushConstants(commandBuffer, m_pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT,
+					0, sizeof(Model), &meshModel);
+
+				// Position and attribute streams, both in the same buffer (the depth pipeline only fetches positions)
+				VkBuffer vertexBuffers[]{ thisModel.get_mesh(k).get_vertex_buffer(), thisModel.get_mesh(k).get_vertex_buffer() };
+				VkDeviceSize offsets[]{ 0, thisModel.get_mesh(k).get_attribute_offset() };
+				vkCmdBindVertexBuffers(commandBuffer, 0, depthOnly ? 1 : 2, vertexBuffers, offsets);
+				vkCmdBindIndexBuffer(commandBuffer, thisModel.get_mesh(k).get_index_buffer(), 0, 
+					thisModel.get_mesh(k).get_index_type());
+
+				// Offset for the j-th dynamic uniform buffer
+				//uint32_t dynamicUniformOffset{ static_cast<uint32_t>(m_modelUniformAlignment * j) };
+
+				std::array<VkDescriptorSet, 2> descriptorSetGroup{
+					m_descriptorSets[imageIndex],
+					m_samplerDescriptorSets[thisModel.get_mesh(k).get_texture_id()],
+				};
+
+				vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+					m_pipelineLayout, 0, static_cast<uint32_t>(descriptorSetGroup.size()), descriptorSetGroup.data(), 0, nullptr);
+
+				vkCmdDrawIndexed(commandBuffer, thisModel.get_mesh(k).get_index_count(), 1, 0, 0, 0);
+				++m_frameStats.drawCount;
+				m_frameStats.triangleCount += thisModel.get_mesh(k).get_index_count() / 3;
+			}
+		}
+	}
+
+	bool VulkanRenderer::use_depth_prepass(uint32_t imageIndex)
+	{
+		// The previous submission of this command buffer has completed, its results are available without waiting
+		if (m_overdrawQueriesRecorded[imageIndex])
+		{
+			std::array<uint64_t, 2> samplesPassed{};
+			VkResult result{ vkGetQueryPoolResults(m_device.logicalDevice, m_overdrawQueryPool, 2 * imageIndex, 2,
+				sizeof(samplesPassed), samplesPassed.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) };
+			if (result == VK_SUCCESS && samplesPassed[1] > 0)
+			{
+				// Prepass samples are every fragment closer than what was drawn before, main pass samples the visible ones
+				m_measuredOverdraw = static_cast<float>(samplesPassed[0]) / static_cast<float>(samplesPassed[1]);
+			}
+			m_overdrawQueriesRecorded[imageIndex] = false;
+		}
+
+		switch (m_depthPrepassMode)
+		{
+		case DepthPrepassMode::On:
+			return true;
+		case DepthPrepassMode::Auto:
+			if (!m_occlusionQueryPrecise)
+			{
+				return false;
+			}
+			if (m_measuredOverdraw > DEPTH_PREPASS_OVERDRAW_THRESHOLD)
+			{
+				return true;		// Measured every frame while on, it turns off once the scene gets simpler
+			}
+			// Otherwise every few frames, a prepass frame is needed to count the visible fragments
+			if (++m_framesSinceOverdrawMeasurement >= OVERDRAW_MEASUREMENT_INTERVAL)
+			{
+				m_framesSinceOverdrawMeasurement = 0;
+				return true;
+			}
+			return false;
+		default:
+			return false;
+		}
+	}
+
 	void VulkanRenderer::obtain_physical_device()
 	{
 		// Enumerate all physical devices available to our instance
@@ -1447,6 +2229,7 @@ namespace VkCourse
 		vkEnumeratePhysicalDevices(m_instance, &physicalDeviceCount, availablePhysicalDevices.data());
 
 		// Select the first device that supports all requirements
+		m_device.physicalDevice = VK_NULL_HANDLE;
 		for (const auto& physicalDevice : availablePhysicalDevices)
 		{
 			if(device_supports_requirements(physicalDevice))
@@ -1456,6 +2239,11 @@ namespace VkCourse
 			}
 		}
 
+		if (m_device.physicalDevice == VK_NULL_HANDLE)
+		{
+			throw std::runtime_error("No device supports Vulkan 1.2 and the required features!");
+		}
+
 		// Get properties of physical device to find uniform buffer alignment
 		//VkPhysicalDeviceProperties physicalDeviceProperties;
 		//vkGetPhysicalDeviceProperties(m_device.physicalDevice, &physicalDeviceProperties);
@@ -1488,9 +2276,16 @@ namespace VkCourse
 				queueFamilyIndices.graphicsFamily = static_cast<int>(i);
 			}
 
-			// Check if device supports the surface at the current queue family
+			// Check if device supports the surface at the current queue family (nothing is presented when headless)
 			VkBool32 queueFamilySupportsPresentation{ false };
-			vkGetPhysicalDeviceSurfaceSupportKHR(device, static_cast<uint32_t>(i), m_surface, &queueFamilySupportsPresentation);
+			if (is_headless())
+			{
+				queueFamilySupportsPresentation = queueFamilyIndices.graphicsFamily == static_cast<int>(i);
+			}
+			else
+			{
+				vkGetPhysicalDeviceSurfaceSupportKHR(device, static_cast<uint32_t>(i), m_surface, &queueFamilySupportsPresentation);
+			}
 			if (queueFamilySupportsPresentation)
 			{
 				queueFamilyIndices.presentationFamily = static_cast<int>(i);
@@ -1602,9 +2397,15 @@ namespace VkCourse
 
 	bool VulkanRenderer::device_supports_requirements(const VkPhysicalDevice& device) const
 	{
-		//// General physical device properties and limits
-		//VkPhysicalDeviceProperties physicalDeviceProperties;
-		//vkGetPhysicalDeviceProperties(device, &physicalDeviceProperties);
+		// General physical device properties and limits. The render pass (vkCreateRenderPass2, depth resolve) and
+		// the MSAA query (vkGetPhysicalDeviceProperties2) are Vulkan 1.2 core
+		VkPhysicalDeviceProperties physicalDeviceProperties;
+		vkGetPhysicalDeviceProperties(device, &physicalDeviceProperties);
+
+		if (physicalDeviceProperties.apiVersion < VK_API_VERSION_1_2)
+		{
+			return false;
+		}
 
 		//// Physical device features: geometry shader, tessellation shader, depth clamp, multi viewport...
 		VkPhysicalDeviceFeatures physicalDeviceFeatures;
@@ -1615,17 +2416,21 @@ namespace VkCourse
 			return false;
 		}
 
-		if (!check_device_extension_support(device, requestedDeviceExtensionNames))
+		// Headless devices only need to render
+		if (!is_headless())
 		{
-			return false;
-		}
+			if (!check_device_extension_support(device, requestedDeviceExtensionNames))
+			{
+				return false;
+			}
 
-		// Get device swap chain details to check that there it supports some formats and/or presentation modes
-		SwapchainDetails deviceSwapChainDetails{ get_swap_chain_details(device) };
-		if (deviceSwapChainDetails.surfaceSupportedFormats.empty()
-			|| deviceSwapChainDetails.presentationModes.empty())
-		{
-			return false;
+			// Get device swap chain details to check that there it supports some formats and/or presentation modes
+			SwapchainDetails deviceSwapChainDetails{ get_swap_chain_details(device) };
+			if (deviceSwapChainDetails.surfaceSupportedFormats.empty()
+				|| deviceSwapChainDetails.presentationModes.empty())
+			{
+				return false;
+			}
 		}
 
 		// Get queue families to check if all the ones needed are supported and return true if that is the case
@@ -1687,7 +2492,7 @@ namespace VkCourse
 
 		// Otherwise we need to set the extent manually
 		int width, height;
-		glfwGetFramebufferSize(m_window.get_window_handle(), &width, &height);
+		m_window->get_framebuffer_size(&width, &height);
 
 		VkExtent2D newExtent{
 			static_cast<uint32_t>(width),
@@ -1719,8 +2524,40 @@ namespace VkCourse
 		throw std::runtime_error("Failed to find a matching format!");
 	}
 
-	VkImage VulkanRenderer::create_image(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usageFlags, 
-		VkMemoryPropertyFlags memoryPropertyFlags, VkDeviceMemory* imageMemory)
+	VkSampleCountFlagBits VulkanRenderer::choose_msaa_samples(VkSampleCountFlagBits requestedSamples) const
+	{
+		VkPhysicalDeviceDepthStencilResolveProperties depthStencilResolveProperties{
+			.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DEPTH_STENCIL_RESOLVE_PROPERTIES,
+		};
+
+		VkPhysicalDeviceProperties2 physicalDeviceProperties{
+			.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
+			.pNext = &depthStencilResolveProperties,
+		};
+		vkGetPhysicalDeviceProperties2(m_device.physicalDevice, &physicalDeviceProperties);
+
+		// The composition subpass reads the depth resolved within the render pass
+		if ((depthStencilResolveProperties.supportedDepthResolveModes & VK_RESOLVE_MODE_SAMPLE_ZERO_BIT) == 0)
+		{
+			return VK_SAMPLE_COUNT_1_BIT;
+		}
+
+		// Highest count up to the requested one that both the color and depth attachments support
+		const VkSampleCountFlags supportedSamples{ physicalDeviceProperties.properties.limits.framebufferColorSampleCounts
+			& physicalDeviceProperties.properties.limits.framebufferDepthSampleCounts };
+		for (VkSampleCountFlagBits samples : { VK_SAMPLE_COUNT_8_BIT, VK_SAMPLE_COUNT_4_BIT, VK_SAMPLE_COUNT_2_BIT })
+		{
+			if (samples <= requestedSamples && (supportedSamples & samples) != 0)
+			{
+				return samples;
+			}
+		}
+
+		return VK_SAMPLE_COUNT_1_BIT;
+	}
+
+	VkImage VulkanRenderer::create_image(uint32_t width, uint32_t height, uint32_t mipLevels, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usageFlags, 
+		VkMemoryPropertyFlags memoryPropertyFlags, VkDeviceMemory* imageMemory, VkSampleCountFlagBits samples)
 	{
 		VkImageCreateInfo imageCreateInfo{
 			.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
@@ -1731,9 +2568,9 @@ namespace VkCourse
 				.height = height,
 				.depth = 1,
 			},
-			.mipLevels = 1,
+			.mipLevels = mipLevels,
 			.arrayLayers = 1,
-			.samples = VK_SAMPLE_COUNT_1_BIT,				// N samples for multisampling
+			.samples = samples,								// N samples for multisampling
 			.tiling = tiling,
 			.usage = usageFlags,
 			.sharingMode = VK_SHARING_MODE_EXCLUSIVE,		// Whether image can be shared between queues
@@ -1752,10 +2589,18 @@ namespace VkCourse
 		VkMemoryRequirements memoryRequirements;
 		vkGetImageMemoryRequirements(m_device.logicalDevice, image, &memoryRequirements);
 
+		// Transient attachments may never need backing memory (tilers), if the device has lazily allocated memory
+		uint32_t memoryTypeIndex;
+		if (!((usageFlags & VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT) && try_find_memory_type_index(m_device.physicalDevice, 
+			memoryRequirements.memoryTypeBits, memoryPropertyFlags | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT, &memoryTypeIndex)))
+		{
+			memoryTypeIndex = find_memory_type_index(m_device.physicalDevice, memoryRequirements.memoryTypeBits, memoryPropertyFlags);
+		}
+
 		VkMemoryAllocateInfo memoryAllocateInfo{
 			.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
 			.allocationSize = memoryRequirements.size,
-			.memoryTypeIndex = find_memory_type_index(m_device.physicalDevice, memoryRequirements.memoryTypeBits, memoryPropertyFlags),
+			.memoryTypeIndex = memoryTypeIndex,
 		};
 		result = vkAllocateMemory(m_device.logicalDevice, &memoryAllocateInfo, nullptr, imageMemory);
 		if (result != VK_SUCCESS)
@@ -1769,7 +2614,7 @@ namespace VkCourse
 		return image;
 	}
 
-	VkImageView VulkanRenderer::create_image_view(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags)
+	VkImageView VulkanRenderer::create_image_view(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, uint32_t mipLevels)
 	{
 		VkImageViewCreateInfo imageViewCreateInfo{
 			.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
@@ -1785,7 +2630,7 @@ namespace VkCourse
 			.subresourceRange = {
 				.aspectMask = aspectFlags,	// Which aspect of the image to view (e.g. COLOR_BIT, DEPTH_BIT...)
 				.baseMipLevel = 0,			// Start mipmap level to view from
-				.levelCount = 1,			// Number of mipmap levels to view
+				.levelCount = mipLevels,	// Number of mipmap levels to view
 				.baseArrayLayer = 0,
 				.layerCount = 1,
 			}
@@ -1801,110 +2646,342 @@ namespace VkCourse
 		return imageView;
 	}
 
-	VkShaderModule VulkanRenderer::create_shader_module(const std::vector<char>& code)
+	std::vector<size_t> VulkanRenderer::create_texture_images(std::vector<TextureFileInfo>* textureFileInfos, ImportProfile* profile)
 	{
-		if ((sizeof(char) * code.size()) % sizeof(uint32_t) != 0)
-		{
-			throw std::runtime_error("Shader code is not able to be pointed at by uint32_t*.");
-		}
+		const std::vector<TextureImage> textureImages{ upload_texture_images(textureFileInfos, profile) };
 
-		VkShaderModuleCreateInfo shaderModuleCreateInfo{
-			.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
-			.codeSize = code.size(),
-			.pCode = reinterpret_cast<const uint32_t*>(code.data())
-		};
-
-		VkShaderModule shaderModule;
-		VkResult result{ vkCreateShaderModule(m_device.logicalDevice, &shaderModuleCreateInfo, nullptr, &shaderModule) };
-		if (result != VK_SUCCESS)
+		std::vector<size_t> textureImageLocations(textureFileInfos->size());
+		for (size_t i = 0; i < textureFileInfos->size(); ++i)
 		{
-			throw std::runtime_error("Failed to create shader module!");
+			const TextureFileInfo& textureFileInfo{ (*textureFileInfos)[i] };
+
+			m_textureImages.push_back(textureImages[i].image);
+			m_textureImageMemories.push_back(textureImages[i].memory);
+			m_textureImageFormats.push_back(textureFileInfo.info.format);
+			m_textureImageMipLevels.push_back(static_cast<uint32_t>(textureFileInfo.info.levels.size()) - textureFileInfo.firstLevel);
+			m_textureFileInfos.push_back(textureFileInfo);		// Streamed levels are loaded again from the same file
+			textureImageLocations[i] = m_textureImages.size() - 1;
 		}
-		return shaderModule;
+
+		return textureImageLocations;
 	}
 
-	size_t VulkanRenderer::create_texture_image(const std::string& fileName)
+	std::vector<VulkanRenderer::TextureImage> VulkanRenderer::upload_texture_images(std::vector<TextureFileInfo>* textureFileInfos, ImportProfile* profile)
 	{
-		// Load image file
-		int width, height;
-		VkDeviceSize imageSize;
-		stbi_uc* imageData{ load_texture_file(fileName, &width, &height, &imageSize) };
+		ImportStageTimer loadTimer{ profile, "texture load" };
 
-		// We don't need host visible texture data, so we create staging buffer first
 		VkBuffer imageStagingBuffer;
 		VkDeviceMemory imageStagingBufferMemory;
-		create_buffer(m_device.physicalDevice, m_device.logicalDevice, imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, 
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,	&imageStagingBuffer, &imageStagingBufferMemory);
+		const VkDeviceSize stagingSize{ create_texture_staging_buffer(textureFileInfos, &imageStagingBuffer, &imageStagingBufferMemory) };
 
 		void* data;
-		vkMapMemory(m_device.logicalDevice, imageStagingBufferMemory, 0, imageSize, 0, &data);
-		memcpy(data, imageData, static_cast<size_t>(imageSize));
+		vkMapMemory(m_device.logicalDevice, imageStagingBufferMemory, 0, stagingSize, 0, &data);
+
+		try
+		{
+			load_texture_files(*textureFileInfos, data);
+		}
+		catch (...)
+		{
+			vkUnmapMemory(m_device.logicalDevice, imageStagingBufferMemory);
+			vkDestroyBuffer(m_device.logicalDevice, imageStagingBuffer, nullptr);
+			vkFreeMemory(m_device.logicalDevice, imageStagingBufferMemory, nullptr);
+			throw;
+		}
+
 		vkUnmapMemory(m_device.logicalDevice, imageStagingBufferMemory);
 
-		// Free original image data now not in use
-		stbi_image_free(imageData);
+		const size_t imageCount{ textureFileInfos->size() };
+		loadTimer.add_bytes(stagingSize);
+		loadTimer.add_items(imageCount);
+		loadTimer.stop();
+
+		// Upload all the images with a single submission
+		ImportStageTimer recordTimer{ profile, "texture upload record" };
+		VkCommandBuffer commandBuffer{ begin_command_buffer(m_device.logicalDevice, m_graphicsCommandPool) };
+		std::vector<TextureImage> textureImages{ record_texture_uploads(commandBuffer, *textureFileInfos, imageStagingBuffer) };
+		recordTimer.add_bytes(stagingSize);
+		recordTimer.add_items(imageCount);
+		recordTimer.stop();
+
+		// Waits for the queue to be idle, the textures are usable once this returns
+		ImportStageTimer submitTimer{ profile, "texture upload submit" };
+		end_and_submit_command_buffer(m_device.logicalDevice, m_graphicsCommandPool, m_graphicsQueue, commandBuffer);
+		submitTimer.add_bytes(stagingSize);
+		submitTimer.add_items(imageCount);
+		submitTimer.stop();
 
-		VkDeviceMemory textureImageMemory;
-		VkImage textureImage{ create_image(width, height, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_TILING_OPTIMAL, 
-			VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 
-			&textureImageMemory) };
+		vkDestroyBuffer(m_device.logicalDevice, imageStagingBuffer, nullptr);
+		vkFreeMemory(m_device.logicalDevice, imageStagingBufferMemory, nullptr);
 
-		// Force transition before transfer
-		transition_image_layout(m_device.logicalDevice, m_graphicsQueue, m_graphicsCommandPool, 
-			textureImage, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+		return textureImages;
+	}
 
-		copy_image_buffer(m_device.logicalDevice, m_graphicsQueue, m_graphicsCommandPool, 
-			imageStagingBuffer, textureImage, width, height);
+	VkDeviceSize VulkanRenderer::create_texture_staging_buffer(std::vector<TextureFileInfo>* textureFileInfos, VkBuffer* stagingBuffer,
+		VkDeviceMemory* stagingBufferMemory)
+	{
+		// One staging region per staged mip level, aligned for any block size
+		VkDeviceSize stagingSize{};
+		for (TextureFileInfo& textureFileInfo : *textureFileInfos)
+		{
+			textureFileInfo.stagingOffsets.clear();
+			for (uint32_t level = textureFileInfo.firstLevel; level < textureFileInfo.stagedLevelCount; ++level)
+			{
+				textureFileInfo.stagingOffsets.push_back(stagingSize);
+				stagingSize += (textureFileInfo.info.levels[level].byteLength + 15) & ~VkDeviceSize{ 15 };
+			}
+		}
 
-		transition_image_layout(m_device.logicalDevice, m_graphicsQueue, m_graphicsCommandPool,
-			textureImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		// We don't need host visible texture data, so we create staging buffer first
+		create_buffer(m_device.physicalDevice, m_device.logicalDevice, stagingSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, 
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
 
-		vkDestroyBuffer(m_device.logicalDevice, imageStagingBuffer, nullptr);
-		vkFreeMemory(m_device.logicalDevice, imageStagingBufferMemory, nullptr);
+		return stagingSize;
+	}
+
+	void VulkanRenderer::load_texture_files(const std::vector<TextureFileInfo>& textureFileInfos, void* stagingData)
+	{
+		// Load the files in parallel, each worker writes its images into their own region of the staging buffer
+		const size_t imageCount{ textureFileInfos.size() };
+		std::atomic<size_t> nextImage{ 0 };
+		auto loadWorker{ [&]() {
+			for (size_t i = nextImage++; i < imageCount; i = nextImage++)
+			{
+				load_texture_file(textureFileInfos[i], stagingData);
+			}
+		} };
+
+		const size_t workerCount{ std::min<size_t>(imageCount, std::max(1u, std::thread::hardware_concurrency())) };
+		std::vector<std::future<void>> workers{};
+		workers.reserve(workerCount);
+		for (size_t i = 0; i < workerCount; ++i)
+		{
+			workers.push_back(std::async(std::launch::async, loadWorker));
+		}
+
+		try
+		{
+			for (auto& worker : workers)
+			{
+				worker.get();	// Rethrows any loading error
+			}
+		}
+		catch (...)
+		{
+			// The other workers stop after their current image, they still write into the staging buffer until then
+			nextImage = imageCount;
+			for (auto& worker : workers)
+			{
+				if (worker.valid())
+				{
+					worker.wait();
+				}
+			}
+			throw;
+		}
+	}
+
+	std::vector<VulkanRenderer::TextureImage> VulkanRenderer::record_texture_uploads(VkCommandBuffer commandBuffer, 
+		const std::vector<TextureFileInfo>& textureFileInfos, VkBuffer stagingBuffer)
+	{
+		// Images only hold the levels from firstLevel on, their level 0 is the file level firstLevel
+		std::vector<TextureImage> textureImages(textureFileInfos.size());
+		for (size_t i = 0; i < textureFileInfos.size(); ++i)
+		{
+			const TextureFileInfo& textureFileInfo{ textureFileInfos[i] };
+			const Ktx2Level& firstLevel{ textureFileInfo.info.levels[textureFileInfo.firstLevel] };
+			const uint32_t mipLevels{ static_cast<uint32_t>(textureFileInfo.info.levels.size()) - textureFileInfo.firstLevel };
+
+			// Generated levels are blitted from the previous level of the same image
+			VkImageUsageFlags usage{ VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT };
+			if (textureFileInfo.stagedLevelCount < textureFileInfo.info.levels.size())
+			{
+				usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+			}
+
+			textureImages[i].image = create_image(firstLevel.width, firstLevel.height, mipLevels, textureFileInfo.info.format, 
+				VK_IMAGE_TILING_OPTIMAL, usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &textureImages[i].memory);
+			VkImage textureImage{ textureImages[i].image };
 
-		m_textureImages.push_back(textureImage);
-		m_textureImageMemories.push_back(textureImageMemory);
+			// Force transition before transfer
+			record_image_layout_transition(commandBuffer, textureImage, mipLevels,
+				VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
 
-		return m_textureImages.size() - 1;
+			for (uint32_t level = textureFileInfo.firstLevel; level < textureFileInfo.stagedLevelCount; ++level)
+			{
+				const uint32_t imageLevel{ level - textureFileInfo.firstLevel };
+				record_copy_image_buffer(commandBuffer, stagingBuffer, textureFileInfo.stagingOffsets[imageLevel], textureImage, 
+					imageLevel, textureFileInfo.info.levels[level].width, textureFileInfo.info.levels[level].height);
+			}
+
+			if (textureFileInfo.stagedLevelCount < textureFileInfo.info.levels.size())
+			{
+				// Also leaves the image ready to be sampled
+				record_generate_mipmaps(commandBuffer, textureImage, firstLevel.width, firstLevel.height, mipLevels);
+			}
+			else
+			{
+				record_image_layout_transition(commandBuffer, textureImage, mipLevels,
+					VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+			}
+		}
+
+		return textureImages;
 	}
 
 	size_t VulkanRenderer::create_texture(const std::string& fileName)
 	{
-		size_t textureImageLocation{ create_texture_image(fileName) };
+		return create_textures({ fileName })[0];
+	}
+
+	std::vector<size_t> VulkanRenderer::create_textures(const std::vector<std::string>& fileNames, ImportProfile* profile)
+	{
+		std::vector<size_t> textureIds(fileNames.size());
 
-		VkImageView textureImageView{ create_image_view(m_textureImages[textureImageLocation],
-			VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_ASPECT_COLOR_BIT) };
-		m_textureImageViews.push_back(textureImageView);
+		// Read only the file headers first, they choose the file that is loaded (the cooked one or the source image)
+		// and all the texel data can then be loaded straight into one staging buffer
+		ImportStageTimer headersTimer{ profile, "texture headers" };
+		std::vector<TextureFileInfo> textureFileInfos(fileNames.size());
+		for (size_t i = 0; i < fileNames.size(); ++i)
+		{
+			load_texture_file_info(fileNames[i], &textureFileInfos[i]);
+		}
+		headersTimer.add_items(fileNames.size());
+		headersTimer.stop();
 
-		return create_texture_descriptor(textureImageView);
+		ImportStageTimer lookupTimer{ profile, "texture lookup" };
+		lookupTimer.add_items(fileNames.size());
+
+		// Files with the same content as a loaded texture reuse it, the others are loaded once each
+		std::vector<TextureRegistry::TextureKey> newTextureKeys{};
+		std::vector<TextureFileInfo> newTextureFileInfos{};
+		std::vector<size_t> newTextureReferences{};
+		std::vector<size_t> newTextureIndices(fileNames.size(), SIZE_MAX);		// For the files not registered yet
+
+		for (size_t i = 0; i < fileNames.size(); ++i)
+		{
+			// Hash the file that is actually loaded
+			const TextureRegistry::TextureKey key{ m_textureRegistry.get_key(m_assetPack, textureFileInfos[i].filePath) };
+			if (m_textureRegistry.acquire(m_assetPack, key, &textureIds[i]))
+			{
+				continue;
+			}
+
+			// Same file more than once in this batch
+			auto newTextureKey{ std::find_if(newTextureKeys.begin(), newTextureKeys.end(), [this, &key](const TextureRegistry::TextureKey& newKey) {
+				return TextureRegistry::has_same_content(m_assetPack, key, newKey);
+			}) };
+			if (newTextureKey != newTextureKeys.end())
+			{
+				newTextureIndices[i] = newTextureKey - newTextureKeys.begin();
+				++newTextureReferences[newTextureIndices[i]];
+				continue;
+			}
+
+			newTextureIndices[i] = newTextureKeys.size();
+			newTextureKeys.push_back(key);
+			newTextureFileInfos.push_back(std::move(textureFileInfos[i]));
+			newTextureReferences.push_back(1);
+		}
+
+		lookupTimer.stop();
+
+		if (newTextureFileInfos.empty())
+		{
+			return textureIds;
+		}
+
+		std::vector<size_t> textureImageLocations{ create_texture_images(&newTextureFileInfos, profile) };
+
+		std::vector<size_t> newTextureIds(newTextureFileInfos.size());
+		for (size_t i = 0; i < newTextureFileInfos.size(); ++i)
+		{
+			const size_t location{ textureImageLocations[i] };
+			VkImageView textureImageView{ create_image_view(m_textureImages[location], m_textureImageFormats[location],
+				VK_IMAGE_ASPECT_COLOR_BIT, m_textureImageMipLevels[location]) };
+			m_textureImageViews.push_back(textureImageView);
+
+			newTextureIds[i] = create_texture_descriptor(location);
+			m_textureRegistry.insert(newTextureKeys[i], newTextureIds[i], newTextureReferences[i]);
+
+			// Only cooked textures have their whole mip chain in the file, so only they are streamed
+			const TextureFileInfo& textureFileInfo{ m_textureFileInfos[location] };
+			std::vector<uint64_t> levelSizes{};
+			for (const Ktx2Level& level : textureFileInfo.info.levels)
+			{
+				levelSizes.push_back(level.byteLength);
+			}
+			m_textureStreamer.add_texture(newTextureIds[i], textureFileInfo.info.width, textureFileInfo.info.height, levelSizes,
+				textureFileInfo.firstLevel, textureFileInfo.cooked);
+		}
+
+		for (size_t i = 0; i < fileNames.size(); ++i)
+		{
+			if (newTextureIndices[i] != SIZE_MAX)
+			{
+				textureIds[i] = newTextureIds[newTextureIndices[i]];
+			}
+		}
+
+		return textureIds;
 	}
 
-	size_t VulkanRenderer::create_texture_descriptor(VkImageView textureImage)
+	size_t VulkanRenderer::create_texture_descriptor(size_t textureImageLocation)
 	{
-		VkDescriptorSet descriptorSet;
+		size_t textureId;
 
-		VkDescriptorSetAllocateInfo descriptorSetAllocateInfo{
-			.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
-			.descriptorPool = m_samplerDescriptorPool,
-			.descriptorSetCount = 1,
-			.pSetLayouts = &m_samplerSetLayout,
-		};
-
-		VkResult result{ vkAllocateDescriptorSets(m_device.logicalDevice, &descriptorSetAllocateInfo, &descriptorSet) };
-		if (result != VK_SUCCESS)
+		// Reuse the set of a destroyed texture if there is one, the pool only holds MAX_OBJECTS sets
+		if (!m_freeTextureIds.empty())
 		{
-			throw std::runtime_error("Failed to allocate texture descriptor sets!");
+			textureId = m_freeTextureIds.back();
+			m_freeTextureIds.pop_back();
+		}
+		else
+		{
+			if (m_samplerDescriptorSets.size() >= MAX_OBJECTS)
+			{
+				throw std::runtime_error("Failed to allocate texture descriptor sets!");
+			}
+
+			VkDescriptorSet descriptorSet;
+
+			VkDescriptorSetAllocateInfo descriptorSetAllocateInfo{
+				.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+				.descriptorPool = m_samplerDescriptorPool,
+				.descriptorSetCount = 1,
+				.pSetLayouts = &m_samplerSetLayout,
+			};
+
+			VkResult result{ vkAllocateDescriptorSets(m_device.logicalDevice, &descriptorSetAllocateInfo, &descriptorSet) };
+			if (result != VK_SUCCESS)
+			{
+				throw std::runtime_error("Failed to allocate texture descriptor sets!");
+			}
+
+			m_samplerDescriptorSets.push_back(descriptorSet);
+			m_samplerDescriptorImageLocations.push_back(textureImageLocation);
+			textureId = m_samplerDescriptorSets.size() - 1;
 		}
 
+		m_samplerDescriptorImageLocations[textureId] = textureImageLocation;
+		update_texture_descriptor(textureId);
+
+		return textureId;
+	}
+
+	void VulkanRenderer::update_texture_descriptor(size_t textureId)
+	{
+		const size_t textureImageLocation{ m_samplerDescriptorImageLocations[textureId] };
+
 		VkDescriptorImageInfo descriptorImageInfo{
 			.sampler = m_textureSampler,								// Sampler to use for set
-			.imageView = textureImage,									// Image to bind to set
+			.imageView = m_textureImageViews[textureImageLocation],	// Image to bind to set
 			.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,	// Image layout when in use
 		};
 
 		VkWriteDescriptorSet writeDescriptorSet{
 			.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-			.dstSet = descriptorSet,
+			.dstSet = m_samplerDescriptorSets[textureId],
 			.dstBinding = 0,
 			.dstArrayElement = 0,
 			.descriptorCount = 1,
@@ -1913,64 +2990,388 @@ namespace VkCourse
 		};
 
 		vkUpdateDescriptorSets(m_device.logicalDevice, 1, &writeDescriptorSet, 0, nullptr);
+	}
+
+	void VulkanRenderer::destroy_size_dependent_resources()
+	{
+		for (const auto& framebuffer : m_swapchainFramebuffers)
+		{
+			vkDestroyFramebuffer(m_device.logicalDevice, framebuffer, nullptr);
+		}
+
+		for (size_t i = 0; i < m_msaaColorImages.size(); ++i)
+		{
+			vkDestroyImageView(m_device.logicalDevice, m_msaaColorImageViews[i], nullptr);
+			vkDestroyImage(m_device.logicalDevice, m_msaaColorImages[i], nullptr);
+			vkFreeMemory(m_device.logicalDevice, m_msaaColorImageMemories[i], nullptr);
+			vkDestroyImageView(m_device.logicalDevice, m_msaaDepthImageViews[i], nullptr);
+			vkDestroyImage(m_device.logicalDevice, m_msaaDepthImages[i], nullptr);
+			vkFreeMemory(m_device.logicalDevice, m_msaaDepthImageMemories[i], nullptr);
+		}
+
+		for (size_t i = 0; i < m_depthBufferImages.size(); ++i)
+		{
+			vkDestroyImageView(m_device.logicalDevice, m_depthBufferImageViews[i], nullptr);
+			vkDestroyImage(m_device.logicalDevice, m_depthBufferImages[i], nullptr);
+			vkFreeMemory(m_device.logicalDevice, m_depthBufferImageMemories[i], nullptr);
+		}
 
-		m_samplerDescriptorSets.push_back(descriptorSet);
+		for (size_t i = 0; i < m_colorBufferImages.size(); ++i)
+		{
+			vkDestroyImageView(m_device.logicalDevice, m_colorBufferImageViews[i], nullptr);
+			vkDestroyImage(m_device.logicalDevice, m_colorBufferImages[i], nullptr);
+			vkFreeMemory(m_device.logicalDevice, m_colorBufferImageMemories[i], nullptr);
+		}
 
-		return m_samplerDescriptorSets.size() - 1;
+		for (const auto& image : m_swapchainImages)
+		{
+			vkDestroyImageView(m_device.logicalDevice, image.imageView, nullptr);
+		}
+	}
+
+	void VulkanRenderer::recreate_per_image_resources()
+	{
+		// The device is idle, the sets are freed with their pools
+		vkFreeCommandBuffers(m_device.logicalDevice, m_graphicsCommandPool, static_cast<uint32_t>(m_commandBuffers.size()), m_commandBuffers.data());
+		for (size_t i = 0; i < m_vpUniformBuffers.size(); ++i)
+		{
+			vkDestroyBuffer(m_device.logicalDevice, m_vpUniformBuffers[i], nullptr);
+			vkFreeMemory(m_device.logicalDevice, m_vpUniformBufferMemories[i], nullptr);
+		}
+		vkDestroyDescriptorPool(m_device.logicalDevice, m_descriptorPool, nullptr);
+		vkDestroyDescriptorPool(m_device.logicalDevice, m_inputAttachmentDescriptorPool, nullptr);
+		vkDestroyQueryPool(m_device.logicalDevice, m_overdrawQueryPool, nullptr);
+
+		create_command_buffers();
+		create_uniform_buffers();
+		create_per_image_descriptor_pools();
+		create_descriptor_sets();
+		create_input_descriptor_sets();
+		create_overdraw_query_pool();
+	}
+
+	void VulkanRenderer::destroy_texture(size_t textureId)
+	{
+		const size_t location{ m_samplerDescriptorImageLocations[textureId] };
+
+		vkDestroyImageView(m_device.logicalDevice, m_textureImageViews[location], nullptr);
+		vkDestroyImage(m_device.logicalDevice, m_textureImages[location], nullptr);
+		vkFreeMemory(m_device.logicalDevice, m_textureImageMemories[location], nullptr);
+
+		// Null handles are ignored by destroy()
+		m_textureImageViews[location] = VK_NULL_HANDLE;
+		m_textureImages[location] = VK_NULL_HANDLE;
+		m_textureImageMemories[location] = VK_NULL_HANDLE;
+
+		m_textureStreamer.remove_texture(textureId);
+		m_freeTextureIds.push_back(textureId);
 	}
 
 	size_t VulkanRenderer::create_mesh_model(const std::string& modelFileName)
 	{
-		// Import model "scene"
-		Assimp::Importer importer;
-		const aiScene* scene{ importer.ReadFile(modelFileName, 
-			aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_JoinIdenticalVertices) };
-		if (scene == nullptr)
+		const auto start{ std::chrono::steady_clock::now() };
+		ImportProfile profile{ .modelFileName = modelFileName };
+
+		// Import model "scene", unless an up to date copy of the encoded meshes is in the mesh cache
+		constexpr uint32_t importFlags{ aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_JoinIdenticalVertices };
+
+		EncodedModelData encodedModelData{};
 		{
-			throw std::runtime_error("Failed to load model " + modelFileName + "!");
+			ImportStageTimer cacheTimer{ &profile, "mesh cache load" };
+			profile.meshCacheHit = m_meshCacheEnabled && m_meshCache.load(m_assetPack, modelFileName, importFlags, m_vertexFormat, &encodedModelData);
+			if (profile.meshCacheHit)
+			{
+				cacheTimer.add_bytes(get_encoded_mesh_size(encodedModelData.meshes));
+				cacheTimer.add_items(encodedModelData.meshes.size());
+			}
 		}
 
-		// Get vector of all materials with 1:1 ID placement
-		std::vector<std::string> textureNames{ MeshModel::load_materials(scene) };
+		if (!profile.meshCacheHit)
+		{
+			ModelData modelData{};
+
+			// Model and material files are read from the asset pack or memory mappings (the importer owns the IO system)
+			Assimp::Importer importer;
+			MappedIOSystem* ioSystem{ new MappedIOSystem(&m_assetPack) };
+			importer.SetIOHandler(ioSystem);
+
+			ImportStageTimer importTimer{ &profile, "assimp import" };
+			const aiScene* scene{ importer.ReadFile(modelFileName, importFlags) };
+			if (scene == nullptr)
+			{
+				throw std::runtime_error("Failed to load model " + modelFileName + "!");
+			}
+			importTimer.add_bytes(ioSystem->get_opened_bytes());
+			importTimer.add_items(ioSystem->get_opened_file_count());
+			importTimer.stop();
+
+			// Get vector of all materials with 1:1 ID placement
+			ImportStageTimer materialsTimer{ &profile, "load materials" };
+			modelData.textureNames = MeshModel::load_materials(scene);
+			materialsTimer.add_items(modelData.textureNames.size());
+			materialsTimer.stop();
+
+			// Load all meshes
+			ImportStageTimer nodesTimer{ &profile, "load nodes" };
+			modelData.meshes = MeshModel::load_node(scene->mRootNode, scene);
+			nodesTimer.add_bytes(get_mesh_data_size(modelData.meshes));
+			nodesTimer.add_items(modelData.meshes.size());
+			nodesTimer.stop();
+
+			// Reorder for the vertex cache, overdraw and vertex fetch, once per import (the cache stores the result)
+			ImportStageTimer optimizeTimer{ &profile, "optimize meshes" };
+			for (size_t i = 0; i < modelData.meshes.size(); ++i)
+			{
+				const MeshOptimizeStats stats{ optimize_mesh(&modelData.meshes[i], MeshOptimizeOptions{}) };
+				profile.meshStats.push_back({
+					.acmrBefore = stats.before.acmr,
+					.acmrAfter = stats.after.acmr,
+					.atvrBefore = stats.before.atvr,
+					.atvrAfter = stats.after.atvr,
+				});
+				optimizeTimer.add_items(modelData.meshes[i].indices.size() / 3);
+			}
+			optimizeTimer.add_bytes(get_mesh_data_size(modelData.meshes));
+			optimizeTimer.stop();
+
+			// Into the vertex format and index type the buffers hold (the cache stores the result)
+			ImportStageTimer encodeTimer{ &profile, "encode meshes" };
+			encodedModelData = MeshModel::encode_model(modelData, m_vertexFormat);
+			encodeTimer.add_bytes(get_encoded_mesh_size(encodedModelData.meshes));
+			encodeTimer.add_items(encodedModelData.meshes.size());
+			encodeTimer.stop();
+
+			// Failing to write the cache only means the next start imports the model again
+			if (m_meshCacheEnabled)
+			{
+				ImportStageTimer storeTimer{ &profile, "mesh cache store" };
+				m_meshCache.store(m_assetPack, modelFileName, importFlags, m_vertexFormat, ioSystem->get_opened_file_names(), encodedModelData);
+				storeTimer.add_bytes(get_encoded_mesh_size(encodedModelData.meshes));
+				storeTimer.add_items(encodedModelData.meshes.size());
+			}
+		}
+
+		const std::vector<std::string>& textureNames{ encodedModelData.textureNames };
 
 		// Conversion from the materials list IDs to our descriptor array IDs
 		std::vector<size_t> materialsToTextures(textureNames.size(), 0);
 
-		// Create textures
+		// Gather the materials with a texture, if it is empty it will reference the texture at position 0 (default texture)
+		std::vector<size_t> texturedMaterials{};
+		std::vector<std::string> materialTextureNames{};
 		for (size_t i = 0; i < textureNames.size(); ++i)
 		{
-			// If it is empty it will reference the texture at position 0 (default texture)
 			if (!textureNames[i].empty())
 			{
-				materialsToTextures[i] = create_texture(textureNames[i]);
+				texturedMaterials.push_back(i);
+				materialTextureNames.push_back(textureNames[i]);
+			}
+		}
+
+		// Create all the textures at once, so they are decoded in parallel and uploaded together.
+		// Each material holds one reference, released by destroy_mesh_model()
+		std::vector<size_t> textureIds{};
+		if (!materialTextureNames.empty())
+		{
+			textureIds = create_textures(materialTextureNames, &profile);
+			for (size_t i = 0; i < texturedMaterials.size(); ++i)
+			{
+				materialsToTextures[texturedMaterials[i]] = textureIds[i];
 			}
 		}
 
-		// Load all meshes
-		std::vector<Mesh> modelMeshes{ MeshModel::load_node(m_device.physicalDevice, m_device.logicalDevice,
-			m_graphicsQueue, m_graphicsCommandPool, scene->mRootNode, scene, materialsToTextures) };
+		// Upload all meshes, copied from the cache mapping or the encoded data (each buffer copy waits for the queue)
+		ImportStageTimer meshUploadTimer{ &profile, "mesh upload" };
+		std::vector<Mesh> modelMeshes{ MeshModel::create_meshes(m_device.physicalDevice, m_device.logicalDevice,
+			m_graphicsQueue, m_graphicsCommandPool, encodedModelData.meshes, materialsToTextures) };
+		meshUploadTimer.add_bytes(get_encoded_mesh_size(encodedModelData.meshes));
+		meshUploadTimer.add_items(modelMeshes.size());
+		meshUploadTimer.stop();
+
+		const std::chrono::duration<double, std::milli> totalTime{ std::chrono::steady_clock::now() - start };
+		profile.totalMilliseconds = totalTime.count();
 
 		m_meshModels.emplace_back(modelMeshes);
+		m_meshModelTextureIds.push_back(textureIds);
+		m_meshModelImportProfiles.push_back(std::move(profile));
 		return m_meshModels.size() - 1;
 	}
 
-	stbi_uc* VulkanRenderer::load_texture_file(const std::string& fileName, int* width, int* height, VkDeviceSize* imageSize)
+	void VulkanRenderer::destroy_mesh_model(size_t modelId)
+	{
+		if (modelId >= m_meshModels.size()) return;
+
+		// Buffers and textures may still be used by frames in flight, or by the streaming batch in progress
+		vkDeviceWaitIdle(m_device.logicalDevice);
+		finish_texture_streaming();
+
+		m_meshModels[modelId].destroy_mesh_model();
+		m_meshModels[modelId] = MeshModel();		// Empty, so other model ids stay valid
+
+		for (size_t textureId : m_meshModelTextureIds[modelId])
+		{
+			if (m_textureRegistry.release(textureId))
+			{
+				destroy_texture(textureId);
+			}
+		}
+		m_meshModelTextureIds[modelId].clear();
+	}
+
+	void VulkanRenderer::load_texture_file_info(const std::string& fileName, TextureFileInfo* textureFileInfo)
 	{
+		const std::string fileLoc{ "Textures/" + fileName };
+
+		// Prefer the cooked KTX2 file (compressed, with mips) if it is up to date and the device can sample its format
+		const std::string cookedFileLoc{ get_cooked_texture_path(fileName) };
+
+		// Packed cooked files are up to date by construction, loose ones are compared with their source
+		bool cookedUpToDate{ m_assetPack.find(cookedFileLoc) != nullptr };
+		if (!cookedUpToDate)
+		{
+			std::error_code error;
+			const auto sourceTime{ std::filesystem::last_write_time(fileLoc, error) };
+			const bool sourceExists{ !error };
+			const auto cookedTime{ std::filesystem::last_write_time(cookedFileLoc, error) };
+			cookedUpToDate = !error && (!sourceExists || cookedTime >= sourceTime);
+		}
+
+		AssetFile cookedFile{};
+		if (cookedUpToDate && m_assetPack.open_asset(cookedFileLoc, &cookedFile) 
+			&& read_ktx2_info(cookedFile.span(), &textureFileInfo->info)
+			&& is_texture_format_supported(textureFileInfo->info.format))
+		{
+			textureFileInfo->filePath = cookedFileLoc;
+			textureFileInfo->cooked = true;
+			textureFileInfo->stagedLevelCount = static_cast<uint32_t>(textureFileInfo->info.levels.size());
+
+			// Low mips first, the streamer loads the others once they are needed
+			textureFileInfo->firstLevel = m_textureStreamer.get_initial_level(textureFileInfo->info.width, 
+				textureFileInfo->info.height, textureFileInfo->stagedLevelCount);
+			return;
+		}
+
+		// Otherwise decode the source image at runtime with a full RGBA mip chain
+		int width, height, channels;
+		AssetFile sourceFile{};
+		if (!m_assetPack.open_asset(fileLoc, &sourceFile)
+			|| !stbi_info_from_memory(sourceFile.data(), static_cast<int>(sourceFile.size()), &width, &height, &channels))
+		{
+			throw std::runtime_error("Failed to load texture file " + fileName + "!");
+		}
+
+		textureFileInfo->filePath = fileLoc;
+		textureFileInfo->cooked = false;
+		textureFileInfo->firstLevel = 0;
+		textureFileInfo->info = {
+			.format = VK_FORMAT_R8G8B8A8_UNORM,
+			.width = static_cast<uint32_t>(width),
+			.height = static_cast<uint32_t>(height),
+		};
+
+		const uint32_t mipLevels{ get_mip_level_count(width, height) };
+		uint32_t levelWidth{ static_cast<uint32_t>(width) };
+		uint32_t levelHeight{ static_cast<uint32_t>(height) };
+		for (uint32_t level = 0; level < mipLevels; ++level)
+		{
+			textureFileInfo->info.levels.push_back({
+				.byteOffset = 0,
+				.byteLength = get_ktx2_image_size(VK_FORMAT_R8G8B8A8_UNORM, levelWidth, levelHeight),
+				.width = levelWidth,
+				.height = levelHeight,
+			});
+			levelWidth = std::max(1u, levelWidth / 2);
+			levelHeight = std::max(1u, levelHeight / 2);
+		}
+
+		// Only level 0 is uploaded when the GPU can blit the rest, otherwise they are filtered on the CPU
+		textureFileInfo->stagedLevelCount = is_linear_blit_supported(VK_FORMAT_R8G8B8A8_UNORM) ? 1 : mipLevels;
+	}
+
+	void VulkanRenderer::load_texture_file(const TextureFileInfo& textureFileInfo, void* stagingData)
+	{
+		if (textureFileInfo.cooked)
+		{
+			// Levels are copied as they are stored
+			const AssetFile file{ m_assetPack.get_asset(textureFileInfo.filePath) };
+			if (!read_ktx2_levels(file.span(), textureFileInfo.info, textureFileInfo.firstLevel, textureFileInfo.stagingOffsets, stagingData))
+			{
+				throw std::runtime_error("Failed to read texture file " + textureFileInfo.filePath + "!");
+			}
+			return;
+		}
+
 		// Number of channels image uses
 		int channels;
+		int loadedWidth, loadedHeight;
 		const auto desiredChannels{ STBI_rgb_alpha };
 
-		const std::string fileLoc{ "Textures/" + fileName };
-		stbi_uc* image{ stbi_load(fileLoc.c_str(), width, height, &channels, desiredChannels) };
+		// Decoded straight from the asset pack or the mapped file
+		const AssetFile file{ m_assetPack.get_asset(textureFileInfo.filePath) };
+		stbi_uc* image{ stbi_load_from_memory(file.data(), static_cast<int>(file.size()), 
+			&loadedWidth, &loadedHeight, &channels, desiredChannels) };
 
 		if (!image)
 		{
-			throw std::runtime_error("Failed to load texture file " + fileName + "!");
+			throw std::runtime_error("Failed to load texture file " + textureFileInfo.filePath + "!");
 		}
 
-		*imageSize = static_cast<VkDeviceSize>(*width * *height * desiredChannels);
+		if (static_cast<uint32_t>(loadedWidth) != textureFileInfo.info.width 
+			|| static_cast<uint32_t>(loadedHeight) != textureFileInfo.info.height)
+		{
+			stbi_image_free(image);
+			throw std::runtime_error("Texture file " + textureFileInfo.filePath + " changed while loading!");
+		}
 
-		return image;
+		memcpy(static_cast<char*>(stagingData) + textureFileInfo.stagingOffsets[0], image, textureFileInfo.info.levels[0].byteLength);
+
+		// CPU fallback for the levels the GPU can't generate, each one filtered from the previous
+		// (kept in host memory, the staging buffer may be uncached)
+		std::vector<unsigned char> previousLevel{};
+		const unsigned char* previousData{ image };
+		for (uint32_t level = 1; level < textureFileInfo.stagedLevelCount; ++level)
+		{
+			const Ktx2Level& previous{ textureFileInfo.info.levels[level - 1] };
+			std::vector<unsigned char> currentLevel(textureFileInfo.info.levels[level].byteLength);
+			downsample_rgba(previousData, previous.width, previous.height, currentLevel.data());
+
+			memcpy(static_cast<char*>(stagingData) + textureFileInfo.stagingOffsets[level], currentLevel.data(), currentLevel.size());
+
+			previousLevel = std::move(currentLevel);
+			previousData = previousLevel.data();
+		}
+
+		// Free original image data now not in use
+		stbi_image_free(image);
+	}
+
+	std::string VulkanRenderer::get_cooked_texture_path(const std::string& fileName)
+	{
+		// Same name as the texture cooker's output: the full source name, so foo.png and foo.jpg or sub/foo.png differ
+		return "Textures/" + fileName + ".ktx2";
+	}
+
+	bool VulkanRenderer::is_texture_format_supported(VkFormat format) const
+	{
+		if (format != VK_FORMAT_R8G8B8A8_UNORM && !m_textureCompressionBC)
+		{
+			return false;
+		}
+
+		VkFormatProperties formatProperties;
+		vkGetPhysicalDeviceFormatProperties(m_device.physicalDevice, format, &formatProperties);
+
+		return (formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT) != 0;
+	}
+
+	bool VulkanRenderer::is_linear_blit_supported(VkFormat format) const
+	{
+		VkFormatProperties formatProperties;
+		vkGetPhysicalDeviceFormatProperties(m_device.physicalDevice, format, &formatProperties);
+
+		constexpr VkFormatFeatureFlags requiredFeatures{ VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT 
+			| VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT };
+		return (formatProperties.optimalTilingFeatures & requiredFeatures) == requiredFeatures;
 	}
 
 	bool VulkanRenderer::check_validation_layer_support(const std::vector<const char*>& requestedValidationLayerNames) const
@@ -4,6 +4,16 @@
 #include "Utilities.h"
 #include "Mesh.h"
 #include "MeshModel.h"
+#include "MeshCache.h"
+#include "TextureRegistry.h"
+#include "Ktx2.h"
+#include "AssetPack.h"
+#include "TextureStreamer.h"
+#include "ImportProfile.h"
+#include "PipelineCache.h"
+#include "PipelineRegistry.h"
+#include "FrameReadback.h"
+#include "GpuProfiler.h"
 
 #include "stb_image.h"
 
@@ -12,6 +22,9 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include <future>
+#include <optional>
+
 namespace VkCourse
 {
 	const std::vector<const char*> requestedValidationLayerNames{
@@ -25,10 +38,62 @@ namespace VkCourse
 	constexpr bool validationLayersEnabled{ true };
 #endif
 
+	// Specialization constants of the main subpass (shader.frag), each set of values is a pipeline variant.
+	// The sample count is not one: it is pipeline state (GraphicsPipelineDescription::samples), and with MSAA the
+	// attachments are resolved at the end of the main subpass, so no shader reads individual samples
+	struct MaterialConstants {
+		bool textured{ true };				// Otherwise the vertex color, without sampling
+	};
+
+	// Specialization constants of the composition subpass (second.frag), each set of values is a pipeline variant
+	struct CompositionConstants {
+		bool showDepth{ true };				// Right of split shows the depth buffer
+		float split{ 0.5f };				// Fraction of the swapchain width, so resizing needs no new variant
+		float depthLowerBound{ 0.98f };		// Depth range spread over the visualization colors
+		float depthUpperBound{ 1.f };
+	};
+
+	// Depth only pass over the meshes before the main pass, which then only shades the visible fragments (EQUAL depth test).
+	// Auto turns it on when the overdraw measured with occlusion queries makes shading every fragment cost more than
+	// drawing the geometry twice
+	enum class DepthPrepassMode {
+		Off,
+		On,
+		Auto,
+	};
+
+	constexpr float DEPTH_PREPASS_OVERDRAW_THRESHOLD{ 1.5f };		// Fragments drawn per visible fragment
+	constexpr uint32_t OVERDRAW_MEASUREMENT_INTERVAL{ 120 };		// Frames between measurements while the prepass is off
+
+	// Costs of the last draw() call
+	struct FrameStats {
+		double waitMilliseconds{};			// For the frame in flight and the swapchain image to be free
+		double updateMilliseconds{};		// Texture streaming, pipeline variants and uniform buffers
+		double recordMilliseconds{};
+		double submitMilliseconds{};		// Submit and present
+		double gpuMilliseconds{ -1. };		// Of the frame MAX_FRAME_DRAWS earlier, negative if not measured
+		uint32_t drawCount{};
+		uint64_t triangleCount{};
+	};
+
+	// Costs of the init() call
+	struct InitStats {
+		double pipelinesMilliseconds{};		// Creating the pipelines of the first frame
+		bool pipelineCacheWarm{ false };	// The pipeline cache was loaded from disk
+		bool assetPackOpen{ false };		// Assets.pack was found, packed assets are read from it
+		double totalMilliseconds{};
+	};
+
 	class VulkanRenderer
 	{
 	public:
-		VulkanRenderer(const Window& window);
+		// MSAA is capped by what the device supports, 1 sample disables it
+		VulkanRenderer(const Window& window, VertexFormat vertexFormat = VertexFormat::Packed, 
+			VkSampleCountFlagBits msaaSamples = VK_SAMPLE_COUNT_1_BIT);
+		// Headless, renders into offscreen images of this size instead of a swapchain (no window, surface or swapchain
+		// extension, so it runs on machines without a display and on software implementations)
+		VulkanRenderer(VkExtent2D extent, VertexFormat vertexFormat = VertexFormat::Packed, 
+			VkSampleCountFlagBits msaaSamples = VK_SAMPLE_COUNT_1_BIT);
 		~VulkanRenderer();
 
 		int init();
@@ -36,16 +101,60 @@ namespace VkCourse
 		void destroy();
 
 		size_t create_mesh_model(const std::string& modelFileName);
+		void destroy_mesh_model(size_t modelId);
 		void update_model_matrix(size_t modelId, glm::mat4 modelMatrix);
+		void update_view_matrix(glm::mat4 viewMatrix);
+
+		const InitStats& get_init_stats() const;
+		const FrameStats& get_frame_stats() const;
+		// GPU time of each pass and subpass, averaged over the last frames
+		const GpuProfiler& get_gpu_profiler() const;
+		// Bytes used on the device local heaps, 0 without VK_EXT_memory_budget
+		uint64_t get_device_memory_usage() const;
+		std::string get_device_name() const;
+
+		// Time, bytes and items of each stage of the create_mesh_model() call that created the model (see ImportProfile::to_json())
+		const ImportProfile& get_import_profile(size_t modelId) const;
+		// Disabled, every create_mesh_model() goes through Assimp (to time imports)
+		void set_mesh_cache_enabled(bool enabled);
+
+		// VRAM budget and rate of the texture streaming
+		void set_texture_streaming_options(const TextureStreamingOptions& options);
+
+		// Switch to the pipeline variant for these values, once it is compiled (the current one is used meanwhile)
+		void set_material_constants(const MaterialConstants& constants);
+		void set_composition_constants(const CompositionConstants& constants);
+
+		bool is_headless() const;
+
+		// Called from draw() with each rendered frame, about MAX_FRAME_DRAWS frames after it was drawn and
+		// without waiting for the GPU. An empty callback stops the readback (frames not delivered yet are dropped).
+		// It also stops if the swapchain is recreated without TRANSFER_SRC support, see is_readback_active()
+		void set_readback_callback(ReadbackCallback callback);
+		bool is_readback_active() const;
+
+		void set_depth_prepass_mode(DepthPrepassMode mode);
+		// Fragments passing the depth test of the main pass per visible fragment, from the last frame drawn with a prepass
+		// (0 until measured)
+		float get_measured_overdraw() const;
 
 	private:
-		const Window& m_window;
+		const Window* m_window;		// Null when headless
+		VkExtent2D m_headlessExtent{};
 
 		// Keeps track of which frame between 0 and MAX_FRAMES - 1, is being rendered to inside draw()
 		unsigned int m_currentFrame{ 0 };
 
 		// Scene objects
+		VertexFormat m_vertexFormat;
 		std::vector<MeshModel> m_meshModels{};
+		std::vector<std::vector<size_t>> m_meshModelTextureIds{};		// Texture references held by each model
+		std::vector<ImportProfile> m_meshModelImportProfiles{};
+		MeshCache m_meshCache{};
+		bool m_meshCacheEnabled{ true };
+		TextureRegistry m_textureRegistry{};
+		AssetPack m_assetPack{};
+		TextureStreamer m_textureStreamer{};
 
 		// Scene settings
 		struct UboViewProjection {
@@ -60,11 +169,16 @@ namespace VkCourse
 			VkDevice logicalDevice;
 		} m_device;
 		QueueFamilyIndices m_queueFamilyIndices;
+		bool m_textureCompressionBC{ false };
+		PipelineCache m_pipelineCache{};
+		PipelineRegistry m_pipelineRegistry{};
 		VkQueue m_graphicsQueue;
 		VkQueue m_presentationQueue;
 		VkSurfaceKHR m_surface;
 		VkSwapchainKHR m_swapchain;
-		std::vector<SwapchainImage> m_swapchainImages{};
+		std::vector<SwapchainImage> m_swapchainImages{};		// Offscreen images when headless, one per frame in flight
+		std::vector<VkDeviceMemory> m_headlessImageMemories{};
+		bool m_swapchainReadable{ false };		// Images can be copied from (always when headless)
 		std::vector<VkFramebuffer> m_swapchainFramebuffers{};
 		std::vector<VkCommandBuffer> m_commandBuffers{};
 
@@ -78,6 +192,16 @@ namespace VkCourse
 		std::vector<VkImageView> m_depthBufferImageViews;
 		VkFormat m_depthBufferFormat;
 
+		// Multisampled color and depth of the first subpass, resolved into the buffers above (only with MSAA)
+		VkSampleCountFlagBits m_requestedMsaaSamples;
+		VkSampleCountFlagBits m_msaaSamples{ VK_SAMPLE_COUNT_1_BIT };
+		std::vector<VkImage> m_msaaColorImages{};
+		std::vector<VkDeviceMemory> m_msaaColorImageMemories{};
+		std::vector<VkImageView> m_msaaColorImageViews{};
+		std::vector<VkImage> m_msaaDepthImages{};
+		std::vector<VkDeviceMemory> m_msaaDepthImageMemories{};
+		std::vector<VkImageView> m_msaaDepthImageViews{};
+
 		VkSampler m_textureSampler;
 
 		// Descriptors
@@ -91,6 +215,8 @@ namespace VkCourse
 		VkDescriptorPool m_inputAttachmentDescriptorPool;
 		std::vector<VkDescriptorSet> m_descriptorSets{};
 		std::vector<VkDescriptorSet> m_samplerDescriptorSets{};
+		std::vector<size_t> m_samplerDescriptorImageLocations{};		// Texture image each sampler descriptor set points at
+		std::vector<size_t> m_freeTextureIds{};							// Sampler descriptor sets of destroyed textures, to be reused
 		std::vector<VkDescriptorSet> m_inputAttachmentDescriptorSets{};
 
 		std::vector<VkBuffer> m_vpUniformBuffers{};
@@ -106,22 +232,92 @@ namespace VkCourse
 		std::vector<VkImage> m_textureImages{};
 		std::vector<VkDeviceMemory> m_textureImageMemories{};		// An optimal layout would have only one memory accessed with offsets
 		std::vector<VkImageView> m_textureImageViews{};
-
-		// Pipeline
+		std::vector<VkFormat> m_textureImageFormats{};
+		std::vector<uint32_t> m_textureImageMipLevels{};
+
+		// Where a texture is loaded from and where each of its mip levels goes in the staging buffer
+		struct TextureFileInfo {
+			std::string filePath;
+			bool cooked;		// KTX2 from the texture cooker, otherwise a source image decoded at runtime
+			Ktx2Info info;
+			uint32_t firstLevel;			// Most detailed level loaded (streamed textures start with their low mips)
+			uint32_t stagedLevelCount;		// Levels uploaded from the staging buffer, the rest are blitted on the GPU
+			std::vector<VkDeviceSize> stagingOffsets;		// From firstLevel on
+		};
+		std::vector<TextureFileInfo> m_textureFileInfos{};		// Per texture image, to stream other levels
+
+		struct TextureImage {
+			VkImage image;
+			VkDeviceMemory memory;
+		};
+
+		// Residency changes, applied one batch at a time without stalling the frames: the files are read by a worker
+		// into the staging buffer, then the upload is submitted with m_textureUploadFence, which the frames poll
+		struct TextureStreamingBatch {
+			std::vector<TextureResidencyChange> changes;
+			std::vector<TextureFileInfo> textureFileInfos;		// Per change
+			VkBuffer stagingBuffer;
+			VkDeviceMemory stagingBufferMemory;
+			std::future<void> loading;
+			VkCommandBuffer commandBuffer{ VK_NULL_HANDLE };	// Once the files are loaded and the upload is submitted
+			std::vector<TextureImage> textureImages{};
+		};
+		std::optional<TextureStreamingBatch> m_textureStreamingBatch{};
+		VkFence m_textureUploadFence;
+
+		// Images and sets replaced by streaming, destroyed once the frames in flight when they were replaced are done
+		struct RetiredTexture {
+			VkImage image;
+			VkDeviceMemory memory;
+			VkImageView imageView;
+			VkDescriptorSet descriptorSet;
+			uint64_t frameNumber;		// m_frameNumber when replaced
+		};
+		std::vector<RetiredTexture> m_retiredTextures{};
+
+		// Pipeline (owned by m_pipelineRegistry)
 		VkPipeline m_graphicsPipeline;
+		VkPipeline m_depthPipeline;				// Same layout and subpass, position stream only and no color writes
+		VkPipeline m_graphicsEqualPipeline;		// Main pipeline after the depth prepass, EQUAL test and no depth writes
 		VkPipelineLayout m_pipelineLayout;
 
 		VkPipeline m_secondPipeline;
 		VkPipelineLayout m_secondPipelineLayout;
 
+		MaterialConstants m_materialConstants{};
+		CompositionConstants m_compositionConstants{};
+		size_t m_pendingGraphicsPipelineId{ SIZE_MAX };		// Variants still compiling
+		size_t m_pendingGraphicsEqualPipelineId{ SIZE_MAX };
+		size_t m_pendingSecondPipelineId{ SIZE_MAX };
+
 		VkRenderPass m_renderPass;
 
+		// Depth prepass, two occlusion queries per swapchain image (prepass and main pass samples)
+		DepthPrepassMode m_depthPrepassMode{ DepthPrepassMode::Off };
+		bool m_occlusionQueryPrecise{ false };		// Without exact sample counts Auto can't measure, it keeps the prepass off
+		VkQueryPool m_overdrawQueryPool;
+		std::vector<bool> m_overdrawQueriesRecorded{};		// Per swapchain image, results to read when it is recorded again
+		float m_measuredOverdraw{};
+		uint32_t m_framesSinceOverdrawMeasurement{ OVERDRAW_MEASUREMENT_INTERVAL };
+
+		// Frame statistics, GPU times from the profiler's timestamps
+		InitStats m_initStats{};
+		FrameStats m_frameStats{};
+		bool m_memoryBudgetSupported{ false };
+		GpuProfiler m_gpuProfiler{};
+
 		// Pools
 		VkCommandPool m_graphicsCommandPool;
 
 		// Secondary Vulkan components
 		VkFormat m_swapchainImageFormat;
 		VkExtent2D m_swapchainExtent;
+		VkExtent2D m_swapchainFramebufferSize{};		// Of the window when the swapchain was created, before any clamping
+
+		// Readback, one staging buffer per frame in flight
+		FrameReadback m_frameReadback{};
+		ReadbackCallback m_readbackCallback{};
+		uint64_t m_frameNumber{};
 
 		// Synchronization
 		std::vector<VkSemaphore> m_semaphoresImageAvailable{};
@@ -133,28 +329,49 @@ namespace VkCourse
 		void create_instance();
 		void create_logical_device();
 		void create_surface();
-		void create_swapchain();
+		void create_swapchain(VkSwapchainKHR oldSwapchain = VK_NULL_HANDLE);
+		bool recreate_swapchain();
+		void create_headless_images();
 		void create_render_pass();
 		void create_descriptor_set_layout();
 		void create_push_constant_range();
 		void create_graphics_pipeline();
+		GraphicsPipelineDescription get_graphics_pipeline_description(bool afterDepthPrepass) const;
+		GraphicsPipelineDescription get_second_pipeline_description() const;
 		void create_color_buffer_image();
 		void create_depth_buffer_image();
+		void create_msaa_images();
 		void create_framebuffers();
 		void create_command_pool();
 		void create_command_buffers();
 		void create_synchronization();
+		void create_query_pool();
+		void create_overdraw_query_pool();
 		void create_texture_sampler();
 
 		void create_uniform_buffers();
 		void create_descriptor_pool();
+		void create_per_image_descriptor_pools();
 		void create_descriptor_sets();
 		void create_input_descriptor_sets();
+		void update_input_descriptor_sets();
+		void update_projection();
 
 		void update_uniform_buffers(uint32_t imageIndex);
+		void update_texture_streaming();
+		void start_texture_streaming_batch(std::vector<TextureResidencyChange>&& changes);
+		bool advance_texture_streaming_batch(bool wait);		// True once the batch is applied
+		void apply_texture_streaming_batch(TextureStreamingBatch& batch);
+		void release_retired_textures(bool deviceIdle);
+		void finish_texture_streaming();		// With the device idle
 
 		// - Record functions
 		void record_commands(uint32_t imageIndex);
+		void record_readback(VkCommandBuffer commandBuffer, uint32_t imageIndex);
+		void record_mesh_draws(VkCommandBuffer commandBuffer, uint32_t imageIndex, bool depthOnly);
+		bool use_depth_prepass(uint32_t imageIndex);
+		void update_pipeline_variants();
+		bool acquire_swapchain_image(uint32_t* imageIndex);
 
 		// - Get/Obtain functions
 		// Not a getter, obtains the physical device to initialize m_device.physicalDevice
@@ -171,25 +388,43 @@ namespace VkCourse
 		bool check_device_extension_support(const VkPhysicalDevice& device, const std::vector<const char*>& requestedExtensionNames) const;
 		bool check_validation_layer_support(const std::vector<const char*>& requestedValidationLayerNames) const;
 		bool device_supports_requirements(const VkPhysicalDevice& device) const;
+		bool is_texture_format_supported(VkFormat format) const;
+		bool is_linear_blit_supported(VkFormat format) const;
 
 		// -- Choose functions
 		VkSurfaceFormatKHR choose_surface_format(const std::vector<VkSurfaceFormatKHR>& surfaceFormatList) const;
 		VkPresentModeKHR choose_presentation_mode(const std::vector<VkPresentModeKHR>& presentationModeList) const;
 		VkExtent2D choose_swapchain_extent(const VkSurfaceCapabilitiesKHR& surfaceCapabilities) const;
+		VkSampleCountFlagBits choose_msaa_samples(VkSampleCountFlagBits requestedSamples) const;
 		VkFormat choose_supported_format(const std::vector<VkFormat>& formatList, VkImageTiling imageTiling, 
 			VkFormatFeatureFlags featureFlags) const;
 
 		// -- Create functions (reusable)
-		VkImage create_image(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usageFlags,
-			VkMemoryPropertyFlags memoryPropertyFlags, VkDeviceMemory* imageMemory);
-		VkImageView create_image_view(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags);
-		VkShaderModule create_shader_module(const std::vector<char>& code);
-
-		size_t create_texture_image(const std::string& fileName);
+		VkImage create_image(uint32_t width, uint32_t height, uint32_t mipLevels, VkFormat format, VkImageTiling tiling, 
+			VkImageUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags, VkDeviceMemory* imageMemory, 
+			VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT);
+		VkImageView create_image_view(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, uint32_t mipLevels);
+
+		std::vector<size_t> create_texture_images(std::vector<TextureFileInfo>* textureFileInfos, ImportProfile* profile = nullptr);
+		std::vector<TextureImage> upload_texture_images(std::vector<TextureFileInfo>* textureFileInfos, ImportProfile* profile = nullptr);
+		VkDeviceSize create_texture_staging_buffer(std::vector<TextureFileInfo>* textureFileInfos, VkBuffer* stagingBuffer,
+			VkDeviceMemory* stagingBufferMemory);
+		void load_texture_files(const std::vector<TextureFileInfo>& textureFileInfos, void* stagingData);
+		std::vector<TextureImage> record_texture_uploads(VkCommandBuffer commandBuffer, const std::vector<TextureFileInfo>& textureFileInfos,
+			VkBuffer stagingBuffer);
 		size_t create_texture(const std::string& fileName);
-		size_t create_texture_descriptor(VkImageView textureImage);
+		std::vector<size_t> create_textures(const std::vector<std::string>& fileNames, ImportProfile* profile = nullptr);
+		size_t create_texture_descriptor(size_t textureImageLocation);
+		void update_texture_descriptor(size_t textureId);
+
+		// -- Destroy functions
+		void destroy_texture(size_t textureId);
+		void destroy_size_dependent_resources();		// Swapchain image views, attachments and framebuffers
+		void recreate_per_image_resources();			// When the swapchain image count changed
 
 		// -- Loader functions
-		stbi_uc* load_texture_file(const std::string& fileName, int* width, int* height, VkDeviceSize* imageSize);
+		void load_texture_file_info(const std::string& fileName, TextureFileInfo* textureFileInfo);
+		void load_texture_file(const TextureFileInfo& textureFileInfo, void* stagingData);
+		static std::string get_cooked_texture_path(const std::string& fileName);
 	};
 }
\ No newline at end of file
@@ -32,7 +32,7 @@ namespace VkCourse
 		}
 
 		glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API); // Not OpenGL neither OpenGL ES
-		glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE); // Window not resizable for now
+		glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE); // The renderer recreates its swapchain when the framebuffer size changes
 		m_window = glfwCreateWindow(width, height, windowName.c_str(), nullptr, nullptr);
 		if (m_window == nullptr)
 		{
@@ -53,6 +53,11 @@ namespace VkCourse
 		glfwPollEvents();
 	}
 
+	void Window::get_framebuffer_size(int* width, int* height) const
+	{
+		glfwGetFramebufferSize(m_window, width, height);
+	}
+
 	const std::vector<const char*> Window::get_required_extension_names() const
 	{
 		unsigned int extensionCount{};
@@ -23,6 +23,9 @@ namespace VkCourse
 		bool should_close() const;
 		void process_pending_events();
 
+		// In pixels, 0 x 0 while minimized
+		void get_framebuffer_size(int* width, int* height) const;
+
 		const std::vector<const char*> get_required_extension_names() const;
 
 	private:
@@ -2,14 +2,157 @@
 
 #include "VulkanRenderer.h"
 #include "Window.h"
+#include "Benchmark.h"
+#include "Json.h"
 
+#include <algorithm>
+#include <chrono>
+#include <fstream>
 #include <iostream>
+#include <stdexcept>
+#include <cstdlib>
+#include <cstring>
 
 constexpr int WINDOW_WIDTH{ 1200 };
 constexpr int WINDOW_HEIGHT{ 675 };
+constexpr int HEADLESS_FRAME_COUNT{ 600 };
+constexpr int IMPORT_TIMING_RUNS{ 5 };
 
-int main()
+// Same scene rendered offscreen for a fixed number of frames, for machines without a display
+int run_headless()
 {
+	VkCourse::VulkanRenderer vulkanRenderer(VkExtent2D{ WINDOW_WIDTH, WINDOW_HEIGHT });
+	if (vulkanRenderer.init() == EXIT_FAILURE)
+	{
+		return EXIT_FAILURE;
+	}
+
+	size_t testModel{ vulkanRenderer.create_mesh_model("Models/Seahawk.obj") };
+	std::cout << vulkanRenderer.get_import_profile(testModel).to_json() << std::endl;
+
+	const auto start{ std::chrono::steady_clock::now() };
+	for (int frame = 0; frame < HEADLESS_FRAME_COUNT; ++frame)
+	{
+		// Fixed rotation per frame, so runs are comparable
+		glm::mat4 testMat{ glm::rotate(glm::mat4(1.f), glm::radians(0.5f * frame), {0.f, 0.f, 1.f}) };
+		testMat = glm::scale(testMat, { 0.1f, 0.1f, 0.1f });
+		vulkanRenderer.update_model_matrix(testModel, testMat);
+
+		vulkanRenderer.draw();
+	}
+	const std::chrono::duration<double> time{ std::chrono::steady_clock::now() - start };
+	std::cout << HEADLESS_FRAME_COUNT << " headless frames, " << HEADLESS_FRAME_COUNT / time.count() << " fps" << std::endl;
+
+	return EXIT_SUCCESS;
+}
+
+// Headless, so it runs the same on CI machines (lavapipe). The JSON result goes to the output file if there is one,
+// to stdout otherwise (diagnostics go to stderr)
+int run_benchmark(const std::string& sceneFileName, const char* outputFileName)
+{
+	try
+	{
+		const VkCourse::BenchmarkScene scene{ VkCourse::BenchmarkScene::load(sceneFileName) };
+
+		VkCourse::VulkanRenderer vulkanRenderer(VkExtent2D{ scene.width, scene.height });
+		if (vulkanRenderer.init() == EXIT_FAILURE)
+		{
+			return EXIT_FAILURE;
+		}
+
+		const std::string json{ VkCourse::run_benchmark(vulkanRenderer, scene).to_json() };
+		if (outputFileName == nullptr)
+		{
+			std::cout << json << std::endl;
+		}
+		else
+		{
+			std::ofstream output(outputFileName, std::ios::trunc);
+			output << json << std::endl;
+			if (!output)
+			{
+				std::cerr << "Failed to write " << outputFileName << std::endl;
+				return EXIT_FAILURE;
+			}
+		}
+	}
+	catch (const std::runtime_error& error)
+	{
+		std::cerr << error.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
+
+// Imports the model several times through Assimp (bypassing the mesh cache). The first run is the cold one if the
+// OS file cache was dropped beforehand (e.g. after a reboot or "echo 3 > /proc/sys/vm/drop_caches"), the others
+// read the model and its materials from the page cache
+int run_import_timing(const std::string& modelFileName, int runCount)
+{
+	try
+	{
+		VkCourse::VulkanRenderer vulkanRenderer(VkExtent2D{ WINDOW_WIDTH, WINDOW_HEIGHT });
+		if (vulkanRenderer.init() == EXIT_FAILURE)
+		{
+			return EXIT_FAILURE;
+		}
+		vulkanRenderer.set_mesh_cache_enabled(false);
+
+		double coldMilliseconds{};
+		double warmMilliseconds{};
+		for (int run = 0; run < runCount; ++run)
+		{
+			const size_t modelId{ vulkanRenderer.create_mesh_model(modelFileName) };
+			const double importMilliseconds{ vulkanRenderer.get_import_profile(modelId).get_stage("assimp import").milliseconds };
+			vulkanRenderer.destroy_mesh_model(modelId);
+
+			if (run == 0)
+			{
+				coldMilliseconds = importMilliseconds;
+			}
+			else
+			{
+				warmMilliseconds += importMilliseconds / (runCount - 1);
+			}
+		}
+
+		std::cout << "{\"model\":";
+		VkCourse::write_json_string(std::cout, modelFileName);
+		std::cout << ",\"runs\":" << runCount << ",\"coldImportMs\":" << coldMilliseconds
+			<< ",\"warmImportMs\":" << warmMilliseconds << "}" << std::endl;
+	}
+	catch (const std::runtime_error& error)
+	{
+		std::cerr << error.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc > 1 && strcmp(argv[1], "--headless") == 0)
+	{
+		return run_headless();
+	}
+
+	// --benchmark <scene file> [<output JSON file>]
+	if (argc > 2 && strcmp(argv[1], "--benchmark") == 0)
+	{
+		return run_benchmark(argv[2], argc > 3 ? argv[3] : nullptr);
+	}
+
+	// --import-timing <model file> [<run count>]
+	if (argc > 2 && strcmp(argv[1], "--import-timing") == 0)
+	{
+		return run_import_timing(argv[2], argc > 3 ? std::max(2, atoi(argv[3])) : IMPORT_TIMING_RUNS);
+	}
+
+	// --verbose prints the init and import diagnostics of the interactive mode
+	const bool verbose{ argc > 1 && strcmp(argv[1], "--verbose") == 0 };
+
 	{ 
 		VkCourse::Window window;
 		if (window.init(WINDOW_WIDTH, WINDOW_HEIGHT, "Vulkan Course") == EXIT_FAILURE) return EXIT_FAILURE;
@@ -21,6 +164,17 @@ int main()
 				return EXIT_FAILURE;
 			}
 
+			if (verbose)
+			{
+				const VkCourse::InitStats& initStats{ vulkanRenderer.get_init_stats() };
+				if (initStats.assetPackOpen)
+				{
+					std::cout << "Using asset pack Assets.pack" << std::endl;
+				}
+				std::cout << "Renderer initialized in " << initStats.totalMilliseconds << " ms, pipelines in "
+					<< initStats.pipelinesMilliseconds << " ms (pipeline cache " << (initStats.pipelineCacheWarm ? "warm" : "cold") << ")" << std::endl;
+			}
+
 			float angle = 0.f;
 			float deltaTime = 0.f;
 			float lastTime = 0.f;
@@ -29,6 +183,10 @@ int main()
 			uint16_t frameCount{}; // n frames since last fps check
 
 			size_t testModel{ vulkanRenderer.create_mesh_model("Models/Seahawk.obj") };
+			if (verbose)
+			{
+				std::cout << vulkanRenderer.get_import_profile(testModel).to_json() << std::endl;
+			}
 
 			// Main loop
 			while (!window.should_close())